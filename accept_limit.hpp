@@ -0,0 +1,120 @@
+/*
+  accept_limit.hpp
+
+  $Id: accept_limit.hpp,v 1.1 2026/10/17 23:58:44 cvs Exp $
+ */
+
+#ifndef ACCEPT_LIMIT_HPP
+#define ACCEPT_LIMIT_HPP
+
+#include <stdlib.h>
+#include <arpa/inet.h>
+
+#include "util.h"
+
+/*
+ * Token buckets of accepted clients by source prefix, for one worker:
+ * see accept-rate. The kernel spreads the clients of a prefix over
+ * the SO_REUSEPORT copies of a listener, so each worker refills at its
+ * share of the rate, and nothing is shared between threads.
+ *
+ * The table is set-associative, WAYS buckets per set. A prefix missing
+ * from its set takes the bucket used least recently, with the credit
+ * left in it: prefixes taking turns in a set share their buckets
+ * rather than starting full, so spreading clients over more prefixes
+ * than the table holds buys no more than the table's total rate. Only
+ * buckets never used yet start full. Memory stays fixed whatever the
+ * number of sources.
+ */
+class accept_limit
+{
+private:
+  /*
+   * Tokens are counted in millionths, so that small rates split
+   * among workers still refill every millisecond.
+   */
+  enum { TOKEN = 1000000, SETS = 1024, WAYS = 4 };
+
+  struct bucket {
+    unsigned int prefix;  /* network byte order */
+    long long    credit;  /* in millionths of a token */
+    long long    stamp;   /* now_ms() clock of the last refill; 0: unused */
+  };
+
+  bucket       *slots;
+  unsigned int mask;      /* of the prefix, network byte order */
+  long long    refill;    /* millionths of a token per millisecond */
+  long long    burst;     /* most millionths of a token held */
+
+public:
+  accept_limit() : slots(0) { }
+
+  ~accept_limit() { free(slots); }
+
+  /*
+   * "rate" clients per second and up to "burst" at once for each
+   * prefix of "prefix_len" bits, this worker being one of "workers".
+   *
+   * Returns -1 on failure; 0 on success.
+   */
+  int setup(int rate, int burst, int prefix_len, int workers)
+    {
+      slots = (bucket *) calloc(SETS * WAYS, sizeof(bucket));
+      if (!slots)
+	return -1;
+
+      mask         = prefix_len ? htonl(~0u << (32 - prefix_len)) : 0;
+      refill       = MAX((long long) rate * (TOKEN / 1000) / workers, 1);
+      this->burst  = (long long) burst * TOKEN / workers;
+      if (this->burst < TOKEN)
+	this->burst = TOKEN;
+      return 0;
+    }
+
+  /*
+   * Takes a token for a client from "addr" at "now", a now_ms() clock
+   * reading: never 0.
+   *
+   * Returns 0 if the bucket of its prefix is empty; 1 otherwise.
+   */
+  int allow(unsigned int addr, long long now)
+    {
+      unsigned int prefix = addr & mask;
+      bucket *set = &slots[((prefix * 2654435761u) >> 22) * WAYS]; /* 10 bits: SETS */
+
+      bucket *b = 0;
+      bucket *lru = set;
+      for (int i = 0; i < WAYS; ++i) {
+	if (set[i].stamp && set[i].prefix == prefix) {
+	  b = &set[i];
+	  break;
+	}
+	if (set[i].stamp < lru->stamp)
+	  lru = &set[i];
+      }
+
+      if (!b) {
+	b = lru;
+	b->prefix = prefix;
+	if (!b->stamp) {
+	  b->credit = burst;
+	  b->stamp  = now;
+	}
+      }
+
+      if (now - b->stamp > (burst - b->credit) / refill)
+	b->credit = burst;
+      else if (now > b->stamp)
+	b->credit += (now - b->stamp) * refill;
+      b->stamp = now;
+
+      if (b->credit < TOKEN)
+	return 0;
+      b->credit -= TOKEN;
+      return 1;
+    }
+};
+
+#endif /* ACCEPT_LIMIT_HPP */
+
+/* Eof: accept_limit.hpp */
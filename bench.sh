@@ -0,0 +1,16 @@
+# Builds the benchmarks of bench/ against the objects of make.sh, then
+# runs one of them:
+#   sh bench.sh [transform] [<seconds per case>]
+#   sh bench.sh tunnel [<options>]    (see bench/tunnel_bench.cc)
+CC="c++ -O1 -ggdb -pthread "
+[ -f forward.o -a -f portfwdXOR ] || sh make.sh
+case "$1" in
+tunnel)
+	shift
+	$CC -o bench/tunnel_bench bench/tunnel_bench.cc && bench/tunnel_bench $*
+	;;
+*)
+	[ "$1" = transform ] && shift
+	$CC -I. -o bench/transform_bench bench/transform_bench.cc `ls *.o` -DPORTFWD_CONF=\"\" && bench/transform_bench $*
+	;;
+esac
@@ -0,0 +1,264 @@
+/*
+  transform_bench.cc
+
+  $Id: transform_bench.cc,v 1.1 2026/10/17 21:12:08 cvs Exp $
+
+  Microbenchmark of the obfuscation transforms: see bench.sh.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+#include "forward.h"
+#include "keystream.h"
+#include "keystream2.h"
+
+/*
+ * Globals of portfwd.cc, which is not linked in.
+ */
+const int BUF_SZ = 8192;
+const char * const portfwd_version = "bench";
+#ifdef HAVE_MSG_PROXY
+int transparent_proxy = 0;
+#endif
+int on_the_fly_dns = 0;
+int foreground = 1;
+
+/*
+ * Allocations made while measuring, counted by interposing on the
+ * allocator.
+ */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+static long allocations = 0;
+
+extern "C" void *malloc(size_t size)
+{
+  ++allocations;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+  ++allocations;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+  ++allocations;
+  return __libc_realloc(p, size);
+}
+
+static double seconds_per_case = 0.3;
+
+static double now_s()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long cycles()
+{
+#ifdef HAVE_RDTSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Timing of one case: "bytes" processed over "calls".
+ */
+struct measure {
+  double             start;
+  unsigned long long start_cycles;
+  long               start_allocations;
+  long long          bytes;
+  long long          calls;
+};
+
+static void measure_start(measure *m)
+{
+  m->bytes = 0;
+  m->calls = 0;
+  m->start_allocations = allocations;
+  m->start_cycles = cycles();
+  m->start = now_s();
+}
+
+static int measure_running(const measure *m)
+{
+  return now_s() - m->start < seconds_per_case;
+}
+
+static void measure_report(const measure *m, const char *name, const char *keys, int size)
+{
+  double elapsed = now_s() - m->start;
+  double cpb = (double) (cycles() - m->start_cycles) / m->bytes;
+
+  printf("%-16s %-6s %6d %10.1f", name, keys, size, m->bytes / elapsed / 1e6);
+#ifdef HAVE_RDTSC
+  printf(" %9.2f", cpb);
+#else
+  (void) cpb;
+  printf(" %9s", "-");
+#endif
+  printf(" %11.3f\n", (double) (allocations - m->start_allocations) / m->calls);
+}
+
+struct key_set {
+  const char *name;
+  long long  XOR_key;
+  long long  conf_key;
+  long long  session_key;
+};
+
+/*
+ * Session keys with shift counts below and above 32, which take
+ * different paths through keystream().
+ */
+static const key_set key_sets[] = {
+  { "k1", 2026054146659ll, 74132604721569ll, 0x1c2d3e4f5a6b7c11ll },
+  { "k2", 91283749123ll,   6234523452344ll,  0x0badc0ffee123456ll },
+  { "k3", 1ll,             0ll,              0x7766554433221100ll }
+};
+
+static const int sizes[] = { 64, 512, 1460, 8192 };
+
+static void init_session(clientSock_session_t *session, const key_set *ks, int inflate, int version)
+{
+  memset(session, 0, sizeof(*session));
+  session->session_key = ks->session_key;
+  session->inflate_when_copying = inflate;
+  session->version = version;
+  if (version == 2)
+    ks2_setup(&session->ks2, ks->XOR_key, ks->conf_key, ks->session_key, ~ks->session_key);
+}
+
+static void fill_random(char *buf, int len)
+{
+  for (int i = 0; i < len; ++i)
+    buf[i] = (char) rand();
+}
+
+/*
+ * apply_XOR_buf() over a session (NULL: UDP), on fresh input each call
+ * as the forwarder reads it.
+ */
+static void bench_apply(const char *name, const key_set *ks, int size, int inflate, int version)
+{
+  clientSock_session_t session;
+  clientSock_session_t *sp = 0;
+  if (version) {
+    init_session(&session, ks, inflate, version);
+    sp = &session;
+  }
+
+  char src[8192];
+  char buf[8192];
+  fill_random(src, size);
+
+  /*
+   * Past the start of the stream, where insertions settle.
+   */
+  for (int i = 0; i < 100; ++i) {
+    char *out;
+    int rd = size;
+    memcpy(buf, src, size);
+    apply_XOR_buf(ks->XOR_key, ks->conf_key, buf, &out, &rd, sp);
+  }
+
+  measure m;
+  measure_start(&m);
+  while (measure_running(&m))
+    for (int i = 0; i < 64; ++i) {
+      char *out;
+      int rd = size;
+      memcpy(buf, src, size);
+      apply_XOR_buf(ks->XOR_key, ks->conf_key, buf, &out, &rd, sp);
+      m.bytes += size;
+      ++m.calls;
+    }
+  measure_report(&m, name, ks->name, size);
+
+  if (sp)
+    free(session.inflated);
+}
+
+/*
+ * pseudo_rand_key_offset(), the version 1 reference, one value per
+ * byte, and keystream() over "size" offsets at once.
+ */
+static void bench_keystream(const key_set *ks, int size)
+{
+  int vr[8192];
+  long long offset = 100000;
+  int sink = 0;
+
+  measure m;
+  measure_start(&m);
+  while (measure_running(&m)) {
+    for (int i = 0; i < size; ++i)
+      sink ^= pseudo_rand_key_offset(ks->conf_key, offset + i, ks->session_key);
+    offset += size;
+    m.bytes += size;
+    ++m.calls;
+  }
+  measure_report(&m, "pseudo_rand", ks->name, size);
+
+  measure_start(&m);
+  while (measure_running(&m)) {
+    for (int done = 0; done < size; done += KEYSTREAM_CHUNK) {
+      int n = size - done < KEYSTREAM_CHUNK ? size - done : KEYSTREAM_CHUNK;
+      keystream(vr, n, ks->conf_key, offset + done, ks->session_key);
+      sink ^= vr[0];
+    }
+    offset += size;
+    m.bytes += size;
+    ++m.calls;
+  }
+  measure_report(&m, "keystream", ks->name, size);
+
+  if (sink == 0x7fffffff)
+    printf("\n");
+}
+
+int main(int argc, const char *argv[])
+{
+  if (argc > 1)
+    seconds_per_case = atof(argv[1]);
+  if (argc > 2 || seconds_per_case <= 0) {
+    fprintf(stderr, "Usage: %s [<seconds per case>]\n", argv[0]);
+    return 1;
+  }
+
+  printf("%-16s %-6s %6s %10s %9s %11s\n", "case", "keys", "size", "MB/s", "cycles/B", "allocs/call");
+
+  for (unsigned k = 0; k < sizeof(key_sets) / sizeof(key_sets[0]); ++k)
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+      const key_set *ks = &key_sets[k];
+      int size = sizes[s];
+
+      bench_keystream(ks, size);
+      bench_apply("v1 inflate", ks, size, 1, 1);
+      bench_apply("v1 deflate", ks, size, 0, 1);
+      bench_apply("v2 inflate", ks, size, 1, 2);
+      bench_apply("v2 deflate", ks, size, 0, 2);
+      bench_apply("udp", ks, size, 0, 0);
+    }
+
+  return 0;
+}
+
+/* Eof: transform_bench.cc */
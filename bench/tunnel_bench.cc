@@ -0,0 +1,633 @@
+/*
+  tunnel_bench.cc
+
+  $Id: tunnel_bench.cc,v 1.1 2026/10/17 21:48:36 cvs Exp $
+
+  Loopback load generator: a local and a remote-server portfwdXOR,
+  as in example-local.conf and example-server.conf, in front of
+  built-in echo, sink and source servers:
+
+    client => local (base+20..22) => remote (base+10..12) => servers (base..base+2)
+
+  Usage: tunnel_bench [-b <portfwdXOR>] [-c <clients>] [-t <seconds>]
+                      [-p <base port>] [-s <request size>]
+                      [-o <option line>]... [bulk-up|bulk-down|connect|rr]...
+
+  -o adds a global option to both configuration files, e.g.
+  -o "workers 4". All tests run when none is named.
+
+  Every payload is checked on receipt: a corrupt, short or stalled
+  (1 s) transfer counts as an error rather than just a slower one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <vector>
+#include <algorithm>
+
+enum { ECHO = 0, SINK = 1, SOURCE = 2, SERVERS = 3 };
+
+static const char *server_names[SERVERS] = { "echo", "sink", "source" };
+
+static const char *binary       = "./portfwdXOR";
+static int         clients      = 8;
+static double      duration     = 5.0;
+static int         base_port    = 19100;
+static int         request_size = 64;
+
+static std::vector<const char *> options;
+
+static volatile int stopping = 0;
+
+static long long sink_bytes  = 0; /* received by the sink server, atomically */
+static long long sink_errors = 0; /* corrupt streams seen by the sink, atomically */
+
+const int CHUNK = 64 * 1024;
+
+/*
+ * Byte n of every stream is n % PERIOD, so that lost, repeated or
+ * mangled data shows; a prime period keeps it out of step with CHUNK.
+ */
+const int PERIOD = 251;
+
+static char pattern[CHUNK + PERIOD];
+
+static void init_pattern()
+{
+  for (int i = 0; i < CHUNK + PERIOD; ++i)
+    pattern[i] = (char) (i % PERIOD);
+}
+
+/*
+ * Returns the CHUNK pattern bytes due at stream offset off.
+ */
+static const char *pattern_at(long long off)
+{
+  return pattern + off % PERIOD;
+}
+
+static double now_s()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fail(const char *what)
+{
+  perror(what);
+  exit(1);
+}
+
+/*
+ * Returns -1 on failure; file descriptor on success.
+ */
+static int connect_port(int port)
+{
+  int sd = socket(PF_INET, SOCK_STREAM, 0);
+  if (sd == -1)
+    return -1;
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family      = AF_INET;
+  sa.sin_port        = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (connect(sd, (struct sockaddr *) &sa, sizeof(sa))) {
+    close(sd);
+    return -1;
+  }
+
+  int one = 1;
+  setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  /*
+   * Let blocked clients notice the end of a test.
+   */
+  struct timeval tv = { 1, 0 };
+  setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(sd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  return sd;
+}
+
+/*
+ * Returns 0 on EOF or failure; bytes read on success.
+ */
+static int read_full(int sd, char *buf, int len)
+{
+  int got = 0;
+  while (got < len) {
+    int rd = read(sd, buf + got, len - got);
+    if (rd <= 0)
+      return 0;
+    got += rd;
+  }
+  return got;
+}
+
+static int write_full(int sd, const char *buf, int len)
+{
+  int done = 0;
+  while (done < len) {
+    int wr = write(sd, buf + done, len - done);
+    if (wr <= 0)
+      return -1;
+    done += wr;
+  }
+  return 0;
+}
+
+/*
+ * Servers: a thread per connection.
+ */
+struct conn_arg {
+  int sd;
+  int kind;
+};
+
+static void *serve_conn(void *p)
+{
+  conn_arg *arg = (conn_arg *) p;
+  int sd = arg->sd;
+  int kind = arg->kind;
+  delete arg;
+
+  char *buf = new char[CHUNK];
+  long long off = 0;
+
+  for (;;) {
+    if (kind == SOURCE) {
+      if (write_full(sd, pattern_at(off), CHUNK))
+	break;
+      off += CHUNK;
+      continue;
+    }
+
+    int rd = read(sd, buf, CHUNK);
+    if (rd <= 0)
+      break;
+    if (kind == SINK) {
+      if (memcmp(buf, pattern_at(off), rd)) {
+	__sync_fetch_and_add(&sink_errors, 1);
+	break;
+      }
+      off += rd;
+      __sync_fetch_and_add(&sink_bytes, rd);
+    }
+    else if (write_full(sd, buf, rd))
+      break;
+  }
+
+  delete [] buf;
+  close(sd);
+  return 0;
+}
+
+static void *serve(void *p)
+{
+  long kind = (long) p;
+
+  int sd = socket(PF_INET, SOCK_STREAM, 0);
+  if (sd == -1)
+    fail("socket");
+
+  int one = 1;
+  setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family      = AF_INET;
+  sa.sin_port        = htons(base_port + kind);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(sd, (struct sockaddr *) &sa, sizeof(sa)) || listen(sd, 1024))
+    fail(server_names[kind]);
+
+  for (;;) {
+    int csd = accept(sd, 0, 0);
+    if (csd == -1)
+      continue;
+
+    conn_arg *arg = new conn_arg;
+    arg->sd = csd;
+    arg->kind = (int) kind;
+
+    pthread_t t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&t, &attr, serve_conn, arg)) {
+      close(csd);
+      delete arg;
+    }
+    pthread_attr_destroy(&attr);
+  }
+
+  return 0;
+}
+
+/*
+ * Tunnel: one portfwdXOR for each side, in process groups of their
+ * own so their children go with them.
+ */
+static pid_t tunnel[2];
+static char  conf_dir[] = "/tmp/tunnel_bench.XXXXXX";
+
+static void write_conf(const char *path, int remote)
+{
+  FILE *f = fopen(path, "w");
+  if (!f)
+    fail(path);
+
+  fprintf(f, "xor-key         2026054146659\n");
+  fprintf(f, "confusing-key   74132604721569\n");
+  fprintf(f, "remote-server   %s\n", remote ? "yes" : "no");
+  for (unsigned i = 0; i < options.size(); ++i)
+    fprintf(f, "%s\n", options[i]);
+
+  fprintf(f, "tcp\n{\n");
+  for (int k = 0; k < SERVERS; ++k) {
+    int listen_port = base_port + (remote ? 10 : 20) + k;
+    int dst_port    = base_port + (remote ? 0 : 10) + k;
+    fprintf(f, "        %d { => 127.0.0.1:%d }%s\n", listen_port, dst_port, k < SERVERS - 1 ? ";" : "");
+  }
+  fprintf(f, "}\n");
+
+  fclose(f);
+}
+
+static pid_t start_portfwd(const char *conf)
+{
+  pid_t pid = fork();
+  if (pid < 0)
+    fail("fork");
+
+  if (!pid) {
+    setpgid(0, 0);
+    execl(binary, binary, "-g", "-c", conf, (char *) 0);
+    perror(binary);
+    _exit(1);
+  }
+
+  setpgid(pid, pid);
+  return pid;
+}
+
+static void stop_tunnel()
+{
+  for (int i = 0; i < 2; ++i)
+    if (tunnel[i] > 0) {
+      kill(-tunnel[i], SIGKILL);
+      waitpid(tunnel[i], 0, 0);
+      tunnel[i] = 0;
+    }
+
+  char path[256];
+  snprintf(path, sizeof(path), "%s/remote.conf", conf_dir);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/local.conf", conf_dir);
+  unlink(path);
+  rmdir(conf_dir);
+}
+
+static void start_tunnel()
+{
+  if (!mkdtemp(conf_dir))
+    fail("mkdtemp");
+
+  char remote_conf[256];
+  char local_conf[256];
+  snprintf(remote_conf, sizeof(remote_conf), "%s/remote.conf", conf_dir);
+  snprintf(local_conf, sizeof(local_conf), "%s/local.conf", conf_dir);
+  write_conf(remote_conf, 1);
+  write_conf(local_conf, 0);
+
+  tunnel[0] = start_portfwd(remote_conf);
+  tunnel[1] = start_portfwd(local_conf);
+  atexit(stop_tunnel);
+
+  /*
+   * Wait until the whole chain answers.
+   */
+  double deadline = now_s() + 10;
+  for (;;) {
+    int sd = connect_port(base_port + 20 + ECHO);
+    if (sd != -1) {
+      char c = 'x';
+      int ok = !write_full(sd, &c, 1) && read_full(sd, &c, 1);
+      close(sd);
+      if (ok)
+	break;
+    }
+    if (now_s() > deadline) {
+      fprintf(stderr, "Tunnel not answering on port %d\n", base_port + 20 + ECHO);
+      exit(1);
+    }
+    usleep(100000);
+  }
+}
+
+/*
+ * Clients: one thread each, all stopped together.
+ */
+struct client {
+  pthread_t             thread;
+  int                   id;
+  long long             bytes;
+  long long             count;
+  long long             errors;
+  std::vector<double>   latencies;
+};
+
+typedef void *(*client_fn)(void *);
+
+static void run_clients(std::vector<client> &cl, client_fn fn)
+{
+  stopping = 0;
+  cl.resize(clients);
+  for (int i = 0; i < clients; ++i) {
+    cl[i].id = i;
+    cl[i].bytes = 0;
+    cl[i].count = 0;
+    cl[i].errors = 0;
+    if (pthread_create(&cl[i].thread, 0, fn, &cl[i]))
+      fail("pthread_create");
+  }
+
+  usleep((useconds_t) (duration * 1e6));
+  stopping = 1;
+
+  for (int i = 0; i < clients; ++i)
+    pthread_join(cl[i].thread, 0);
+}
+
+/*
+ * The streaming clients hold one connection until the end; one that
+ * times out, ends or goes corrupt before then counts as an error.
+ */
+static void *bulk_up(void *p)
+{
+  client *c = (client *) p;
+
+  while (!stopping) {
+    int sd = connect_port(base_port + 20 + SINK);
+    if (sd == -1) {
+      ++c->errors;
+      usleep(10000);
+      continue;
+    }
+    long long off = 0;
+    while (!stopping && !write_full(sd, pattern_at(off), CHUNK))
+      off += CHUNK;
+    if (!stopping)
+      ++c->errors;
+    close(sd);
+  }
+
+  return 0;
+}
+
+static void *bulk_down(void *p)
+{
+  client *c = (client *) p;
+  char *buf = new char[CHUNK];
+
+  while (!stopping) {
+    int sd = connect_port(base_port + 20 + SOURCE);
+    if (sd == -1) {
+      ++c->errors;
+      usleep(10000);
+      continue;
+    }
+    long long off = 0;
+    while (!stopping) {
+      int rd = read(sd, buf, CHUNK);
+      if (rd <= 0 || memcmp(buf, pattern_at(off), rd)) {
+	if (!stopping)
+	  ++c->errors;
+	break;
+      }
+      off += rd;
+      c->bytes += rd;
+    }
+    close(sd);
+  }
+
+  delete [] buf;
+  return 0;
+}
+
+static void *connect_loop(void *p)
+{
+  client *c = (client *) p;
+
+  while (!stopping) {
+    int sd = connect_port(base_port + 20 + ECHO);
+    if (sd == -1) {
+      ++c->errors;
+      continue;
+    }
+
+    char ch = 'x';
+    if (!write_full(sd, &ch, 1) && read_full(sd, &ch, 1))
+      ++c->count;
+    else
+      ++c->errors;
+
+    /*
+     * Reset rather than leave TIME_WAIT behind on the client side.
+     */
+    struct linger lg = { 1, 0 };
+    setsockopt(sd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    close(sd);
+  }
+
+  return 0;
+}
+
+/*
+ * Each request starts one byte further into the pattern, and has to
+ * come back whole and unchanged within the socket timeout.
+ */
+static void *request_response(void *p)
+{
+  client *c = (client *) p;
+  char *req = new char[request_size];
+  char *rsp = new char[request_size];
+
+  int sd = connect_port(base_port + 20 + ECHO);
+  if (sd == -1) {
+    ++c->errors;
+    delete [] req;
+    delete [] rsp;
+    return 0;
+  }
+
+  while (!stopping) {
+    for (int i = 0; i < request_size; ++i)
+      req[i] = (char) ((c->count + i) % PERIOD);
+
+    double t = now_s();
+    if (write_full(sd, req, request_size) || !read_full(sd, rsp, request_size) ||
+	memcmp(req, rsp, request_size)) {
+      ++c->errors;
+      break;
+    }
+    c->latencies.push_back(now_s() - t);
+    ++c->count;
+  }
+
+  close(sd);
+  delete [] req;
+  delete [] rsp;
+  return 0;
+}
+
+static long long total_errors(const std::vector<client> &cl)
+{
+  long long n = 0;
+  for (unsigned i = 0; i < cl.size(); ++i)
+    n += cl[i].errors;
+  return n;
+}
+
+static void test_bulk_up()
+{
+  std::vector<client> cl;
+  long long before = sink_bytes;
+  double t = now_s();
+  run_clients(cl, bulk_up);
+  double elapsed = now_s() - t;
+  long long bytes = __sync_fetch_and_add(&sink_bytes, 0) - before;
+  long long corrupt = __sync_fetch_and_and(&sink_errors, 0);
+
+  printf("%-10s %8.1f MB/s  (%d clients, %lld errors)\n", "bulk-up", bytes / elapsed / 1e6, clients, total_errors(cl) + corrupt);
+}
+
+static void test_bulk_down()
+{
+  std::vector<client> cl;
+  double t = now_s();
+  run_clients(cl, bulk_down);
+  double elapsed = now_s() - t;
+
+  long long bytes = 0;
+  for (unsigned i = 0; i < cl.size(); ++i)
+    bytes += cl[i].bytes;
+
+  printf("%-10s %8.1f MB/s  (%d clients, %lld errors)\n", "bulk-down", bytes / elapsed / 1e6, clients, total_errors(cl));
+}
+
+static void test_connect()
+{
+  std::vector<client> cl;
+  double t = now_s();
+  run_clients(cl, connect_loop);
+  double elapsed = now_s() - t;
+
+  long long n = 0;
+  for (unsigned i = 0; i < cl.size(); ++i)
+    n += cl[i].count;
+
+  printf("%-10s %8.0f conn/s  (%d clients, %lld errors)\n", "connect", n / elapsed, clients, total_errors(cl));
+}
+
+static double percentile(const std::vector<double> &v, double p)
+{
+  if (v.empty())
+    return 0;
+  size_t i = (size_t) (p * (v.size() - 1) + 0.5);
+  return v[i];
+}
+
+static void test_rr()
+{
+  std::vector<client> cl;
+  double t = now_s();
+  run_clients(cl, request_response);
+  double elapsed = now_s() - t;
+
+  std::vector<double> all;
+  for (unsigned i = 0; i < cl.size(); ++i)
+    all.insert(all.end(), cl[i].latencies.begin(), cl[i].latencies.end());
+  std::sort(all.begin(), all.end());
+
+  printf("%-10s %8.0f req/s  p50 %.1f us  p99 %.1f us  p999 %.1f us  (%d clients, %d bytes, %lld errors)\n",
+	 "rr", all.size() / elapsed,
+	 percentile(all, 0.5) * 1e6, percentile(all, 0.99) * 1e6, percentile(all, 0.999) * 1e6,
+	 clients, request_size, total_errors(cl));
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-b <portfwdXOR>] [-c <clients>] [-t <seconds>] [-p <base port>]\n"
+	          "       [-s <request size>] [-o <option line>]... [bulk-up|bulk-down|connect|rr]...\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  int opt;
+  while ((opt = getopt(argc, argv, "b:c:t:p:s:o:")) != -1)
+    switch (opt) {
+    case 'b': binary       = optarg;       break;
+    case 'c': clients      = atoi(optarg); break;
+    case 't': duration     = atof(optarg); break;
+    case 'p': base_port    = atoi(optarg); break;
+    case 's': request_size = atoi(optarg); break;
+    case 'o': options.push_back(optarg);   break;
+    default:  usage(argv[0]);
+    }
+  if (clients < 1 || duration <= 0 || base_port < 1 || base_port > 65500 || request_size < 1)
+    usage(argv[0]);
+
+  signal(SIGPIPE, SIG_IGN);
+  init_pattern();
+
+  for (long k = 0; k < SERVERS; ++k) {
+    pthread_t t;
+    if (pthread_create(&t, 0, serve, (void *) k))
+      fail("pthread_create");
+  }
+
+  start_tunnel();
+
+  static const char *all_tests[] = { "bulk-up", "bulk-down", "connect", "rr", 0 };
+
+  const char **tests = optind < argc ? (const char **) argv + optind : all_tests;
+  for (int i = optind; i < argc; ++i)
+    if (strcmp(argv[i], "bulk-up") && strcmp(argv[i], "bulk-down") &&
+	strcmp(argv[i], "connect") && strcmp(argv[i], "rr"))
+      usage(argv[0]);
+
+  for (int i = 0; tests[i]; ++i) {
+    const char *name = tests[i];
+    if (!strcmp(name, "bulk-up"))
+      test_bulk_up();
+    else if (!strcmp(name, "bulk-down"))
+      test_bulk_down();
+    else if (!strcmp(name, "connect"))
+      test_connect();
+    else
+      test_rr();
+  }
+
+  return 0;
+}
+
+/* Eof: tunnel_bench.cc */
@@ -16,8 +16,10 @@
 #include "proto_map.hpp"
 #include "entry.hpp"
 #include "dst_addr.hpp"
+#include "dns_cache.hpp"
 #include "director.hpp"
 #include "portfwd.h"
+#include "map_opts.h"
 
 /*
  * These are from the lexical analyzer defined in conf.lex
@@ -63,6 +65,7 @@ int            conf_group  = -1;
 long long      conf_xor_key = 0;
 long long      conf_confusing_key = 0;
 int	       conf_is_remote_server = 0;
+struct map_opts conf_opts          = default_map_opts();
 
 const struct ip_addr conf_any_addr = solve_hostname(ANY_ADDR);
 struct ip_addr conf_listen         = conf_any_addr;
@@ -76,6 +79,52 @@ int mask_len_value(const char *len)
   return atoi(len);
 }
 
+int yes_value(const char *answer)
+{
+  return answer[0] == 'Y' || answer[0] == 'y';
+}
+
+int positive_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 1)
+    yyerror("positive number expected");
+  return value;
+}
+
+/*
+ * Like positive_value(), with 0 turning the option off.
+ */
+int count_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 0)
+    yyerror("number expected");
+  return value;
+}
+
+/*
+ * Weight of a destination: 1 to MAX_WEIGHT.
+ */
+int weight_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 1 || value > MAX_WEIGHT)
+    yyerror("weight out of range");
+  return value;
+}
+
+/*
+ * Length of an IPv4 network prefix: 0 to 32 bits.
+ */
+int prefix_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 0 || value > 32)
+    yyerror("prefix length expected");
+  return value;
+}
+
 void set_protoname(proto_t proto)
 {
   curr_proto = proto;
@@ -103,9 +152,15 @@ net_portion *use_hostprefix(char *hostname, int prefix_len)
 
 to_addr *use_dstaddr(char *hostname, int port)
 {
-  return new dst_addr(on_the_fly_dns ? safe_strdup(hostname) : 0, 
-		     use_hostname(hostname), 
-		     port);
+  dns_entry *name = 0;
+  struct ip_addr ip = solve_hostname(hostname);
+
+  if (on_the_fly_dns)
+    name = name_cache.add(hostname, &ip, conf_opts.dns_ttl,
+			  conf_opts.dns_negative_ttl, conf_opts.dns_stale);
+
+  free(hostname);
+  return new dst_addr(name, ip, port);
 }
 
 %}
@@ -135,6 +190,39 @@ to_addr *use_dstaddr(char *hostname, int port)
 %token TK_CONFUSING_KEY
 %token TK_STRING
 %token TK_FRAGILE
+%token TK_WORKERS
+%token TK_CPU_AFFINITY
+%token TK_IO_URING
+%token TK_CONNECT_TIMEOUT
+%token TK_HANDSHAKE_TIMEOUT
+%token TK_PLAIN
+%token TK_EJECT_AFTER
+%token TK_HEALTH_CHECK
+%token TK_FAILOVER
+%token TK_ROUND_ROBIN
+%token TK_LEAST_CONN
+%token TK_LEAST_LATENCY
+%token TK_WEIGHT
+%token TK_WARM_POOL
+%token TK_MUX
+%token TK_FAST_OPEN
+%token TK_PIPELINE_KEYS
+%token TK_BACKLOG
+%token TK_NODELAY
+%token TK_SEND_BUFFER
+%token TK_RECEIVE_BUFFER
+%token TK_KEEPALIVE
+%token TK_NOTSENT_LOWAT
+%token TK_MAX_CONNECTIONS
+%token TK_MAX_PER_SOURCE
+%token TK_IDLE_TIMEOUT
+%token TK_SESSION_TIMEOUT
+%token TK_ACCEPT_RATE
+%token TK_ACCEPT_BURST
+%token TK_ACCEPT_PREFIX
+%token TK_DNS_TTL
+%token TK_DNS_NEGATIVE_TTL
+%token TK_DNS_STALE
 
 %token TK_ILLEGAL
 
@@ -157,6 +245,7 @@ to_addr *use_dstaddr(char *hostname, int port)
 }
 
 %type <int_type>	prefix_length;
+%type <int_type>	balance;
 %type <bool_type>	fragile;
 %type <port_type>       port_range;
 %type <str_type>        name;
@@ -164,6 +253,7 @@ to_addr *use_dstaddr(char *hostname, int port)
 %type <from_type>       from;
 %type <from_list_type>  from_list;
 %type <dst_type>        dst;
+%type <dst_type>        weighted_dst;
 %type <dst_list_type>   dst_list;
 %type <host_map_type>   host_map;
 %type <host_list_type>  host_list;
@@ -190,17 +280,45 @@ stmt_list:      stmt |
 stmt:           entry { entry_vector-> push($1); } |
                 global_option ;
 
-global_option:  TK_USER TK_NAME { conf_user = solve_user(conf_ident); } |
-                TK_GROUP TK_NAME { conf_group = solve_group(conf_ident); } |
-                TK_LISTEN TK_NAME { conf_listen = solve_hostname(conf_ident); } |
-		TK_XOR_KEY TK_NAME { conf_xor_key = atoll(conf_ident); } |
-  		TK_CONFUSING_KEY TK_NAME { conf_confusing_key = atoll(conf_ident); } |
-  		TK_REMOTE_SERVER TK_NAME { conf_is_remote_server = conf_ident[0]=='Y' ||  conf_ident[0]=='y';} |
-                TK_SOURCE TK_NAME {
+global_option:  TK_USER ident { conf_user = solve_user(conf_ident); } |
+                TK_GROUP ident { conf_group = solve_group(conf_ident); } |
+                TK_LISTEN ident { conf_listen = solve_hostname(conf_ident); } |
+		TK_XOR_KEY ident { conf_xor_key = atoll(conf_ident); } |
+  		TK_CONFUSING_KEY ident { conf_confusing_key = atoll(conf_ident); } |
+  		TK_REMOTE_SERVER ident { conf_is_remote_server = yes_value(conf_ident); } |
+		TK_WORKERS ident { conf_opts.workers = positive_value(conf_ident); } |
+		TK_CPU_AFFINITY ident { conf_opts.cpu_affinity = yes_value(conf_ident); } |
+		TK_IO_URING ident { conf_opts.io_uring = yes_value(conf_ident); } |
+		TK_CONNECT_TIMEOUT ident { conf_opts.connect_timeout = positive_value(conf_ident); } |
+		TK_HANDSHAKE_TIMEOUT ident { conf_opts.handshake_timeout = positive_value(conf_ident); } |
+		TK_PLAIN ident { conf_opts.plain = yes_value(conf_ident); } |
+		TK_EJECT_AFTER ident { conf_opts.eject_after = count_value(conf_ident); } |
+		TK_HEALTH_CHECK ident { conf_opts.health_check = count_value(conf_ident); } |
+		TK_WARM_POOL ident { conf_opts.warm_pool = count_value(conf_ident); } |
+		TK_MUX ident { conf_opts.mux = count_value(conf_ident); } |
+		TK_FAST_OPEN ident { conf_opts.fast_open = count_value(conf_ident); } |
+		TK_PIPELINE_KEYS ident { conf_opts.pipeline_keys = yes_value(conf_ident); } |
+		TK_BACKLOG ident { conf_opts.backlog = positive_value(conf_ident); } |
+		TK_NODELAY ident { conf_opts.nodelay = yes_value(conf_ident); } |
+		TK_SEND_BUFFER ident { conf_opts.send_buffer = count_value(conf_ident); } |
+		TK_RECEIVE_BUFFER ident { conf_opts.receive_buffer = count_value(conf_ident); } |
+		TK_KEEPALIVE ident { conf_opts.keepalive = count_value(conf_ident); } |
+		TK_NOTSENT_LOWAT ident { conf_opts.notsent_lowat = count_value(conf_ident); } |
+		TK_MAX_CONNECTIONS ident { conf_opts.max_connections = count_value(conf_ident); } |
+		TK_MAX_PER_SOURCE ident { conf_opts.max_per_source = count_value(conf_ident); } |
+		TK_IDLE_TIMEOUT ident { conf_opts.idle_timeout = count_value(conf_ident); } |
+		TK_SESSION_TIMEOUT ident { conf_opts.session_timeout = count_value(conf_ident); } |
+		TK_ACCEPT_RATE ident { conf_opts.accept_rate = count_value(conf_ident); } |
+		TK_ACCEPT_BURST ident { conf_opts.accept_burst = count_value(conf_ident); } |
+		TK_ACCEPT_PREFIX ident { conf_opts.accept_prefix = prefix_value(conf_ident); } |
+		TK_DNS_TTL ident { conf_opts.dns_ttl = positive_value(conf_ident); } |
+		TK_DNS_NEGATIVE_TTL ident { conf_opts.dns_negative_ttl = positive_value(conf_ident); } |
+		TK_DNS_STALE ident { conf_opts.dns_stale = count_value(conf_ident); } |
+                TK_SOURCE ident {
 					conf_source = solve_hostname(conf_ident); 
 					conf_src = &conf_source;
 		} |
-		TK_BIND TK_NAME { conf_listen = solve_hostname(conf_ident); };
+		TK_BIND ident { conf_listen = solve_hostname(conf_ident); };
 
 entry:         fragile TK_TCP set_proto_tcp section { $$ = new entry(P_TCP, $4, $1); } | 
                        TK_UDP set_proto_udp section { $$ = new entry(P_UDP, $3, 0 /* false */); } ;
@@ -224,28 +342,44 @@ map_list:	map {
 		} ;
 
 map:	        port_list TK_LBRACE host_list TK_RBRACE {
-			$$ = new proto_map($1, $3, 0, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			$$ = new proto_map($1, $3, 0, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		} | 
                 port_list TK_ACTV name TK_LBRACE host_list TK_RBRACE {
 		        struct ip_addr ip = use_hostname($3);
-			$$ = new proto_map($1, $5, &ip, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			$$ = new proto_map($1, $5, &ip, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		} |
                 port_list TK_PASV name TK_LBRACE host_list TK_RBRACE {
 		        struct ip_addr ip = use_hostname($3);
-			$$ = new proto_map($1, $5, 0, &ip, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			$$ = new proto_map($1, $5, 0, &ip, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		} |
                 port_list TK_ACTV name TK_PASV name TK_LBRACE host_list TK_RBRACE {
 		        struct ip_addr ip1 = use_hostname($3);
 		        struct ip_addr ip2 = use_hostname($5);
-			$$ = new proto_map($1, $7, &ip1, &ip2, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			$$ = new proto_map($1, $7, &ip1, &ip2, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		} |
                 port_list TK_PASV name TK_ACTV name TK_LBRACE host_list TK_RBRACE {
 		        struct ip_addr ip1 = use_hostname($3);
 		        struct ip_addr ip2 = use_hostname($5);
-			$$ = new proto_map($1, $7, &ip2, &ip1, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			$$ = new proto_map($1, $7, &ip2, &ip1, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		} ;
 
-name:           TK_NAME { $$ = safe_strdup(conf_ident); } ;
+name:           ident { $$ = safe_strdup(conf_ident); } ;
+
+/*
+ * Tuning options and balance strategies are only keywords where the
+ * grammar expects one: anywhere else they are names like any other,
+ * leaving conf_ident as it is.
+ */
+ident:          TK_NAME |
+		TK_WORKERS | TK_CPU_AFFINITY | TK_IO_URING | TK_CONNECT_TIMEOUT |
+		TK_HANDSHAKE_TIMEOUT | TK_PLAIN | TK_EJECT_AFTER | TK_HEALTH_CHECK |
+		TK_FAILOVER | TK_ROUND_ROBIN | TK_LEAST_CONN | TK_LEAST_LATENCY |
+		TK_WEIGHT | TK_WARM_POOL | TK_MUX | TK_FAST_OPEN | TK_PIPELINE_KEYS |
+		TK_BACKLOG | TK_NODELAY | TK_SEND_BUFFER | TK_RECEIVE_BUFFER |
+		TK_KEEPALIVE | TK_NOTSENT_LOWAT | TK_MAX_CONNECTIONS |
+		TK_MAX_PER_SOURCE | TK_IDLE_TIMEOUT | TK_SESSION_TIMEOUT |
+		TK_ACCEPT_RATE | TK_ACCEPT_BURST | TK_ACCEPT_PREFIX | TK_DNS_TTL |
+		TK_DNS_NEGATIVE_TTL | TK_DNS_STALE ;
 
 port_list:      name {
 			port_vector = new vector<int>();
@@ -268,19 +402,35 @@ host_list:	host_map {
 		} ;
 
 host_map:	from_list TK_ARROW dst_list {
-			$$ = new host_map($1, $3);
+			$$ = new host_map($1, $3, BALANCE_ROUND_ROBIN);
+		} |
+		from_list TK_ARROW balance dst_list {
+			$$ = new host_map($1, $4, (balance_t) $3);
 		} ;
 
-dst_list:       dst {
+balance:	TK_FAILOVER { $$ = BALANCE_FAILOVER; } |
+		TK_ROUND_ROBIN { $$ = BALANCE_ROUND_ROBIN; } |
+		TK_LEAST_CONN { $$ = BALANCE_LEAST_CONN; } |
+		TK_LEAST_LATENCY { $$ = BALANCE_LEAST_LATENCY; } ;
+
+dst_list:       weighted_dst {
 			dst_vector = new vector<to_addr*>();
 			dst_vector->push($1);
 			$$ = dst_vector;
                 } |
-                dst_list TK_COMMA dst {
+                dst_list TK_COMMA weighted_dst {
 			dst_vector->push($3);
 			$$ = dst_vector;
                 } ;
 
+weighted_dst:   dst {
+			$$ = $1;
+		} |
+		dst TK_WEIGHT ident {
+			$1->set_weight(weight_value(conf_ident));
+			$$ = $1;
+		} ;
+
 dst:            name TK_COLON name {
 			int port = use_port($3);   /* solve portname */
 			$$ = use_dstaddr($1, port); /* new dst_addr() */
@@ -318,7 +468,7 @@ host_prefix:    name prefix_length {
 		} ;
 
 prefix_length:  /* empty */ { $$ = MAX_MASK_LEN; } |
-                TK_SLASH TK_NAME { $$ = mask_len_value(conf_ident); } ;
+                TK_SLASH ident { $$ = mask_len_value(conf_ident); } ;
 
 port_range:	name {
 			int port = use_port($1);
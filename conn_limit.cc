@@ -0,0 +1,93 @@
+/*
+  conn_limit.cc
+
+  $Id: conn_limit.cc,v 1.1 2026/10/17 23:31:06 cvs Exp $
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "conn_limit.hpp"
+
+conn_limit::conn_limit(int max_total, int max_per_source)
+{
+  this->max_total      = max_total;
+  this->max_per_source = max_per_source;
+  total                = 0;
+  pthread_mutex_init(&lock, 0);
+  memset(sources, 0, sizeof(sources));
+}
+
+unsigned int conn_limit::bucket(unsigned int addr)
+{
+  return (addr * 2654435761u) >> 22; /* 10 bits: SOURCE_BUCKETS */
+}
+
+int conn_limit::enter(unsigned int addr)
+{
+  if (__sync_add_and_fetch(&total, 1) > max_total && max_total) {
+    __sync_sub_and_fetch(&total, 1);
+    return -1;
+  }
+
+  if (!max_per_source)
+    return 0;
+
+  pthread_mutex_lock(&lock);
+
+  source **b = &sources[bucket(addr)];
+  source *s = *b;
+  while (s && s->addr != addr)
+    s = s->next;
+
+  if (!s) {
+    s = (source *) malloc(sizeof(source));
+    if (!s) {
+      pthread_mutex_unlock(&lock);
+      syslog(LOG_ERR, "Can't allocate client count");
+      __sync_sub_and_fetch(&total, 1);
+      return -1;
+    }
+    s->addr  = addr;
+    s->count = 0;
+    s->next  = *b;
+    *b = s;
+  }
+
+  int full = s->count >= max_per_source;
+  if (!full)
+    ++s->count;
+
+  pthread_mutex_unlock(&lock);
+
+  if (full) {
+    __sync_sub_and_fetch(&total, 1);
+    return -1;
+  }
+  return 0;
+}
+
+void conn_limit::leave(unsigned int addr)
+{
+  __sync_sub_and_fetch(&total, 1);
+
+  if (!max_per_source)
+    return;
+
+  pthread_mutex_lock(&lock);
+
+  source **p = &sources[bucket(addr)];
+  while (*p && (*p)->addr != addr)
+    p = &(*p)->next;
+
+  source *s = *p;
+  if (s && !--s->count) {
+    *p = s->next;
+    free(s);
+  }
+
+  pthread_mutex_unlock(&lock);
+}
+
+/* Eof: conn_limit.cc */
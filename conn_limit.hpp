@@ -0,0 +1,53 @@
+/*
+  conn_limit.hpp
+
+  $Id: conn_limit.hpp,v 1.1 2026/10/17 23:31:06 cvs Exp $
+ */
+
+#ifndef CONN_LIMIT_HPP
+#define CONN_LIMIT_HPP
+
+#include <pthread.h>
+
+/*
+ * Clients a map serves at once, in total and by source address,
+ * shared by its workers: see max-connections and max-per-source.
+ */
+class conn_limit
+{
+private:
+  struct source {
+    unsigned int addr;   /* network byte order */
+    int          count;
+    source       *next;
+  };
+
+  enum { SOURCE_BUCKETS = 1024 };
+
+  int             max_total;       /* 0: no limit */
+  int             max_per_source;  /* 0: no limit */
+  int             total;
+  pthread_mutex_t lock;            /* sources */
+  source          *sources[SOURCE_BUCKETS];
+
+  static unsigned int bucket(unsigned int addr);
+
+public:
+  conn_limit(int max_total, int max_per_source);
+
+  /*
+   * Counts a client from "addr".
+   *
+   * Returns -1 if it is one too many; 0 on success.
+   */
+  int enter(unsigned int addr);
+
+  /*
+   * Gives back the place of a client counted by enter().
+   */
+  void leave(unsigned int addr);
+};
+
+#endif /* CONN_LIMIT_HPP */
+
+/* Eof: conn_limit.hpp */
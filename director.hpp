@@ -36,6 +36,8 @@ public:
 	const struct sockaddr_in *cli_sa, 
 	const struct sockaddr_in *local_cli_sa, 
 	const struct ip_addr **addr, int *prt);
+
+  int client_dependent() const { return 1; }
 };
 
 #endif /* DIRECTOR_HPP */
@@ -0,0 +1,199 @@
+/*
+  dns_cache.cc
+
+  $Id: dns_cache.cc,v 1.1 2026/10/18 00:24:10 cvs Exp $
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "util.h"
+#include "dns_cache.hpp"
+
+struct dns_entry {
+  char            *name;
+  int             ttl;           /* seconds an answer is good for */
+  int             negative_ttl;  /* seconds between attempts after a failure */
+  int             stale;         /* seconds an old answer is served past its ttl */
+
+  pthread_mutex_t lock;          /* addr, len, expires */
+  char            addr[dns_cache::ADDR_MAX];
+  short           len;           /* 0: no answer */
+  time_t          expires;       /* of the answer */
+
+  time_t          due;           /* refresher only: next attempt */
+  int             failing;       /* refresher only: last attempt failed */
+
+  dns_entry       *next;
+};
+
+dns_cache name_cache;
+
+dns_cache::dns_cache()
+{
+  running = 0;
+  memset(names, 0, sizeof(names));
+}
+
+unsigned int dns_cache::bucket(const char *name)
+{
+  unsigned int h = 5381;
+  for (; *name; ++name)
+    h = h * 33 + (unsigned char) *name;
+  return h % NAME_BUCKETS;
+}
+
+dns_entry *dns_cache::add(const char *name, const struct ip_addr *addr,
+			  int ttl, int negative_ttl, int stale)
+{
+  time_t now = time(0);
+
+  dns_entry **b = &names[bucket(name)];
+  dns_entry *e = *b;
+  while (e && strcasecmp(e->name, name))
+    e = e->next;
+
+  if (e) {
+    e->ttl          = MIN(e->ttl, ttl);
+    e->negative_ttl = MIN(e->negative_ttl, negative_ttl);
+    e->stale        = MIN(e->stale, stale);
+    e->expires      = MIN(e->expires, now + ttl);
+    e->due          = MIN(e->due, now + MAX(ttl - ttl / 4, 1));
+    return e;
+  }
+
+  e = (dns_entry *) malloc(sizeof(dns_entry));
+  if (!e) {
+    syslog(LOG_ERR, "Can't allocate cache entry for hostname: %s", name);
+    exit(1);
+  }
+
+  e->name         = safe_strdup(name);
+  e->ttl          = ttl;
+  e->negative_ttl = negative_ttl;
+  e->stale        = stale;
+  pthread_mutex_init(&e->lock, 0);
+  e->len          = MIN(addr->len, (int) ADDR_MAX);
+  memcpy(e->addr, addr->addr, e->len);
+  e->expires      = now + ttl;
+  e->due          = now + MAX(ttl - ttl / 4, 1);
+  e->failing      = 0;
+  e->next         = *b;
+  *b = e;
+
+  return e;
+}
+
+int dns_cache::lookup(dns_entry *e, struct ip_addr *ip)
+{
+  time_t now = time(0);
+
+  pthread_mutex_lock(&e->lock);
+
+  int served = e->len && now < e->expires + e->stale;
+  if (served) {
+    memcpy(ip->addr, e->addr, e->len);
+    ip->len = e->len;
+  }
+
+  pthread_mutex_unlock(&e->lock);
+
+  return served ? 0 : -1;
+}
+
+/*
+ * Solves the name of "e" again. getaddrinfo() is safe for threads,
+ * unlike the gethostbyname() of solve_hostname().
+ */
+void dns_cache::refresh(dns_entry *e)
+{
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  int err = getaddrinfo(e->name, 0, &hints, &res);
+  time_t now = time(0);
+
+  if (err) {
+    e->due = now + e->negative_ttl;
+    if (!e->failing) {
+      e->failing = 1;
+      syslog(LOG_WARNING, "Can't solve hostname: %s: %s: serving its last address for %d seconds past its ttl",
+	     e->name, gai_strerror(err), e->stale);
+    }
+    return;
+  }
+
+  struct in_addr in = ((struct sockaddr_in *) res->ai_addr)->sin_addr;
+  freeaddrinfo(res);
+
+  pthread_mutex_lock(&e->lock);
+  int moved = e->len != sizeof(in) || memcmp(e->addr, &in, sizeof(in));
+  memcpy(e->addr, &in, sizeof(in));
+  e->len     = sizeof(in);
+  e->expires = now + e->ttl;
+  pthread_mutex_unlock(&e->lock);
+
+  e->due = now + MAX(e->ttl - e->ttl / 4, 1);
+
+  if (e->failing) {
+    e->failing = 0;
+    syslog(LOG_INFO, "Solved hostname again: %s", e->name);
+  }
+
+  if (moved) {
+    char buf[INET_ADDRSTRLEN];
+    ONVERBOSE(syslog(LOG_INFO, "Hostname %s now solves to %s", e->name,
+		     inet_ntop(AF_INET, &in, buf, sizeof(buf))));
+  }
+}
+
+void *dns_cache::refresh_run(void *arg)
+{
+  dns_cache *c = (dns_cache *) arg;
+
+  for (;;) {
+    time_t now  = time(0);
+    time_t next = now + 3600;
+
+    for (int i = 0; i < NAME_BUCKETS; ++i)
+      for (dns_entry *e = c->names[i]; e; e = e->next) {
+	if (e->due <= now)
+	  c->refresh(e);
+	next = MIN(next, e->due);
+      }
+
+    int wait = next - time(0);
+    sleep(MAX(wait, 1));
+  }
+
+  return 0;
+}
+
+int dns_cache::start()
+{
+  if (!__sync_bool_compare_and_swap(&running, 0, 1))
+    return 0;
+
+  pthread_t thread;
+  int err = pthread_create(&thread, 0, refresh_run, this);
+  if (err) {
+    syslog(LOG_ERR, "Can't start solving hostnames in the background: %s", strerror(err));
+    running = 0;
+    return -1;
+  }
+
+  pthread_detach(thread);
+  return 0;
+}
+
+/* Eof: dns_cache.cc */
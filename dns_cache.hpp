@@ -0,0 +1,77 @@
+/*
+  dns_cache.hpp
+
+  $Id: dns_cache.hpp,v 1.1 2026/10/18 00:24:10 cvs Exp $
+ */
+
+#ifndef DNS_CACHE_HPP
+#define DNS_CACHE_HPP
+
+#include <pthread.h>
+
+#include "addr.h"
+
+struct dns_entry;
+
+/*
+ * Addresses of the destinations solved on the fly (--on-the-fly-dns),
+ * shared by the workers of a forwarder. Names are entered while the
+ * configuration is read; from then on a thread of their own solves
+ * them again in the background, and the workers only copy the last
+ * answer out of the cache.
+ *
+ * An answer is solved again when three quarters of its dns-ttl are
+ * gone. Should that fail, the name is tried again every
+ * dns-negative-ttl seconds, and the old answer is served until
+ * dns-stale seconds past its dns-ttl: after that, connections to the
+ * name fail until it can be solved again.
+ */
+class dns_cache
+{
+private:
+  enum { NAME_BUCKETS = 64 };
+
+  dns_entry *names[NAME_BUCKETS];
+  int       running;
+
+  static unsigned int bucket(const char *name);
+  static void *refresh_run(void *arg);
+
+  void refresh(dns_entry *e);
+
+public:
+  enum { ADDR_MAX = 16 };
+
+  dns_cache();
+
+  /*
+   * Enters "name", solved as "addr" while reading the configuration.
+   * A name entered twice keeps the shortest times of both.
+   *
+   * Returns the entry of the name.
+   */
+  dns_entry *add(const char *name, const struct ip_addr *addr,
+		 int ttl, int negative_ttl, int stale);
+
+  /*
+   * Copies the address of "e" to "ip", whose buffer holds ADDR_MAX
+   * bytes.
+   *
+   * Returns -1 if the name has no address to serve; 0 on success.
+   */
+  int lookup(dns_entry *e, struct ip_addr *ip);
+
+  /*
+   * Starts solving the names again in the background, once per
+   * process: call it from the forwarder, after fork().
+   *
+   * Returns -1 on failure; 0 on success.
+   */
+  int start();
+};
+
+extern dns_cache name_cache;
+
+#endif /* DNS_CACHE_HPP */
+
+/* Eof: dns_cache.hpp */
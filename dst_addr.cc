@@ -11,7 +11,6 @@
 #include "util.h"
 #include "addr.h"
 #include "dst_addr.hpp"
-#include "solve.h"
 
 void dst_addr::show() const
 {
@@ -25,10 +24,34 @@ int dst_addr::get_addr(const char *protoname,
 	const struct ip_addr **addr, int *prt)
 {
   if (name) {
-    free(address.addr);
-    struct ip_addr ad = solve_hostname(name);
-    memcpy((void *) &address, (void *) &ad, sizeof(ad));
+    /*
+     * Good until the next call in this thread: the caller copies it
+     * right away.
+     */
+    static __thread char           solved_buf[dns_cache::ADDR_MAX];
+    static __thread struct ip_addr solved;
+
+    solved.addr = solved_buf;
+    if (name_cache.lookup(name, &solved))
+      return -1;
+    *addr = &solved;
   }
+  else
+    *addr = &address;
+
+  *prt = port;
+
+  return 0;
+}
+
+/*
+ * Names solved on the fly are left alone: their address is the one
+ * in name_cache at the time of get_addr().
+ */
+int dst_addr::fixed_addr(const struct ip_addr **addr, int *prt) const
+{
+  if (name)
+    return -1;
 
   *addr = &address;
   *prt = port;
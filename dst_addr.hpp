@@ -12,16 +12,17 @@
 #include <sys/socket.h>
 
 #include "to_addr.hpp"
+#include "dns_cache.hpp"
 
 class dst_addr : public to_addr
 {
 private:
-  char           *name;
+  dns_entry      *name;     /* solved on the fly; 0: fixed address */
   struct ip_addr address;
   int            port;
 
 public:
-  dst_addr(char *hostname, struct ip_addr addr, int prt) 
+  dst_addr(dns_entry *hostname, struct ip_addr addr, int prt) 
     {
       name    = hostname;
       address = addr;
@@ -34,6 +35,8 @@ public:
 	const struct sockaddr_in *cli_sa, 
 	const struct sockaddr_in *local_cli_sa, 
 	const struct ip_addr **addr, int *prt);
+
+  int fixed_addr(const struct ip_addr **addr, int *prt) const;
 };
 
 #endif /* DST_ADDR_HPP */
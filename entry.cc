@@ -27,10 +27,6 @@ void grandchild_reaper(int sig)
     syslog(LOG_ERR, "child: Error waiting pid of grandchild: %m");
     return;
   }
-  
-  for (int fd = 0; fd < PORTFWD_MAX_FD; ++fd)
-    if (grandchild_pid[fd] == gchild_pid)
-      grandchild_pid[fd] = -1;
 
   if (WIFEXITED(status)) {
     ONVERBOSE(syslog(LOG_WARNING, "child: Grandchild with PID %d exited normally with exit status: %d\n", gchild_pid, WEXITSTATUS(status)));
@@ -0,0 +1,938 @@
+/*
+  event_loop.cc
+
+  $Id: event_loop.cc,v 1.2 2026/10/18 09:12:45 cvs Exp $
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+
+#include "util.h"
+#include "event_loop.hpp"
+
+#if defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+# endif
+#endif
+
+/*
+ * configure knows nothing of io_uring: the backend is built whenever
+ * the kernel header knows multishot receives and deferred completions
+ * (Linux 6.1), and open() falls back to epoll when the running kernel
+ * says no.
+ */
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_SETUP_DEFER_TASKRUN)
+#define HAVE_IO_URING 1
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+/*
+ * Registration of one descriptor. Polls are one-shot and re-armed on
+ * the round after they fire, which gives the level-triggered behaviour
+ * of epoll; "gen" tells the completions of a stale registration apart.
+ */
+struct uring_slot {
+  unsigned int mask;  /* errors and hangups are always reported */
+  unsigned int gen;
+  int          registered;
+  void         *ctx;
+  int          armed;
+  int          busy;  /* completions asked for since registered */
+};
+
+/*
+ * A send() in flight. Its completion may come after the descriptor
+ * was removed, and even reused: the token is reported all the same.
+ */
+struct uring_send {
+  void         *token;
+  int          fd;
+  unsigned int gen;
+  int          next_free;
+};
+
+struct uring {
+  int                      fd;
+
+  unsigned int             *sq_head;
+  unsigned int             *sq_tail;
+  unsigned int             sq_mask;
+  unsigned int             sq_entries;
+  struct io_uring_sqe      *sqes;
+
+  unsigned int             *cq_head;
+  unsigned int             *cq_tail;
+  unsigned int             cq_mask;
+  struct io_uring_cqe      *cqes;
+
+  void                     *sq_ptr;
+  size_t                   sq_len;
+  void                     *cq_ptr;
+  size_t                   cq_len;
+  size_t                   sqes_len;
+
+  struct uring_slot        *slots;
+  int                      nslots;
+
+  int                      *fired;  /* polls delivered by last wait() */
+  int                      nfired;
+
+  struct uring_send        *sends;
+  int                      nsends;
+  int                      free_send;  /* -1: none */
+  int                      free_sends;
+
+  struct io_uring_buf      *buf_ring;  /* NULL: no completions */
+  char                     *bufs;
+  unsigned short           buf_tail;
+};
+
+/*
+ * The top byte of user_data tells what completed; the rest is the
+ * registration (gen and fd), or the index of a send.
+ */
+enum { URING_POLL, URING_ACCEPT, URING_RECV, URING_SEND };
+
+static const unsigned long long URING_IGNORE = ~0ULL;
+static const unsigned int       URING_ENTRIES = 1024;
+static const unsigned int       URING_GEN_MASK = 0xFFFFFF;
+
+/*
+ * Buffers the kernel receives into, all in one group. Each is back
+ * in the ring once give_back(): the caller keeps few of them for long.
+ */
+static const int URING_BUFS    = 512;  /* power of 2 */
+static const int URING_BUF_LEN = 16 * 1024;
+static const int URING_BGID    = 0;
+
+static unsigned long long uring_data(int kind, unsigned int gen, int fd)
+{
+  return ((unsigned long long) kind << 56) | ((unsigned long long) (gen & URING_GEN_MASK) << 32) | (unsigned int) fd;
+}
+
+static int uring_enter(struct uring *r, unsigned int min_complete, int timeout_ms)
+{
+  unsigned int to_submit = *r->sq_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+  unsigned int flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+  struct __kernel_timespec ts;
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.sigmask_sz = _NSIG / 8;
+  if (min_complete && timeout_ms >= 0) {
+    ts.tv_sec  = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+    arg.ts     = (unsigned long long) &ts;
+  }
+  flags |= IORING_ENTER_EXT_ARG;
+
+  return syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete, flags, &arg, sizeof(arg));
+}
+
+/*
+ * Makes room for "n" submissions in a row, flushing the queue
+ * without waiting if needed.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int uring_room(struct uring *r, unsigned int n)
+{
+  if (*r->sq_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) + n <= r->sq_entries)
+    return 0;
+
+  if (uring_enter(r, 0, 0) < 0) {
+    syslog(LOG_ERR, "event_loop: io_uring_enter() failed on flush: %m");
+    return -1;
+  }
+  return 0;
+}
+
+static struct io_uring_sqe *uring_sqe(struct uring *r)
+{
+  if (uring_room(r, 1))
+    return 0;
+
+  struct io_uring_sqe *sqe = &r->sqes[*r->sq_tail & r->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+static void uring_queue(struct uring *r)
+{
+  __atomic_store_n(r->sq_tail, *r->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_arm(struct uring *r, int fd)
+{
+  struct uring_slot *slot = &r->slots[fd];
+  struct io_uring_sqe *sqe = uring_sqe(r);
+  if (!sqe)
+    return -1;
+
+  sqe->opcode        = IORING_OP_POLL_ADD;
+  sqe->fd            = fd;
+  sqe->poll32_events = slot->mask;
+  sqe->user_data     = uring_data(URING_POLL, slot->gen, fd);
+  uring_queue(r);
+
+  slot->armed = 1;
+  return 0;
+}
+
+static int uring_disarm(struct uring *r, int fd)
+{
+  struct uring_slot *slot = &r->slots[fd];
+  if (!slot->armed)
+    return 0;
+
+  struct io_uring_sqe *sqe = uring_sqe(r);
+  if (!sqe)
+    return -1;
+
+  sqe->opcode    = IORING_OP_POLL_REMOVE;
+  sqe->fd        = -1;
+  sqe->addr      = uring_data(URING_POLL, slot->gen, fd);
+  sqe->user_data = URING_IGNORE;
+  uring_queue(r);
+
+  slot->armed = 0;
+  return 0;
+}
+
+static int uring_slot_room(struct uring *r, int fd)
+{
+  if (fd < r->nslots)
+    return 0;
+
+  int n = r->nslots;
+  while (n <= fd)
+    n <<= 1;
+
+  struct uring_slot *slots = (struct uring_slot *) realloc(r->slots, n * sizeof(struct uring_slot));
+  if (!slots) {
+    syslog(LOG_ERR, "event_loop: Can't grow io_uring registrations to %d", n);
+    return -1;
+  }
+  memset(slots + r->nslots, 0, (n - r->nslots) * sizeof(struct uring_slot));
+
+  r->slots  = slots;
+  r->nslots = n;
+  return 0;
+}
+
+/*
+ * Registers fd for completions, unless it already is.
+ *
+ * Returns NULL on failure; the registration on success.
+ */
+static struct uring_slot *uring_claim(struct uring *r, int fd, void *ctx)
+{
+  if (uring_slot_room(r, fd))
+    return 0;
+
+  struct uring_slot *slot = &r->slots[fd];
+  if (!slot->registered) {
+    slot->mask       = 0;
+    slot->ctx        = ctx;
+    slot->registered = 1;
+    ++slot->gen;
+  }
+  slot->busy = 1;
+  return slot;
+}
+
+/*
+ * Makes room for "n" more sends in flight.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int uring_send_room(struct uring *r, int n)
+{
+  if (r->free_sends >= n)
+    return 0;
+
+  int size = MAX(MAX(r->nsends * 2, r->nsends + n), 256);
+  struct uring_send *sends = (struct uring_send *) realloc(r->sends, size * sizeof(struct uring_send));
+  if (!sends) {
+    syslog(LOG_ERR, "event_loop: Can't grow io_uring sends to %d", size);
+    return -1;
+  }
+  for (int i = size - 1; i >= r->nsends; --i) {
+    sends[i].next_free = r->free_send;
+    r->free_send = i;
+  }
+  r->free_sends += size - r->nsends;
+  r->sends  = sends;
+  r->nsends = size;
+  return 0;
+}
+
+static int uring_send_get(struct uring *r)
+{
+  int i = r->free_send;
+  r->free_send = r->sends[i].next_free;
+  --r->free_sends;
+  return i;
+}
+
+static void uring_send_put(struct uring *r, int i)
+{
+  r->sends[i].token     = 0;
+  r->sends[i].next_free = r->free_send;
+  r->free_send = i;
+  ++r->free_sends;
+}
+
+/*
+ * The ring is an array of io_uring_buf, the tail overlaid on "resv"
+ * of the first: io_uring_buf_ring says so with a flexible array that
+ * C++ does not lay out at offset 0.
+ */
+static void uring_give_back(struct uring *r, int buf)
+{
+  struct io_uring_buf *ring = r->buf_ring;
+  struct io_uring_buf *b = &ring[r->buf_tail & (URING_BUFS - 1)];
+  b->addr = (unsigned long long) (r->bufs + (size_t) buf * URING_BUF_LEN);
+  b->len  = URING_BUF_LEN;
+  b->bid  = buf;
+  ++r->buf_tail;
+  __atomic_store_n(&ring[0].resv, r->buf_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_close(struct uring *r)
+{
+  if (r->sq_ptr && r->sq_ptr != MAP_FAILED)
+    munmap(r->sq_ptr, r->sq_len);
+  if (r->cq_ptr && r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr)
+    munmap(r->cq_ptr, r->cq_len);
+  if (r->sqes && r->sqes != MAP_FAILED)
+    munmap(r->sqes, r->sqes_len);
+  if (r->fd != -1)
+    close(r->fd);
+  if (r->buf_ring)
+    munmap(r->buf_ring, URING_BUFS * sizeof(struct io_uring_buf));
+  if (r->bufs)
+    munmap(r->bufs, (size_t) URING_BUFS * URING_BUF_LEN);
+  free(r->slots);
+  free(r->fired);
+  free(r->sends);
+  free(r);
+}
+
+/*
+ * Whether the kernel has all that completions take: multishot
+ * accepts and buffer rings came with Linux 5.19, multishot receives
+ * with 6.0, so one of those is armed on an idle socket, then
+ * cancelled, which only a kernel that knows them reports as such.
+ * The completions are consumed here.
+ *
+ * Returns -1 if not; 0 if so.
+ */
+static int uring_probe(struct uring *r)
+{
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv))
+    return -1;
+
+  struct io_uring_sqe *sqe = uring_sqe(r);
+  sqe->opcode    = IORING_OP_RECV;
+  sqe->fd        = sv[0];
+  sqe->flags     = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BGID;
+  sqe->ioprio    = IORING_RECV_MULTISHOT;
+  sqe->user_data = 1;
+  uring_queue(r);
+
+  sqe = uring_sqe(r);
+  sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+  sqe->fd        = -1;
+  sqe->addr      = 1;
+  sqe->user_data = URING_IGNORE;
+  uring_queue(r);
+
+  int res = 0;
+  for (int got = 0; got < 2; ) {
+    unsigned int head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+      if (uring_enter(r, 1, 1000) < 0 && errno != EINTR) {
+	res = -errno;
+	break;
+      }
+      continue;
+    }
+    struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+    if (cqe->user_data == 1)
+      res = cqe->res;
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    ++got;
+  }
+
+  close(sv[0]);
+  close(sv[1]);
+
+  return res == -ECANCELED ? 0 : -1;
+}
+
+/*
+ * Registers the buffers recv_all() and recv() receive into, and
+ * checks that the kernel is recent enough.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int uring_buffers(struct uring *r)
+{
+  void *ring = mmap(0, URING_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void *bufs = mmap(0, (size_t) URING_BUFS * URING_BUF_LEN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED || bufs == MAP_FAILED) {
+    syslog(LOG_WARNING, "event_loop: Can't map io_uring buffers: %m");
+    if (ring != MAP_FAILED)
+      munmap(ring, URING_BUFS * sizeof(struct io_uring_buf));
+    if (bufs != MAP_FAILED)
+      munmap(bufs, (size_t) URING_BUFS * URING_BUF_LEN);
+    return -1;
+  }
+  r->buf_ring = (struct io_uring_buf *) ring;
+  r->bufs     = (char *) bufs;
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr    = (unsigned long long) ring;
+  reg.ring_entries = URING_BUFS;
+  reg.bgid         = URING_BGID;
+  if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+    syslog(LOG_WARNING, "event_loop: Can't register io_uring buffers: %m");
+    return -1;
+  }
+  for (int i = 0; i < URING_BUFS; ++i)
+    uring_give_back(r, i);
+
+  if (uring_probe(r)) {
+    syslog(LOG_WARNING, "event_loop: io_uring lacks multishot receives");
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::open_uring()
+{
+  struct uring *r = (struct uring *) calloc(1, sizeof(struct uring));
+  if (!r)
+    return -1;
+  r->free_send = -1;
+
+  /*
+   * Completions only come in wait(), from the thread that opened the
+   * loop: a multishot receive then reads no further than the round
+   * that stops it, instead of emptying its socket meanwhile.
+   */
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+  r->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+  if (r->fd == -1) {
+    syslog(LOG_WARNING, "event_loop: io_uring_setup() failed: %m");
+    free(r);
+    return -1;
+  }
+
+  const unsigned int needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+  if ((p.features & needed) != needed) {
+    syslog(LOG_WARNING, "event_loop: io_uring lacks required features (0x%x)", p.features);
+    uring_close(r);
+    return -1;
+  }
+
+  r->sq_len   = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  r->cq_len   = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  r->sq_len   = MAX(r->sq_len, r->cq_len);
+  r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  r->sq_ptr = mmap(0, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  r->cq_ptr = r->sq_ptr;
+  r->sqes   = (struct io_uring_sqe *) mmap(0, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (r->sq_ptr == MAP_FAILED || r->sqes == MAP_FAILED) {
+    syslog(LOG_WARNING, "event_loop: Can't map io_uring: %m");
+    uring_close(r);
+    return -1;
+  }
+
+  char *sq = (char *) r->sq_ptr;
+  r->sq_head    = (unsigned int *) (sq + p.sq_off.head);
+  r->sq_tail    = (unsigned int *) (sq + p.sq_off.tail);
+  r->sq_mask    = *(unsigned int *) (sq + p.sq_off.ring_mask);
+  r->sq_entries = p.sq_entries;
+
+  /*
+   * SQEs are always queued in order: make the index array an identity.
+   */
+  unsigned int *array = (unsigned int *) (sq + p.sq_off.array);
+  for (unsigned int i = 0; i < p.sq_entries; ++i)
+    array[i] = i;
+
+  char *cq = (char *) r->cq_ptr;
+  r->cq_head = (unsigned int *) (cq + p.cq_off.head);
+  r->cq_tail = (unsigned int *) (cq + p.cq_off.tail);
+  r->cq_mask = *(unsigned int *) (cq + p.cq_off.ring_mask);
+  r->cqes    = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+  r->nslots = 64;
+  r->slots  = (struct uring_slot *) calloc(r->nslots, sizeof(struct uring_slot));
+  r->fired  = (int *) malloc(max_events * sizeof(int));
+  reports   = (loop_report *) malloc(max_events * sizeof(loop_report));
+  if (!r->slots || !r->fired || !reports) {
+    syslog(LOG_ERR, "event_loop: Can't allocate io_uring registrations");
+    free(reports);
+    reports = 0;
+    uring_close(r);
+    return -1;
+  }
+
+  /*
+   * Without them, io_uring would only poll sockets, for more system
+   * calls than epoll takes: leave it to epoll.
+   */
+  if (uring_buffers(r)) {
+    free(reports);
+    reports = 0;
+    uring_close(r);
+    return -1;
+  }
+
+  ring = r;
+  has_completions = 1;
+
+  return 0;
+}
+
+#else /* HAVE_IO_URING */
+
+struct uring {
+  int unused;
+};
+
+static void uring_close(struct uring *r)
+{
+}
+
+int event_loop::open_uring()
+{
+  syslog(LOG_WARNING, "event_loop: io_uring disabled on compile time");
+  return -1;
+}
+
+#endif /* HAVE_IO_URING */
+
+event_loop::~event_loop()
+{
+  if (ring)
+    uring_close(ring);
+  if (epfd != -1)
+    close(epfd);
+  free(events);
+  free(reports);
+}
+
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::open(int max_ev, int use_uring)
+{
+  events = (struct epoll_event *) malloc(max_ev * sizeof(struct epoll_event));
+  if (!events) {
+    syslog(LOG_ERR, "event_loop::open(): Can't allocate %d events", max_ev);
+    return -1;
+  }
+  max_events = max_ev;
+
+  if (use_uring) {
+    if (!open_uring()) {
+      ONVERBOSE(syslog(LOG_DEBUG, "event_loop::open(): using io_uring"));
+      return 0;
+    }
+    syslog(LOG_WARNING, "event_loop::open(): io_uring unavailable, falling back to epoll");
+  }
+
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd == -1) {
+    syslog(LOG_ERR, "event_loop::open(): epoll_create1() failed: %m");
+    return -1;
+  }
+  DEBUGFD(syslog(LOG_DEBUG, "event_loop::open(): epoll FD %d", epfd));
+
+  return 0;
+}
+
+static int ctl(int epfd, int op, int fd, unsigned int mask, void *ctx)
+{
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events   = mask;
+  ev.data.ptr = ctx;
+
+  return epoll_ctl(epfd, op, fd, &ev);
+}
+
+int event_loop::add(int fd, unsigned int mask, void *ctx)
+{
+#ifdef HAVE_IO_URING
+  if (ring) {
+    if (uring_slot_room(ring, fd))
+      return -1;
+    struct uring_slot *slot = &ring->slots[fd];
+    slot->mask       = mask;
+    slot->ctx        = ctx;
+    slot->registered = 1;
+    ++slot->gen;
+    return uring_arm(ring, fd);
+  }
+#endif
+
+  if (ctl(epfd, EPOLL_CTL_ADD, fd, mask, ctx)) {
+    syslog(LOG_ERR, "event_loop::add(): Can't watch FD %d: %m", fd);
+    return -1;
+  }
+  return 0;
+}
+
+int event_loop::modify(int fd, unsigned int mask, void *ctx)
+{
+#ifdef HAVE_IO_URING
+  if (ring) {
+    if (uring_disarm(ring, fd))
+      return -1;
+    struct uring_slot *slot = &ring->slots[fd];
+    slot->mask = mask;
+    slot->ctx  = ctx;
+    ++slot->gen;
+    return uring_arm(ring, fd);
+  }
+#endif
+
+  if (ctl(epfd, EPOLL_CTL_MOD, fd, mask, ctx)) {
+    syslog(LOG_ERR, "event_loop::modify(): Can't change FD %d: %m", fd);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Must be called before close(): forked FTP forwarders share our
+ * descriptors, and epoll only forgets a descriptor when its last
+ * reference goes away. Likewise, whatever io_uring still does on
+ * the descriptor is cancelled at once, while it still names the
+ * same socket; late completions then go unreported, but for sends.
+ */
+int event_loop::remove(int fd)
+{
+#ifdef HAVE_IO_URING
+  if (ring) {
+    if (uring_disarm(ring, fd))
+      return -1;
+    struct uring_slot *slot = &ring->slots[fd];
+    if (slot->busy) {
+      struct io_uring_sqe *sqe = uring_sqe(ring);
+      if (!sqe)
+	return -1;
+      sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+      sqe->fd           = fd;
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+      sqe->user_data    = URING_IGNORE;
+      uring_queue(ring);
+      if (uring_enter(ring, 0, 0) < 0) {
+	syslog(LOG_ERR, "event_loop::remove(): Can't cancel I/O on FD %d: %m", fd);
+	return -1;
+      }
+    }
+    slot->mask       = 0;
+    slot->ctx        = 0;
+    slot->registered = 0;
+    slot->busy       = 0;
+    ++slot->gen;
+    return 0;
+  }
+#endif
+
+  if (ctl(epfd, EPOLL_CTL_DEL, fd, 0, 0)) {
+    syslog(LOG_ERR, "event_loop::remove(): Can't unwatch FD %d: %m", fd);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Accepts clients on listening socket fd for as long as it reports
+ * them with "more". Clients come non-blocking and close-on-exec.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::accept_all(int fd, void *ctx)
+{
+#ifdef HAVE_IO_URING
+  if (has_completions) {
+    struct uring_slot *slot = uring_claim(ring, fd, ctx);
+    struct io_uring_sqe *sqe = slot ? uring_sqe(ring) : 0;
+    if (!sqe)
+      return -1;
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data    = uring_data(URING_ACCEPT, slot->gen, fd);
+    uring_queue(ring);
+    return 0;
+  }
+#endif
+  return -1;
+}
+
+/*
+ * Receives from fd for as long as it reports with "more", each time
+ * into a buffer the caller hands back with give_back(). Running out
+ * of buffers ends it with -ENOBUFS.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::recv_all(int fd, void *ctx)
+{
+  return recv(fd, ctx, 1);
+}
+
+/*
+ * Receives once from fd, likewise: one buffer at a time, for a caller
+ * whose output piles up and that must stop at once.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::recv(int fd, void *ctx)
+{
+  return recv(fd, ctx, 0);
+}
+
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::recv(int fd, void *ctx, int multishot)
+{
+#ifdef HAVE_IO_URING
+  if (has_completions) {
+    struct uring_slot *slot = uring_claim(ring, fd, ctx);
+    struct io_uring_sqe *sqe = slot ? uring_sqe(ring) : 0;
+    if (!sqe)
+      return -1;
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = fd;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->ioprio    = multishot ? IORING_RECV_MULTISHOT : 0;
+    sqe->user_data = uring_data(URING_RECV, slot->gen, fd);
+    uring_queue(ring);
+    return 0;
+  }
+#endif
+  return -1;
+}
+
+/*
+ * Cancels the recv_all() or recv() on fd: what it received meanwhile
+ * is still reported, then -ECANCELED without "more".
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::stop_recv(int fd)
+{
+#ifdef HAVE_IO_URING
+  if (has_completions) {
+    struct io_uring_sqe *sqe = uring_sqe(ring);
+    if (!sqe)
+      return -1;
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->fd        = -1;
+    sqe->addr      = uring_data(URING_RECV, ring->slots[fd].gen, fd);
+    sqe->user_data = URING_IGNORE;
+    uring_queue(ring);
+    return 0;
+  }
+#endif
+  return -1;
+}
+
+/*
+ * Sends the "n" pieces of "iov" to fd in order, each reporting with
+ * its token once sent in full, or failed. A piece failing cancels the
+ * ones after it: -ECANCELED. Send no more to fd until all are
+ * reported. The memory must stay put until then, even if fd is removed
+ * meanwhile: its sends then report with a NULL context.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+int event_loop::send(int fd, const struct iovec *iov, void **tokens, int n)
+{
+#ifdef HAVE_IO_URING
+  if (has_completions) {
+    struct uring_slot *slot = uring_claim(ring, fd, 0);
+    if (!slot || uring_room(ring, n) || uring_send_room(ring, n))
+      return -1;
+
+    for (int i = 0; i < n; ++i) {
+      int k = uring_send_get(ring);
+      struct uring_send *s = &ring->sends[k];
+      s->token = tokens[i];
+      s->fd    = fd;
+      s->gen   = slot->gen;
+
+      struct io_uring_sqe *sqe = &ring->sqes[*ring->sq_tail & ring->sq_mask];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode    = IORING_OP_SEND;
+      sqe->fd        = fd;
+      sqe->addr      = (unsigned long long) iov[i].iov_base;
+      sqe->len       = iov[i].iov_len;
+      sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+      sqe->flags     = i < n - 1 ? IOSQE_IO_LINK : 0;
+      sqe->user_data = uring_data(URING_SEND, 0, k);
+      uring_queue(ring);
+    }
+    return 0;
+  }
+#endif
+  return -1;
+}
+
+char *event_loop::buffer(int buf) const
+{
+#ifdef HAVE_IO_URING
+  return ring->bufs + (size_t) buf * URING_BUF_LEN;
+#else
+  return 0;
+#endif
+}
+
+int event_loop::buffer_len() const
+{
+#ifdef HAVE_IO_URING
+  return URING_BUF_LEN;
+#else
+  return 0;
+#endif
+}
+
+void event_loop::give_back(int buf)
+{
+#ifdef HAVE_IO_URING
+  uring_give_back(ring, buf);
+#endif
+}
+
+/*
+ * Returns number of reports (0 on timeout or signal); -1 on failure.
+ * With epoll, a report is a ready descriptor.
+ */
+int event_loop::wait(int timeout_ms)
+{
+#ifdef HAVE_IO_URING
+  if (ring) {
+    struct uring *r = ring;
+
+    /*
+     * Re-arm whatever fired last round and is still wanted.
+     */
+    for (int i = 0; i < r->nfired; ++i) {
+      int fd = r->fired[i];
+      struct uring_slot *slot = &r->slots[fd];
+      if (slot->registered && !slot->armed)
+	uring_arm(r, fd);
+    }
+    r->nfired = 0;
+
+    unsigned int head = *r->cq_head;
+    int min_complete = head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    if (uring_enter(r, min_complete, timeout_ms) < 0 && errno != EINTR && errno != ETIME) {
+      syslog(LOG_ERR, "event_loop::wait(): io_uring_enter() failed: %m");
+      return -1;
+    }
+
+    int n = 0;
+    unsigned int tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail && n < max_events; ++head) {
+      struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+      if (cqe->user_data == URING_IGNORE)
+	continue;
+
+      int kind = (int) (cqe->user_data >> 56);
+      int fd = (int) (cqe->user_data & 0xFFFFFFFF);
+      loop_report *rep = &reports[n];
+
+      if (kind == URING_SEND) {
+	struct uring_send *s = &r->sends[fd];
+	struct uring_slot *slot = &r->slots[s->fd];
+	rep->ctx   = slot->registered && slot->gen == s->gen ? slot->ctx : 0;
+	rep->mask  = 0;
+	rep->kind  = EV_SENT;
+	rep->res   = cqe->res;
+	rep->buf   = -1;
+	rep->more  = 0;
+	rep->token = s->token;
+	++n;
+	uring_send_put(r, fd);
+	continue;
+      }
+
+      unsigned int gen = (unsigned int) (cqe->user_data >> 32) & URING_GEN_MASK;
+      int buf = cqe->flags & IORING_CQE_F_BUFFER ? (int) (cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+      struct uring_slot *slot = fd < r->nslots ? &r->slots[fd] : 0;
+      if (!slot || (slot->gen & URING_GEN_MASK) != gen || !slot->registered) {
+	/*
+	 * Stale: nobody to hand the buffer or client to.
+	 */
+	if (buf != -1)
+	  uring_give_back(r, buf);
+	if (kind == URING_ACCEPT && cqe->res >= 0)
+	  close(cqe->res);
+	continue;
+      }
+
+      rep->ctx   = slot->ctx;
+      rep->mask  = 0;
+      rep->res   = cqe->res;
+      rep->buf   = buf;
+      rep->more  = (cqe->flags & IORING_CQE_F_MORE) != 0;
+      rep->token = 0;
+
+      if (kind == URING_POLL) {
+	slot->armed = 0;
+	rep->kind = EV_POLLED;
+	rep->mask = cqe->res < 0 ? (int) EPOLLERR : cqe->res;
+	r->fired[r->nfired++] = fd;
+      }
+      else
+	rep->kind = kind == URING_ACCEPT ? EV_ACCEPTED : EV_RECEIVED;
+      ++n;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+    return n;
+  }
+#endif
+
+  int n = epoll_wait(epfd, events, max_events, timeout_ms);
+  if (n == -1) {
+    if (errno == EINTR)
+      return 0;
+    syslog(LOG_ERR, "event_loop::wait(): epoll_wait() failed: %m");
+  }
+  return n;
+}
+
+/* Eof: event_loop.cc */
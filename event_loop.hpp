@@ -0,0 +1,125 @@
+/*
+  event_loop.hpp
+
+  $Id: event_loop.hpp,v 1.3 2026/10/18 09:12:45 cvs Exp $
+ */
+
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <sys/epoll.h>
+#include <sys/uio.h>
+
+/*
+ * Readiness conditions, as understood by add() and modify().
+ */
+#define EV_READ   EPOLLIN
+#define EV_WRITE  EPOLLOUT
+#define EV_HANGUP EPOLLRDHUP /* the peer shut down its side */
+
+/*
+ * What a report of wait() is about, see ready_kind().
+ */
+enum {
+  EV_POLLED,    /* readiness: ready_mask() */
+  EV_ACCEPTED,  /* accept_all(): ready_result() is a client socket, or -errno */
+  EV_RECEIVED,  /* recv_all(), recv(): ready_result() bytes in ready_buf(), 0 on EOF, or -errno */
+  EV_SENT       /* send(): ready_result() bytes sent, or -errno */
+};
+
+/*
+ * One report of wait() with io_uring.
+ */
+struct loop_report {
+  void         *ctx;    /* NULL: descriptor removed since, see send() */
+  unsigned int mask;
+  int          kind;
+  int          res;
+  int          buf;     /* EV_RECEIVED: buffer holding the bytes; -1 if none */
+  int          more;    /* accept_all(), recv_all(): goes on reporting */
+  void         *token;  /* EV_SENT: as given to send() */
+};
+
+struct uring;
+
+/*
+ * Thin wrapper around epoll(7), or io_uring(7) when asked for.
+ *
+ * Every registered descriptor carries an opaque context pointer that is
+ * handed back on readiness, so the caller never scans descriptors that
+ * have nothing to say: the cost of one round is O(ready), and the number
+ * of descriptors is bounded only by RLIMIT_NOFILE.
+ *
+ * With io_uring, add(), modify() and remove() only queue submissions;
+ * they reach the kernel together with the next wait(), in one system
+ * call per round whatever the number of active connections.
+ *
+ * io_uring also moves the data itself, and completions() says so:
+ * accept_all() and recv_all() keep reporting new clients and received
+ * bytes until told otherwise, the bytes landing in buffers registered
+ * with the kernel, and send() writes from memory of the caller's.
+ * This takes multishot receives and deferred completions (Linux
+ * 6.1): without them, open() falls back to epoll. Sockets of the same
+ * event_loop are watched either way, but each one only one way.
+ */
+class event_loop
+{
+private:
+  int                epfd;
+  struct uring       *ring;
+  int                max_events;
+  struct epoll_event *events;
+  loop_report        *reports;  /* io_uring: what wait() found */
+  int                has_completions;
+
+  int open_uring();
+  int recv(int fd, void *ctx, int multishot);
+
+public:
+  event_loop()
+    {
+      epfd            = -1;
+      ring            = 0;
+      max_events      = 0;
+      events          = 0;
+      reports         = 0;
+      has_completions = 0;
+    }
+
+  ~event_loop();
+
+  int open(int max_ev, int use_uring);
+
+  int add(int fd, unsigned int mask, void *ctx);
+  int modify(int fd, unsigned int mask, void *ctx);
+  int remove(int fd);
+
+  int wait(int timeout_ms);
+
+  void *ready_ctx(int i) const { return reports ? reports[i].ctx : events[i].data.ptr; }
+  unsigned int ready_mask(int i) const { return reports ? reports[i].mask : events[i].events; }
+  int ready_kind(int i) const { return reports ? reports[i].kind : (int) EV_POLLED; }
+  int ready_result(int i) const { return reports[i].res; }
+  int ready_buf(int i) const { return reports[i].buf; }
+  int ready_more(int i) const { return reports[i].more; }
+  void *ready_token(int i) const { return reports[i].token; }
+
+  /*
+   * Completions, only where completions() is true.
+   */
+  int completions() const { return has_completions; }
+
+  int accept_all(int fd, void *ctx);
+  int recv_all(int fd, void *ctx);
+  int recv(int fd, void *ctx);
+  int stop_recv(int fd);
+  int send(int fd, const struct iovec *iov, void **tokens, int n);
+
+  char *buffer(int buf) const;
+  int buffer_len() const;
+  void give_back(int buf);
+};
+
+#endif /* EVENT_LOOP_HPP */
+
+/* Eof: event_loop.hpp */
@@ -10,6 +10,7 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <errno.h>
+#include <syslog.h>
 
 #include "fd_set.h"
 #include "util.h"
@@ -31,6 +32,27 @@ void close_fds(int first_fds) {
   errno = 0; /* close() on invalid fd */
 }
 
+/*
+ * Lift the soft descriptor limit up to the hard one: the event loop
+ * has no ceiling of its own, so RLIMIT_NOFILE is what bounds the
+ * number of concurrent sessions.
+ */
+void raise_fd_limit() {
+
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+    syslog(LOG_WARNING, "raise_fd_limit(): getrlimit() failed: %m");
+    return;
+  }
+
+  if (rl.rlim_cur == rl.rlim_max)
+    return;
+
+  rl.rlim_cur = rl.rlim_max;
+  if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+    syslog(LOG_WARNING, "raise_fd_limit(): setrlimit() failed: %m");
+}
+
 void fdset(int fd, fd_set *fds, int *maxfd)
 {
   FD_SET(fd, fds);
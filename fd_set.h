@@ -20,6 +20,7 @@
 
 
 void close_fds(int first_fds);
+void raise_fd_limit();
 void fdset(int fd, fd_set *fds, int *maxfd);
 void fdclear(int fd, fd_set *fds, int *maxfd);
 
@@ -9,6 +9,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <assert.h>
 #include <errno.h>
 #include <string.h>
@@ -17,256 +18,587 @@
 #include <arpa/inet.h>
 #include <syslog.h>
 #include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/random.h>
 #include "portfwd.h"
 #include "forward.h"
 #include "util.h"
 #include "solve.h"
 #include "host_map.hpp"
 #include "iterator.hpp"
+#include "event_loop.hpp"
+#include "timer_list.hpp"
+#include "keystream.h"
+#include "keystream2.h"
+#include "slab_pool.hpp"
+#include "conn_limit.hpp"
+#include "accept_limit.hpp"
+#include "mux.h"
+#include "dns_cache.hpp"
 
 
-static int isProbablePrime(long oddNumber) {
-    long i;
 
-    for (i=3; i<51; i+=2)
-        if (oddNumber == i)
-            return 1;
-        else if (oddNumber%i == 0)
-            return 0;
+/*
+ * Returns -1 on failure; file descriptor on success.
+ */
+int tcp_connect(const struct ip_addr *ip, int port)
+{
+  int rsd = socket(PF_INET, SOCK_STREAM, get_protonumber(P_TCP));
+  if (rsd == -1) {
+    syslog(LOG_ERR, "tcp_connect: Can't create TCP socket: %m");
+    return -1;
+  }
+  DEBUGFD(syslog(LOG_DEBUG, "socket open: FD %d", rsd));
 
-    return 1; /* maybe */
-}
+  struct sockaddr_in sa;
+  sa.sin_family      = PF_INET;
+  sa.sin_port        = htons(port);
+  sa.sin_addr.s_addr = *((unsigned int *) ip->addr);
+  memset((char *) sa.sin_zero, 0, sizeof(sa.sin_zero));
 
-static long calculateIdealNumOfBuckets(HashTable *hashTable) {
-    long idealNumOfBuckets = hashTable->numOfElements / hashTable->idealRatio;
-    if (idealNumOfBuckets < 5)
-        idealNumOfBuckets = 5;
-    else
-        idealNumOfBuckets |= 0x01; /* make it an odd number */
-    while (!isProbablePrime(idealNumOfBuckets))
-        idealNumOfBuckets += 2;
+  if (connect(rsd, (struct sockaddr *) &sa, sizeof(sa))) {
+    syslog(LOG_ERR, "tcp_connect: Can't connect to %s:%d: %m", inet_ntoa(sa.sin_addr), port);
+    socket_close(rsd);
+    return -1;
+  }
 
-    return idealNumOfBuckets;
+  return rsd;
 }
 
-static int pointercmp(const void *pointer1, const void *pointer2) {
-    return (pointer1 != pointer2);
+/*
+ * Returns host_map success; NULL on failure.
+ */
+host_map *tcp_match(const vector<host_map*> *map_list, const struct ip_addr *ip, int port)
+{
+  host_map *hm;
+  iterator<vector<host_map*>,host_map*> it(*map_list);
+  for (it.start(); it.cont(); it.next()) {
+    hm = it.get();
+    if (hm->tcp_match(ip, port))
+      return hm;
+  }
+  return 0;
 }
 
-static unsigned long pointerHashFunction(const void *pointer) {
-    return ((unsigned long) pointer) >> 4;
-}
+/*
+ * What a TCP map needs at forwarding time, shared by its workers.
+ */
+struct tcp_service {
+  const struct ip_addr  *source;
+  vector<host_map*>     *map_list;
+  const struct ip_addr  *actv_ip;
+  const struct ip_addr  *pasv_ip;
+  int                   fragile;
+  long long             XOR_key;
+  long long             conf_key;
+  int                   is_remote;
+  int                   splice;  /* plain map moving data with splice() */
+  int                   workers;
+  const struct map_opts *opts;
+  conn_limit            *limit;  /* NULL without max-connections nor max-per-source */
+};
 
-void HashTableRehash(HashTable *hashTable, long numOfBuckets) {
-    KeyValuePair **newBucketArray;
-    int i;
+/*
+ * Room for inflating "rd" bytes. Up to offset 75102 about 40% of the
+ * bytes may be insertions, then one in 42: the buffer only grows
+ * beyond this for unlucky runs, and keeps that size.
+ */
+#define INFLATED_SZ(rd) ((rd) * 9 / 5 + 3)
 
-    assert(numOfBuckets >= 0);
-    if (numOfBuckets == 0)
-        numOfBuckets = calculateIdealNumOfBuckets(hashTable);
+/*
+ * Output of an endpoint moved by io_uring (see uring_start()): a
+ * buffer of the event loop, sent as received, or a chunk of copies.
+ */
+const int OUT_CHUNK = 16 * 1024;
 
-    if (numOfBuckets == hashTable->numOfBuckets)
-        return; /* already the right size! */
+struct out_chunk {
+  char data[OUT_CHUNK];
+};
 
-    newBucketArray = (KeyValuePair **)
-                                malloc(numOfBuckets * sizeof(KeyValuePair *));
-    if (newBucketArray == NULL) {
-        /* Couldn't allocate memory for the new array.  This isn't a fatal
-         * error; we just can't perform the rehash. */
-        return;
-    }
+struct out_seg {
+  char    *data;
+  int     len;
+  int     off;        /* bytes sent */
+  int     buf;        /* buffer of the event loop holding data; -1: an out_chunk */
+  int     in_flight;  /* sent, not reported yet */
+  out_seg *next;
+};
 
-    for (i=0; i<numOfBuckets; i++)
-        newBucketArray[i] = NULL;
+static __thread slab_pool<out_seg>       seg_pool;
+static __thread slab_pool<out_chunk, 16> chunk_pool;
 
-    for (i=0; i<hashTable->numOfBuckets; i++) {
-        KeyValuePair *pair = hashTable->bucketArray[i];
-        while (pair != NULL) {
-            KeyValuePair *nextPair = pair->next;
-            long hashValue = hashTable->hashFunction(pair->key) % numOfBuckets;
-            pair->next = newBucketArray[hashValue];
-            newBucketArray[hashValue] = pair;
-            pair = nextPair;
-        }
-    }
+/*
+ * io_uring: what an endpoint receiving does.
+ */
+enum { RECV_OFF, RECV_ON, RECV_STOPPING };
 
-    free(hashTable->bucketArray);
-    hashTable->bucketArray = newBucketArray;
-    hashTable->numOfBuckets = numOfBuckets;
-}
+class Try_connect_delayer;
+struct tcp_conn;
+struct mux_tunnel;
+struct mux_stream;
+
+/*
+ * Context the event loop hands back for every watched descriptor.
+ * Communicating sockets come in pairs, within a tcp_conn.
+ */
+struct tcp_endpoint {
+  int                 fd;
+  int                 mother;    /* listening socket? */
+  tcp_endpoint        *peer;     /* other side of the pair; NULL for mother sockets */
+  tcp_conn            *conn;     /* pair it belongs to; NULL for mother sockets */
+  Try_connect_delayer *delayer;  /* upstream connection still pending */
+  clientSock_session_t *session; /* what is read from fd; NULL until established or if plain */
+  mux_tunnel          *tunnel;   /* tunnel it is, or carries its stream; NULL if none */
+  mux_stream          *stream;   /* stream it is; NULL if none */
+  int                 pipe_rd;   /* splice(): pipe holding output for fd */
+  int                 pipe_wr;
+  int                 piped;     /* bytes in that pipe */
+
+  unsigned int        events;    /* conditions watched, see watch_events() */
+  int                 throttled; /* reads stopped: peer has too much output pending */
+  int                 draining;  /* EOF seen: pair closes once output is flushed */
+  char                *out;      /* output pending for fd */
+  int                 out_off;
+  int                 out_len;
+  int                 out_size;
+
+  int                 uring;     /* moved by io_uring completions, see uring_start() */
+  int                 receiving; /* uring: RECV_OFF, RECV_ON or RECV_STOPPING */
+  int                 one_shot;  /* uring: receives a buffer at a time, see uring_recv() */
+  out_seg             *sendq;    /* uring: output pending for fd, oldest first */
+  out_seg             *sendq_tail;
+  int                 queued;    /* uring: bytes in sendq not sent yet */
+  int                 sending;   /* uring: sends in flight, from the head of sendq */
+  timer               starve;    /* uring: in w->starving, out of buffers to receive into */
+};
 
+/*
+ * Everything about one forwarded connection, in one place: both
+ * endpoints, their sessions and the FTP forwarder spawned for it.
+ */
+struct tcp_conn {
+  tcp_endpoint         ep[2];      /* ep[0]: client; ep[1]: upstream */
+  clientSock_session_t session[2]; /* for ep[0] and ep[1] */
+  int                  ftp_pidfd;  /* FTP forwarder, see gc_fill(); -1 if none */
+  to_addr              *dst;       /* destination counting it as active */
+  conn_limit           *limit;     /* counting its client; NULL if none */
+  unsigned int         src;        /* client address, as counted */
+  timer                idle;       /* established: in w->idling */
+  timer                life;       /* established: in w->aging */
+  tcp_conn             *next;      /* closed, awaiting free_pairs() */
+};
 
-HashTable *HashTableCreate(long numOfBuckets) {
-    HashTable *hashTable;
-    int i;
+/*
+ * Each thread allocates its connections from its own slabs.
+ */
+static __thread slab_pool<tcp_conn> conn_pool;
 
-    assert(numOfBuckets > 0);
+/*
+ * A listening socket, with the local address its clients reach.
+ */
+struct tcp_listener {
+  tcp_endpoint       ep;  /* first: handed back by the event loop */
+  struct sockaddr_in local_sa;
+};
 
-    hashTable = (HashTable *) malloc(sizeof(HashTable));
-    if (hashTable == NULL)
-        return NULL;
+const int EVENTS_PER_WAIT = 256;
 
-    hashTable->bucketArray = (KeyValuePair **)
-                        malloc(numOfBuckets * sizeof(KeyValuePair *));
-    if (hashTable->bucketArray == NULL) {
-        free(hashTable);
-        return NULL;
-    }
-    
-    hashTable->numOfBuckets = numOfBuckets;
-    hashTable->numOfElements = 0;
+/*
+ * Most clients accepted per readiness of a listening socket.
+ */
+const int ACCEPT_BUDGET = 64;
 
-    for (i=0; i<numOfBuckets; i++)
-        hashTable->bucketArray[i] = NULL;
+/*
+ * Output pending for one endpoint: reading from its peer stops above
+ * OUT_HIGH_WATER and resumes below OUT_LOW_WATER.
+ */
+const int OUT_HIGH_WATER = 256 * 1024;
+const int OUT_LOW_WATER  = 64 * 1024;
 
-    hashTable->idealRatio = 3.0;
-    hashTable->lowerRehashThreshold = 0.0;
-    hashTable->upperRehashThreshold = 15.0;
+/*
+ * Most bytes moved by one splice() from a socket.
+ */
+const int SPLICE_LEN = 64 * 1024;
 
-    hashTable->keycmp = pointercmp;
-    hashTable->valuecmp = pointercmp;
-    hashTable->hashFunction = pointerHashFunction;
-    hashTable->keyDeallocator = NULL;
-    hashTable->valueDeallocator = NULL;
+/*
+ * io_uring: most sends linked in one go, and milliseconds before
+ * receiving again once the event loop ran out of buffers.
+ */
+const int SEND_CHAIN   = 16;
+const int STARVE_RETRY = 10;
 
-    return hashTable;
+static void init_endpoint(tcp_endpoint *ep, int fd, tcp_endpoint *peer)
+{
+  ep->fd        = fd;
+  ep->mother    = !peer;
+  ep->peer      = peer;
+  ep->conn      = 0;
+  ep->delayer   = 0;
+  ep->session   = 0;
+  ep->tunnel    = 0;
+  ep->stream    = 0;
+  ep->pipe_rd   = -1;
+  ep->pipe_wr   = -1;
+  ep->piped     = 0;
+  ep->events    = 0;
+  ep->throttled = 0;
+  ep->draining  = 0;
+  ep->out       = 0;
+  ep->out_off   = 0;
+  ep->out_len   = 0;
+  ep->out_size  = 0;
+  ep->uring     = 0;
+  ep->receiving = RECV_OFF;
+  ep->one_shot  = 0;
+  ep->sendq     = 0;
+  ep->sendq_tail = 0;
+  ep->queued    = 0;
+  ep->sending   = 0;
+  timer_list::init(&ep->starve, ep);
 }
 
+/*
+ * Returns NULL on failure; the endpoint for csd on success.
+ */
+static tcp_endpoint *new_pair(int csd, int rsd)
+{
+  tcp_conn *conn = conn_pool.get();
+  if (!conn) {
+    syslog(LOG_ERR, "Can't allocate connection");
+    return 0;
+  }
 
-int HashTablePut(HashTable *hashTable, const void *key, void *value) {
-    long hashValue;
-    KeyValuePair *pair;
-
-    assert(key != NULL);
-    assert(value != NULL);
+  tcp_endpoint *ep = conn->ep;
+  init_endpoint(&ep[0], csd, &ep[1]);
+  init_endpoint(&ep[1], rsd, &ep[0]);
+  ep[0].conn = conn;
+  ep[1].conn = conn;
+  memset(conn->session, 0, sizeof(conn->session));
+  conn->ftp_pidfd = -1;
+  conn->dst = 0;
+  conn->limit = 0;
+  conn->src = 0;
+  timer_list::init(&conn->idle, conn);
+  timer_list::init(&conn->life, conn);
+  conn->next = 0;
+
+  return ep;
+}
 
-    hashValue = hashTable->hashFunction(key) % hashTable->numOfBuckets;
-    pair = hashTable->bucketArray[hashValue];
+static void free_pair(tcp_conn *conn)
+{
+  if (conn->dst)
+    conn->dst->closed();
+  if (conn->limit)
+    conn->limit->leave(conn->src);
+  free(conn->ep[0].out);
+  free(conn->ep[1].out);
+  free(conn->session[0].inflated);
+  free(conn->session[1].inflated);
+  conn_pool.put(conn);
+}
 
-    while (pair != NULL && hashTable->keycmp(key, pair->key) != 0)
-        pair = pair->next;
+/*
+ * Watches a pair of communicating sockets. Both sockets are
+ * closed on failure.
+ *
+ * Returns NULL on failure; the endpoint for csd on success.
+ */
+static tcp_endpoint *add_pair(event_loop *loop, int csd, int rsd)
+{
+  tcp_endpoint *ep = new_pair(csd, rsd);
+  if (!ep) {
+    socket_close(csd);
+    socket_close(rsd);
+    return 0;
+  }
+  ep[0].events = EV_READ;
+  ep[1].events = EV_READ;
 
-    if (pair) {
-        if (pair->key != key) {
-            if (hashTable->keyDeallocator != NULL)
-                hashTable->keyDeallocator((void *) pair->key);
-            pair->key = key;
-        }
-        if (pair->value != value) {
-            if (hashTable->valueDeallocator != NULL)
-                hashTable->valueDeallocator(pair->value);
-            pair->value = value;
-        }
-    }
-    else {
-        KeyValuePair *newPair = (KeyValuePair *) malloc(sizeof(KeyValuePair));
-        if (newPair == NULL) {
-            return -1;
-        }
-        else {
-            newPair->key = key;
-            newPair->value = value;
-            newPair->next = hashTable->bucketArray[hashValue];
-            hashTable->bucketArray[hashValue] = newPair;
-            hashTable->numOfElements++;
-
-            if (hashTable->upperRehashThreshold > hashTable->idealRatio) {
-                float elementToBucketRatio = (float) hashTable->numOfElements /
-                                             (float) hashTable->numOfBuckets;
-                if (elementToBucketRatio > hashTable->upperRehashThreshold)
-                    HashTableRehash(hashTable, 0);
-            }
-        }
-    }
+  if (loop->add(csd, EV_READ, &ep[0])) {
+    socket_close(csd);
+    socket_close(rsd);
+    free_pair(ep->conn);
+    return 0;
+  }
 
+  if (loop->add(rsd, EV_READ, &ep[1])) {
+    loop->remove(csd);
+    socket_close(csd);
+    socket_close(rsd);
+    free_pair(ep->conn);
     return 0;
+  }
+
+  return ep;
 }
 
+/*
+ * Requests termination of the FTP forwarder spawned for a connection.
+ * It is known by a pidfd, which cannot point to another process once
+ * it has been reaped.
+ */
+static void gc_clean(tcp_conn *conn)
+{
+  if (conn->ftp_pidfd == -1)
+    return;
+
+  ONVERBOSE(syslog(LOG_DEBUG, "Requesting termination of FTP forwarder for FD %d", conn->ep[0].fd));
 
-void *HashTableGet(const HashTable *hashTable, const void *key) {
-    long hashValue = hashTable->hashFunction(key) % hashTable->numOfBuckets;
-    KeyValuePair *pair = hashTable->bucketArray[hashValue];
+  if (syscall(SYS_pidfd_send_signal, conn->ftp_pidfd, SIGUSR1, 0, 0) && errno != ESRCH)
+    syslog(LOG_ERR, "Can't request grandchild termination: %m");
+  close(conn->ftp_pidfd);
+  conn->ftp_pidfd = -1;
+}
+
+static void gc_fill(tcp_conn *conn, pid_t pid)
+{
+  gc_clean(conn);
 
-    while (pair != NULL && hashTable->keycmp(key, pair->key) != 0)
-        pair = pair->next;
+  int pidfd = syscall(SYS_pidfd_open, pid, 0);
+  if (pidfd == -1) {
+    syslog(LOG_WARNING, "Can't store PID %d for termination request: %m", pid);
+    return;
+  }
+  fcntl(pidfd, F_SETFD, FD_CLOEXEC);
+  conn->ftp_pidfd = pidfd;
 
-    return (pair == NULL)? NULL : pair->value;
+  ONVERBOSE(syslog(LOG_DEBUG, "PID %d stored for termination request on FD %d", pid, conn->ep[0].fd));
 }
 
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+static int open_pipe(tcp_endpoint *ep)
+{
+  int fds[2];
+  if (pipe2(fds, O_NONBLOCK | O_CLOEXEC)) {
+    syslog(LOG_ERR, "Can't create pipe for splice(): %m");
+    return -1;
+  }
 
-void HashTableRemove(HashTable *hashTable, const void *key) {
-    long hashValue = hashTable->hashFunction(key) % hashTable->numOfBuckets;
-    KeyValuePair *pair = hashTable->bucketArray[hashValue];
-    KeyValuePair *previousPair = NULL;
+  ep->pipe_rd = fds[0];
+  ep->pipe_wr = fds[1];
+  ep->piped   = 0;
+  return 0;
+}
 
-    while (pair != NULL && hashTable->keycmp(key, pair->key) != 0) {
-        previousPair = pair;
-        pair = pair->next;
-    }
+static void close_pipe(tcp_endpoint *ep)
+{
+  if (ep->pipe_rd != -1) {
+    close(ep->pipe_rd);
+    close(ep->pipe_wr);
+    ep->pipe_rd = -1;
+    ep->pipe_wr = -1;
+  }
+  ep->piped = 0;
+}
 
-    if (pair != NULL) {
-        if (hashTable->keyDeallocator != NULL)
-            hashTable->keyDeallocator((void *) pair->key);
-        if (hashTable->valueDeallocator != NULL)
-            hashTable->valueDeallocator(pair->value);
-        if (previousPair != NULL)
-            previousPair->next = pair->next;
-        else
-            hashTable->bucketArray[hashValue] = pair->next;
-        free(pair);
-        hashTable->numOfElements--;
+static void seg_free(event_loop *loop, out_seg *s)
+{
+  if (s->buf != -1)
+    loop->give_back(s->buf);
+  else
+    chunk_pool.put((out_chunk *) s->data);
+  seg_pool.put(s);
+}
 
-        if (hashTable->lowerRehashThreshold > 0.0) {
-            float elementToBucketRatio = (float) hashTable->numOfElements /
-                                         (float) hashTable->numOfBuckets;
-            if (elementToBucketRatio < hashTable->lowerRehashThreshold)
-                HashTableRehash(hashTable, 0);
-        }
-    }
+/*
+ * Drops the output io_uring has pending for ep, but for what is in
+ * flight: the event loop reports it still, see uring_sent().
+ */
+static void sendq_drop(event_loop *loop, tcp_endpoint *ep)
+{
+  out_seg *s = ep->sendq;
+  while (s) {
+    out_seg *next = s->next;
+    if (!s->in_flight)
+      seg_free(loop, s);
+    s = next;
+  }
+
+  ep->sendq      = 0;
+  ep->sendq_tail = 0;
+  ep->queued     = 0;
+  ep->sending    = 0;
+}
+
+/*
+ * Stops watching and closes a pair of communicating sockets, and ends
+ * its FTP forwarder if any.
+ *
+ * The connection itself is only released by free_pairs(), since
+ * the other side may still be pending in the current batch of events.
+ */
+static void close_pair(event_loop *loop, tcp_endpoint *ep, tcp_conn **dead)
+{
+  tcp_endpoint *peer = ep->peer;
+
+  close_pipe(ep);
+  close_pipe(peer);
+  sendq_drop(loop, ep);
+  sendq_drop(loop, peer);
+
+  if (ep->fd != -1) {
+    loop->remove(ep->fd);
+    socket_close(ep->fd);
+    ep->fd = -1;
+  }
+  if (peer->fd != -1) {
+    loop->remove(peer->fd);
+    socket_close(peer->fd);
+    peer->fd = -1;
+  }
+
+  gc_clean(ep->conn);
+
+  ep->conn->next = *dead;
+  *dead = ep->conn;
 }
 
+static void free_pairs(tcp_conn **dead)
+{
+  while (*dead) {
+    tcp_conn *conn = *dead;
+    *dead = conn->next;
+    free_pair(conn);
+  }
+}
 
-int grandchild_pid[PORTFWD_MAX_FD];
+static int out_pending(const tcp_endpoint *ep)
+{
+  return ep->out_len - ep->out_off + ep->piped + ep->queued;
+}
 
 /*
- * Returns -1 on failure; file descriptor on success.
+ * Returns -1 when write() failed for good; 0 when it is to be retried.
+ * EINPROGRESS: the first write of a TCP Fast Open connection found
+ * the handshake still going on.
  */
-int tcp_connect(const struct ip_addr *ip, int port)
+static int write_error()
 {
-  int rsd = socket(PF_INET, SOCK_STREAM, get_protonumber(P_TCP));
-  if (rsd == -1) {
-    syslog(LOG_ERR, "tcp_connect: Can't create TCP socket: %m");
-    return -1;
+  if (errno == EAGAIN || errno == EINTR || errno == EINPROGRESS)
+    return 0;
+
+  if (errno == EPIPE) {
+    ONVERBOSE2(syslog(LOG_DEBUG, "copy: Broken pipe: %m"));
   }
-  DEBUGFD(syslog(LOG_DEBUG, "socket open: FD %d", rsd));
+  else
+    syslog(LOG_ERR, "copy: Failure writing to socket: %m");
+  return -1;
+}
 
-  struct sockaddr_in sa;
-  sa.sin_family      = PF_INET;
-  sa.sin_port        = htons(port);
-  sa.sin_addr.s_addr = *((unsigned int *) ip->addr);
-  memset((char *) sa.sin_zero, 0, sizeof(sa.sin_zero));
+/*
+ * Writes as much pending output as the socket takes.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int out_flush(tcp_endpoint *ep)
+{
+  while (ep->out_off < ep->out_len) {
+    int wr = write(ep->fd, ep->out + ep->out_off, ep->out_len - ep->out_off);
+    if (wr == -1)
+      return write_error();
+    ep->out_off += wr;
+  }
 
-  if (connect(rsd, (struct sockaddr *) &sa, sizeof(sa))) {
-    syslog(LOG_ERR, "tcp_connect: Can't connect to %s:%d: %m", inet_ntoa(sa.sin_addr), port);
-    socket_close(rsd);
-    return -1;
+  ep->out_off = 0;
+  ep->out_len = 0;
+
+  while (ep->piped) {
+    int wr = splice(ep->pipe_rd, 0, ep->fd, 0, ep->piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (wr == -1)
+      return write_error();
+    ep->piped -= wr;
   }
 
-  return rsd;
+  return 0;
 }
 
 /*
- * Returns host_map success; NULL on failure.
+ * Keeps "len" bytes for out_flush() to write.
+ *
+ * Returns -1 on failure; 0 on success.
  */
-host_map *tcp_match(const vector<host_map*> *map_list, const struct ip_addr *ip, int port)
+static int out_queue(tcp_endpoint *ep, const char *data, int len)
 {
-  host_map *hm;
-  iterator<vector<host_map*>,host_map*> it(*map_list);
-  for (it.start(); it.cont(); it.next()) {
-    hm = it.get();
-    if (hm->tcp_match(ip, port))
-      return hm;
+  if (ep->out_len + len > ep->out_size) {
+    int pending = ep->out_len - ep->out_off;
+    if (ep->out_off && pending + len <= ep->out_size) {
+      memmove(ep->out, ep->out + ep->out_off, pending);
+    }
+    else {
+      int size = MAX(ep->out_size * 2, pending + len);
+      char *out = (char *) malloc(size);
+      if (!out) {
+	syslog(LOG_ERR, "copy: Can't allocate %d bytes of pending output", size);
+	return -1;
+      }
+      memcpy(out, ep->out + ep->out_off, pending);
+      free(ep->out);
+      ep->out      = out;
+      ep->out_size = size;
+    }
+    ep->out_off = 0;
+    ep->out_len = pending;
+  }
+
+  memcpy(ep->out + ep->out_len, data, len);
+  ep->out_len += len;
+  return 0;
+}
+
+/*
+ * Writes "len" bytes to the endpoint, keeping what the socket does
+ * not take for out_flush(). The reader stops feeding an endpoint with
+ * too much pending output, so the buffer stays within OUT_HIGH_WATER
+ * plus one read.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int out_write(tcp_endpoint *ep, const char *data, int len)
+{
+  if (!out_pending(ep)) {
+    int wr = write(ep->fd, data, len);
+    if (wr == -1) {
+      if (write_error())
+	return -1;
+      wr = 0;
+    }
+    data += wr;
+    len  -= wr;
+    if (!len)
+      return 0;
   }
+
+  return out_queue(ep, data, len);
+}
+
+/*
+ * Watches an endpoint for reading unless throttled or draining, and
+ * for writing while it has output pending.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int watch_events(event_loop *loop, tcp_endpoint *ep)
+{
+  if (ep->uring)
+    return 0; /* see uring_recv() */
+
+  unsigned int events = 0;
+  if (!ep->throttled && !ep->draining)
+    events |= EV_READ;
+  if (out_pending(ep))
+    events |= EV_WRITE;
+
+  if (events == ep->events)
+    return 0;
+  if (loop->modify(ep->fd, events, ep))
+    return -1;
+  ep->events = events;
   return 0;
 }
 
@@ -304,105 +636,83 @@ int simple_buf_copy(int src_fd, int trg_fd)
 
 void simple_tcp_forward(int sd, struct ip_addr *remote_ip, int remote_port)
 {
-  int dest_fd[PORTFWD_MAX_FD];
+  event_loop loop;
+  if (loop.open(EVENTS_PER_WAIT, 0))
+    return;
 
-  fd_set fds, tmp_fds;
-  int fd_set_len = sizeof(fd_set);
-  FD_ZERO(&fds);
-  int maxfd = 0;
-  fdset(sd, &fds, &maxfd);
-  int nd;
+  tcp_endpoint mother;
+  init_endpoint(&mother, sd, 0);
+  if (loop.add(sd, EV_READ, &mother))
+    return;
+
+  tcp_conn *dead = 0;
 
   for (;;) { /* forever */
-    /*
-     * Restores tmp_fds from fds.
-     */
-    memcpy(&tmp_fds, &fds, fd_set_len);
 
     /*
      * Wait for event: connection on sd or data on anyone else.
      */
-    DEBUGFD(syslog(LOG_DEBUG, "simple_forward: TCP select(): %d FDs", maxfd));
-    nd = select(maxfd, &tmp_fds, 0, 0, 0);
-    if (nd == -1) {
-      syslog(LOG_ERR, "simple_forward: TCP select() failed: %m");
+    int nd = loop.wait(-1);
+    if (nd == -1)
       continue;
-    }
 
-    /*
-     * Let's handle sd here (mother socket).
-     */
-    if (FD_ISSET(sd, &tmp_fds)) {
-
-      --nd;
+    for (int i = 0; i < nd; ++i) {
+      tcp_endpoint *ep = (tcp_endpoint *) loop.ready_ctx(i);
 
       /*
-       * Clear sd so it's ignored below in the
-       * loop for the client sockets.
+       * Let's handle sd here (mother socket).
        */
-      FD_CLR(sd, &tmp_fds); 
-
-      struct sockaddr_in cli_sa;
-      socklen_t cli_sa_len = sizeof(cli_sa);
-      int csd = accept(sd, (struct sockaddr *) &cli_sa, &cli_sa_len);
-      if (csd < 0)
-	syslog(LOG_ERR, "simple_forward: Can't accept TCP socket: %m");
-      else {
+      if (ep->mother) {
+	struct sockaddr_in cli_sa;
+	socklen_t cli_sa_len = sizeof(cli_sa);
+	int csd = accept(sd, (struct sockaddr *) &cli_sa, &cli_sa_len);
+	if (csd < 0) {
+	  syslog(LOG_ERR, "simple_forward: Can't accept TCP socket: %m");
+	  continue;
+	}
+
 	int cli_port = ntohs(cli_sa.sin_port);
 	ONVERBOSE(syslog(LOG_DEBUG, "simple_forward: TCP connection from %s:%d", inet_ntoa(cli_sa.sin_addr), cli_port));
 
 	/*
 	 * Connect to destination.
 	 */
-	  
 	int rsd = tcp_connect(remote_ip, remote_port);
-	if (rsd != -1) {
-	  if ((csd >= PORTFWD_MAX_FD) || (rsd >= PORTFWD_MAX_FD)) {
-	    syslog(LOG_ERR, "simple_forward: Destination socket descriptors overflow");
-	    socket_close(csd);
-	    socket_close(rsd);
-	  }
-	  else {
-	    /*
-	     * Add pair of communicating sockets.
-	     */
-	    fdset(csd, &fds, &maxfd);
-	    fdset(rsd, &fds, &maxfd);
-	  
-	    /*
-	     * Save peers so they can be remembered later.
-	     */
-	    dest_fd[csd] = rsd;
-	    dest_fd[rsd] = csd;
-	  }
+	if (rsd == -1) {
+	  socket_close(csd);
+	  continue;
 	}
-      }
 
-    } /* sd (mother socket) handled */
+	/*
+	 * Add pair of communicating sockets.
+	 */
+	if (!add_pair(&loop, csd, rsd))
+	  ONVERBOSE(syslog(LOG_DEBUG, "simple_forward: Could not watch new pair"));
 
-    /*
-     * Now all other sockets.
-     */
-    for (int src_fd = 0; nd; ++src_fd)
-      if (FD_ISSET(src_fd, &tmp_fds)) {
-	--nd;
-	int trg_fd = dest_fd[src_fd];
+	continue;
+      } /* sd (mother socket) handled */
+
+      /*
+       * Skip endpoints closed earlier in this round.
+       */
+      if (ep->fd == -1)
+	continue;
+
+      /*
+       * Copy data.
+       */
+      int fail = simple_buf_copy(ep->fd, ep->peer->fd);
+      if (fail) {
 	/*
-	 * Copy data.
+	 * Remove pair of communicating sockets.
 	 */
-	int fail = simple_buf_copy(src_fd, trg_fd);
-	if (fail) {
-	  /*
-	   * Remove pair of communicating sockets.
-	   */
-	  DEBUGFD(syslog(LOG_DEBUG, "simple_forward: closed socket (FD %d or %d)", src_fd, trg_fd));
-
-	  fdclear(src_fd, &fds, &maxfd);
-	  fdclear(trg_fd, &fds, &maxfd);
-	  socket_close(src_fd);
-	  socket_close(trg_fd);
-	}
+	DEBUGFD(syslog(LOG_DEBUG, "simple_forward: closed socket (FD %d or %d)", ep->fd, ep->peer->fd));
+
+	close_pair(&loop, ep, &dead);
       }
+    }
+
+    free_pairs(&dead);
 
   } /* main loop */
 
@@ -410,7 +720,7 @@ void simple_tcp_forward(int sd, struct ip_addr *remote_ip, int remote_port)
 
 int ftp_spawn(struct ip_addr *local_ip, int *local_port, struct ip_addr *remote_ip, int remote_port)
 {
-  int sd = tcp_listen(local_ip, local_port, 3);
+  int sd = tcp_listen(local_ip, local_port, 3, 0, 0);
   if (sd == -1) {
     syslog(LOG_ERR, "FTP spawn: Can't listen: %m");
     return -1;
@@ -457,33 +767,12 @@ int ftp_spawn(struct ip_addr *local_ip, int *local_port, struct ip_addr *remote_
   exit(1);
 }
 
-void gc_clean(int fd)
-{
-  pid_t pid = grandchild_pid[fd];
-  if (pid != -1) {
-    ONVERBOSE(syslog(LOG_DEBUG, "Requesting termination of PID %d for FD %d", pid, fd));
-
-    if (kill(pid, SIGUSR1))
-      syslog(LOG_ERR, "Can't request grandchild termination for PID: %d: %m", pid);
-    grandchild_pid[fd] = -1;
-  }
-}
-
-void gc_fill(int fd, pid_t pid)
+int ftp_active(const struct ip_addr *actv_ip, char *buf, int *rd, tcp_conn *conn)
 {
-  gc_clean(fd);
+  if (strncasecmp(buf, "port", 4))
+    return 0;
 
-  grandchild_pid[fd] = pid;
-
-  ONVERBOSE(syslog(LOG_DEBUG, "PID %d stored for termination request on FD %d", pid, fd));
-}
-
-int ftp_active(const struct ip_addr *actv_ip, char *buf, int *rd, int src_fd, int trg_fd)
-{
-  if (strncasecmp(buf, "port", 4))
-    return 0;
-
-  ONVERBOSE(syslog(LOG_DEBUG, "Active FTP request detected: %s", buf));
+  ONVERBOSE(syslog(LOG_DEBUG, "Active FTP request detected: %s", buf));
 
   char *i = strchr(buf, ' ');
   if (!i) {
@@ -558,13 +847,12 @@ int ftp_active(const struct ip_addr *actv_ip, char *buf, int *rd, int src_fd, in
   /*
    * Store forwarder's PID so it can be terminated.
    */
-  gc_fill(src_fd, pid);
-  gc_fill(trg_fd, pid);
+  gc_fill(conn, pid);
 
   return 0;
 }
 
-int ftp_passive(const struct ip_addr *pasv_ip, char *buf, int *rd, int src_fd, int trg_fd)
+int ftp_passive(const struct ip_addr *pasv_ip, char *buf, int *rd, tcp_conn *conn)
 {
   if (memcmp(buf, "227", 3))
     return 0;
@@ -643,128 +931,207 @@ int ftp_passive(const struct ip_addr *pasv_ip, char *buf, int *rd, int src_fd, i
   /*
    * Store forwarder's PID so it can be terminated.
    */
-  gc_fill(src_fd, pid);
-  gc_fill(trg_fd, pid);
+  gc_fill(conn, pid);
 
   return 0;
 }
 
 
-typedef struct{
-  unsigned long long in_offset;
-  unsigned long long out_offset;
-  unsigned long long session_key;
-  int inflate_when_copying;
-} clientSock_session_t;
-
-HashTable * fd_offset_table = NULL;
-void remove_fd_offset(int fd){
-  HashTableRemove(fd_offset_table,  (void *)(1llu+fd));
-}
-
-// The portfwdXOR program is not for protecting the data to the maximum level. It is to camouflage the communication so that it cannot be censored at a low cost. 
-// Hence the pesudo RNG is very simple.
-int pseudo_rand_key_offset(long long key, long long offset, long long session_key){
-  return (int) (( key ^(((offset + key)<< 27) % 2038074739ll ) ^ (( offset <<3+ session_key ) % 3603804991llu ))% 41621llu );
-}
-
-int is_insertion_byte(long long key, long long inflated_offset, long long  session_key){
-  if(key==0) return 0;
-  int vr =  pseudo_rand_key_offset(key, inflated_offset, session_key);
-
+/*
+ * Whether the inflated stream carries a random byte at
+ * inflated_offset, vr being the confusing key value there.
+ */
+static int is_insertion(int vr, long long inflated_offset){
+  if(inflated_offset > 75102) return vr < 1000; /* vcut never exceeds it */
   long long vcut = 10000 + ( vr<<14 )  % 65103llu;
   if(vcut > inflated_offset) return vr > (vr<<14 + inflated_offset) % 30857 + 10000;
   else return vr < 1000;
 }
 
-int apply_XOR_buf(long long XOR_key, long long confusing_key, char *buf, char ** buf2, int * rd, int sock_fd, int need_session){
-  clientSock_session_t * session = NULL;
-
-  if( need_session ) session = (clientSock_session_t *)HashTableGet(fd_offset_table, (void *)(1llu+sock_fd));
+/*
+ * Transforms the "rd" bytes of buf, read within session (NULL for
+ * none, as with UDP), and points
+ * buf2 at the result: buf itself, or the session's inflated buffer,
+ * which stays valid until the next call for the same session.
+ */
+void apply_XOR_buf(long long XOR_key, long long confusing_key, char *buf, char ** buf2, int * rd, clientSock_session_t * session){
   int xx;
+  int vr[KEYSTREAM_CHUNK];
+
+  if(session && session -> version == 2){
+    if(session -> inflate_when_copying){
+      if(session->inflated_size < INFLATED_SZ(*rd)){
+        session->inflated_size = INFLATED_SZ(BUF_SZ > *rd ? BUF_SZ : *rd);
+        free(session->inflated);
+        session->inflated = (char*)malloc(session->inflated_size);
+      }
+      int used = 0;
+      int oxx = 0;
+      for(;;){
+        int n;
+        oxx += ks2_inflate(&session->ks2, &session->out_offset, buf + used, *rd - used,
+                           session->inflated + oxx, session->inflated_size - oxx, &n);
+        used += n;
+        if(used == *rd) break;
+        session->inflated_size = session->inflated_size*1.5 +1;
+        session->inflated = (char*)realloc(session->inflated, session->inflated_size);
+      }
+      *rd = oxx;
+      *buf2 = session->inflated;
+    }else{
+      *rd = ks2_deflate(&session->ks2, &session->in_offset, buf, *rd);
+      *buf2 = buf;
+    }
+    return;
+  }
 
   if(session && session -> inflate_when_copying){
-    for(xx = 0; xx<*rd; xx++){
-      unsigned long long offs = session->in_offset+xx;
-      buf[xx] ^= (pseudo_rand_key_offset(XOR_key, offs,  session -> session_key)&0xff);
-    }
+    keystream_xor(buf, *rd, XOR_key, session->in_offset, session -> session_key);
     session->in_offset+=(*rd);
     int oxx = 0;
     xx = 0;
 
-    int buf2_size = (*rd)*1.8 + 3;
-    (*buf2) = (char*)malloc(buf2_size);
+    /*
+     * Confusing key values, computed ahead for as many offsets as
+     * there are bytes left, at least one offset each.
+     */
+    int nvr = 0;
+    int ivr = 0;
+
+    if(session->inflated_size < INFLATED_SZ(*rd)){
+      session->inflated_size = INFLATED_SZ(BUF_SZ > *rd ? BUF_SZ : *rd);
+      free(session->inflated);
+      session->inflated = (char*)malloc(session->inflated_size);
+    }
+    char *out = session->inflated;
     while(xx <  * rd){
-      if(buf2_size <= oxx){
-         buf2_size = buf2_size*1.5 +1;
-         *buf2 = (char*)realloc(*buf2, buf2_size);
+      if(session->inflated_size <= oxx){
+         session->inflated_size = session->inflated_size*1.5 +1;
+         session->inflated = (char*)realloc(session->inflated, session->inflated_size);
+         out = session->inflated;
+      }
+
+      int insert = 0;
+      if(confusing_key){
+        if(ivr == nvr){
+          nvr = *rd - xx < KEYSTREAM_CHUNK ? *rd - xx : KEYSTREAM_CHUNK;
+          keystream(vr, nvr, confusing_key, session->out_offset, session -> session_key);
+          ivr = 0;
+        }
+        insert = is_insertion(vr[ivr++], session->out_offset);
       }
 
-      if(is_insertion_byte(confusing_key, session->out_offset, session -> session_key)) (*buf2)[oxx] = (char)(pseudo_rand_key_offset(confusing_key, session->out_offset+33378787llu, session -> session_key)&0xff);
-      else (*buf2)[oxx] = buf[xx++];
+      if(insert) out[oxx] = (char)(pseudo_rand_key_offset(confusing_key, session->out_offset+33378787llu, session -> session_key)&0xff);
+      else out[oxx] = buf[xx++];
       oxx++;
       session->out_offset++;
     }
     *rd = oxx;
-    return 1;
+    *buf2 = out;
+    return;
   }else if(session && !session -> inflate_when_copying){
     int wxx = 0;
-    for(xx=0; xx<*rd; xx++){
-       if(!is_insertion_byte(confusing_key, session->in_offset + xx, session -> session_key)) {
-         if(wxx !=xx) buf[wxx] = buf[xx];
-         wxx++;
-       }
+    int n;
+    for(xx=0; xx<*rd; xx+=n){
+      n = *rd - xx < KEYSTREAM_CHUNK ? *rd - xx : KEYSTREAM_CHUNK;
+      if(confusing_key)
+        keystream(vr, n, confusing_key, session->in_offset + xx, session -> session_key);
+      for(int i=0; i<n; i++){
+        if(!confusing_key || !is_insertion(vr[i], session->in_offset + xx + i)) {
+          if(wxx != xx+i) buf[wxx] = buf[xx+i];
+          wxx++;
+        }
+      }
     }
     session->in_offset += (*rd);
-    for(xx=0; xx<wxx; xx++){
-      unsigned long long offs = session->out_offset+xx;
-      buf[xx] ^=  (pseudo_rand_key_offset(XOR_key, offs, session -> session_key)&0xff);
-    }
+    keystream_xor(buf, wxx, XOR_key, session->out_offset, session -> session_key);
     session->out_offset += wxx;
     *rd = wxx;
     *buf2 = buf;
-    return 0;
   }else{
-    for(xx = 0; xx<*rd; xx++)
-      buf[xx] ^= (pseudo_rand_key_offset(XOR_key, xx, 0ll) & 0xff);
+    keystream_xor(buf, *rd, XOR_key, 0, 0);
 
     *buf2 = buf;
-    return 0;
   }
 }
 
-int buf_copy(int src_fd, int trg_fd, const struct ip_addr *actv_ip, const struct ip_addr *pasv_ip, long long XOR_key, long long confusing_key)
+/*
+ * Sends "rd" bytes read from src on to its peer, through FTP
+ * rewriting and the XOR transform (unless plain). "buf" must hold
+ * BUF_SZ bytes. Reading from src is throttled when the peer has too
+ * much output pending.
+ */
+int buf_forward(tcp_endpoint *src, char *buf, int rd, const tcp_service *svc)
+{
+  tcp_endpoint *trg = src->peer;
+
+  if (svc->actv_ip)
+    if (ftp_active(svc->actv_ip, buf, &rd, src->conn))
+      return -1;
+
+  if (svc->pasv_ip)
+    if (ftp_passive(svc->pasv_ip, buf, &rd, src->conn))
+      return -1;
+
+  char *buf2=buf;
+  if (!svc->opts->plain)
+    apply_XOR_buf(svc->XOR_key, svc->conf_key, buf, &buf2, &rd, src->session);
+  if (out_write(trg, buf2, rd))
+    return -1;
+
+  if (out_pending(trg) > OUT_HIGH_WATER)
+    src->throttled = 1;
+
+  return 0;
+}
+
+/*
+ * Returns -1 on failure; 1 on EOF; 0 on success.
+ */
+int buf_copy(tcp_endpoint *src, const tcp_service *svc)
 {
   char buf[BUF_SZ];
-  int rd = read(src_fd, buf, BUF_SZ);
+  int rd = read(src->fd, buf, BUF_SZ);
   if (!rd)
-    return -1;
+    return 1;
   if (rd < 0) {
+    if (errno == EAGAIN || errno == EINTR)
+      return 0;
     syslog(LOG_ERR, "copy: Failure reading from socket: %m");
     return -1;
   }
 
-  if (actv_ip)
-    if (ftp_active(actv_ip, buf, &rd, src_fd, trg_fd))
-      return -1;
+  return buf_forward(src, buf, rd, svc);
+}
 
-  if (pasv_ip)
-    if (ftp_passive(pasv_ip, buf, &rd, src_fd, trg_fd))
-      return -1;
+/*
+ * Plain maps: moves what src has to say on to its peer through the
+ * peer's pipe, never copying it to user space. Reading from src stops
+ * until that pipe is flushed.
+ *
+ * Returns -1 on failure; 1 on EOF; 0 on success.
+ */
+int buf_splice(tcp_endpoint *src)
+{
+  tcp_endpoint *trg = src->peer;
 
-  char *buf2=NULL;
-  int need_free = apply_XOR_buf(XOR_key, confusing_key, buf, &buf2, &rd, src_fd, 1);
-  int wr = write(trg_fd, buf2, rd);
-  if(need_free)free(buf2);
-  if (wr == -1) {
-    if (errno == EPIPE)
-      ONVERBOSE2(syslog(LOG_DEBUG, "copy: Broken pipe: %m"));
-    return -1;
+  int rd = splice(src->fd, 0, trg->pipe_wr, 0, SPLICE_LEN, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  if (!rd)
+    return 1;
+  if (rd < 0) {
+    if (errno != EAGAIN && errno != EINTR) {
+      syslog(LOG_ERR, "splice: Failure reading from socket: %m");
+      return -1;
+    }
+    rd = 0; /* nothing to read, or pipe full */
   }
-  if (wr < rd) {
-    ONVERBOSE(syslog(LOG_WARNING, "copy: Partial write to socket: %m"));
+  trg->piped += rd;
+
+  if (out_flush(trg))
     return -1;
-  }
+
+  if (out_pending(trg))
+    src->throttled = 1;
 
   return 0;
 }
@@ -786,7 +1153,64 @@ int drop_privileges(int uid, int gid)
   return 0;
 }
 
-int tcp_listen(const struct ip_addr *ip, int *port, int queue)
+/*
+ * Sizes the kernel buffers of "sd" as asked by "opts". Done before
+ * listen() or connect(), for the window scale to follow; accepted
+ * sockets take the sizes of their listener.
+ */
+void tcp_tune_buffers(int sd, const struct map_opts *opts)
+{
+  if (opts->send_buffer)
+    if (setsockopt(sd, SOL_SOCKET, SO_SNDBUF, &opts->send_buffer, sizeof(opts->send_buffer)))
+      syslog(LOG_WARNING, "Can't set send buffer: setsockopt(SO_SNDBUF) failed: %m");
+
+  if (opts->receive_buffer)
+    if (setsockopt(sd, SOL_SOCKET, SO_RCVBUF, &opts->receive_buffer, sizeof(opts->receive_buffer)))
+      syslog(LOG_WARNING, "Can't set receive buffer: setsockopt(SO_RCVBUF) failed: %m");
+}
+
+/*
+ * Sets the per-connection options of "opts" on a client or
+ * destination socket: TCP_NODELAY, keepalive and TCP_NOTSENT_LOWAT.
+ *
+ * With keepalive, probes start after "keepalive" idle seconds and
+ * go every quarter of it: a dead peer is dropped after about twice
+ * that.
+ */
+void tcp_tune(int sd, const struct map_opts *opts)
+{
+  if (opts->nodelay) {
+    int one = 1;
+    if (setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)))
+      syslog(LOG_WARNING, "Can't set TCP_NODELAY: %m");
+  }
+
+  if (opts->keepalive) {
+    int one      = 1;
+    int idle     = opts->keepalive;
+    int interval = MAX(opts->keepalive / 4, 1);
+    int count    = 4;
+    if (setsockopt(sd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one))
+	|| setsockopt(sd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle))
+	|| setsockopt(sd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval))
+	|| setsockopt(sd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)))
+      syslog(LOG_WARNING, "Can't set keepalive: %m");
+  }
+
+#ifdef TCP_NOTSENT_LOWAT
+  if (opts->notsent_lowat)
+    if (setsockopt(sd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &opts->notsent_lowat, sizeof(opts->notsent_lowat)))
+      syslog(LOG_WARNING, "Can't set TCP_NOTSENT_LOWAT: %m");
+#endif
+}
+
+/*
+ * With "opts", the socket buffers of the map are sized, and with
+ * opts->fast_open, clients that got a TCP Fast Open cookie may send
+ * their first bytes with the SYN; up to that many such connections
+ * wait for accept() at a time.
+ */
+int tcp_listen(const struct ip_addr *ip, int *port, int queue, int reuse_port, const struct map_opts *opts)
 {
   int sd = socket(PF_INET, SOCK_STREAM, get_protonumber(P_TCP));
   if (sd == -1) {
@@ -819,6 +1243,22 @@ int tcp_listen(const struct ip_addr *ip, int *port, int queue)
   }
 #endif /* NO_SO_REUSEADDR */
 
+  /*
+   * Let every worker bind its own copy of the socket, so the
+   * kernel spreads incoming connections among them.
+   */
+  if (reuse_port) {
+    int one = 1;
+
+    ONVERBOSE(syslog(LOG_DEBUG, "Setting SO_REUSEPORT for TCP listening socket on port %d", prt));
+
+    if (setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, (char *) &one, sizeof(one)) == -1) {
+      syslog(LOG_ERR, "tcp_listen(): Can't share port among workers: setsockopt(SO_REUSEPORT) failed: %m");
+      socket_close(sd);
+      return -1;
+    }
+  }
+
 
   if (bind(sd, (struct sockaddr *) &sa, sa_len)) {
     syslog(LOG_ERR, "listen: Can't bind TCP socket: %m: %s:%d", inet_ntoa(sa.sin_addr), prt);
@@ -834,6 +1274,16 @@ int tcp_listen(const struct ip_addr *ip, int *port, int queue)
   }
   prt = ntohs(sa.sin_port);
 
+  if (opts)
+    tcp_tune_buffers(sd, opts);
+
+  if (opts && opts->fast_open) {
+    ONVERBOSE(syslog(LOG_DEBUG, "Setting TCP_FASTOPEN for TCP listening socket on port %d", prt));
+
+    if (setsockopt(sd, IPPROTO_TCP, TCP_FASTOPEN, &opts->fast_open, sizeof(opts->fast_open)) == -1)
+      syslog(LOG_WARNING, "tcp_listen(): Can't accept TCP Fast Open: setsockopt(TCP_FASTOPEN) failed: %m");
+  }
+
   if (listen(sd, queue)) {
     syslog(LOG_ERR, "listen: Can't listen TCP socket: %m");
     fprintf(stderr, "listen: Can't listen TCP socket: %m");
@@ -857,321 +1307,2780 @@ void close_sockets(vector<int> *port_list)
   DEBUGFD(syslog(LOG_DEBUG, "close_sockets(): Sockets closed: %d", port_list->get_size()));
 }
 
-void fill_rand(unsigned char * b, int c){
-  FILE * ufp = fopen("/dev/urandom","rb");
-  fread(b, 1, c, ufp);
-  fclose(ufp);
-}
+/*
+ * Random bytes for session keys come from a pool of each thread,
+ * refilled RAND_POOL_SZ bytes at a time with getrandom(). Bytes
+ * handed out are wiped from the pool.
+ */
+const int RAND_POOL_SZ = 4096;
 
+static __thread unsigned char rand_pool[RAND_POOL_SZ];
+static __thread int           rand_left = 0;
 
-class Try_connect_delayer {
-private:
-  static Try_connect_delayer *Try_connect_delayers;
-  static Try_connect_delayer *tail;
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+int fill_rand(unsigned char * b, int c){
+  while (c > 0) {
+    if (!rand_left) {
+      int got = 0;
+      while (got < RAND_POOL_SZ) {
+	ssize_t rd = getrandom(rand_pool + got, RAND_POOL_SZ - got, 0);
+	if (rd == -1) {
+	  if (errno == EINTR)
+	    continue;
+	  syslog(LOG_ERR, "Can't get random bytes: %m");
+	  return -1;
+	}
+	got += rd;
+      }
+      rand_left = RAND_POOL_SZ;
+    }
 
-  time_t timeout;
-  host_map *hm;
-  struct sockaddr_in cli_sa;
-  struct ip_addr ip;
-  int cli_port;
-  const struct ip_addr *src;
-  struct sockaddr_in local_cli_sa;
-  int csd;
-  fd_set *fds;
-  int *maxfd;
-  int *dest_fd;
-  int on_remote_server;
-  long long confusing_key;
+    unsigned char *p = rand_pool + RAND_POOL_SZ - rand_left;
+    int n = MIN(c, rand_left);
+    memcpy(b, p, n);
+    memset(p, 0, n);
+    rand_left -= n;
+    b += n;
+    c -= n;
+  }
+  return 0;
+}
 
-  Try_connect_delayer *next;
 
-public:
-  Try_connect_delayer(host_map *hm, struct sockaddr_in *cli_sa, struct ip_addr *ip,
-          int cli_port, const struct ip_addr *src, struct sockaddr_in *local_cli_sa,
-          int csd, fd_set *fds, int *dest_fd, int *maxfd, int ImOnRemote, long long confuskey) {
-    this->hm = hm;
-    this->cli_sa = *cli_sa;
-    this->ip = *ip;
-    this->cli_port = cli_port;
-    this->src = src;
-    this->local_cli_sa = *local_cli_sa;
-    this->csd = csd;
-    this->fds = fds;
-    this->dest_fd = dest_fd;
-    this->maxfd = maxfd;
-    this->next = NULL;
-    this->on_remote_server = ImOnRemote;
-    this->confusing_key = confuskey;
-  }
-
-  void queue() {
-    this->timeout = time(NULL) + 10;
-    if (tail)
-      tail->next = this;
-    else
-      Try_connect_delayers = tail = this;
-  }
+/*
+ * An event loop of its own, run by a thread of its own, serving
+ * a SO_REUSEPORT copy of every listening socket of the map.
+ */
+/*
+ * Idle upstream connections of a worker for one host_map, connected
+ * and keyed in advance (see Try_connect_delayer::park()).
+ */
+struct warm_pool {
+  host_map            *hm;
+  int                 target;   /* connections to keep */
+  Try_connect_delayer *idle;    /* ready to take */
+  int                 idle_count;
+  int                 warming;  /* being connected and keyed */
+  timer               refill;   /* in w->refilling while backing off */
+  int                 mux;      /* tunnels to keep; 0: none */
+  int                 mux_warming;
+  mux_tunnel          *tunnels; /* keyed, carrying streams */
+  int                 tunnel_count;
+  mux_stream          *waiting; /* clients accepted before any tunnel was up */
+};
 
-  int pipe() {
-    int rsd = 0;
-    socklen_t cli_sa_len = sizeof(cli_sa);
+struct tcp_worker {
+  int               id;
+  pthread_t         thread;
+  vector<int>       listeners;
+  const tcp_service *svc;
+  long long         now;         /* now_ms() as of the current round */
+  int               spare_fd;    /* given up to turn clients away when out of descriptors; -1 if none */
+  int               shedding;    /* doing so */
+  accept_limit      *limiter;    /* NULL without accept-rate */
+
+  event_loop        loop;
+  timer_list        connecting;  /* upstream connections in progress */
+  timer_list        retrying;    /* fragile: waiting for another round */
+  timer_list        handshaking; /* session key exchanges in progress */
+  timer_list        refilling;   /* warm pools backing off after failures */
+  timer_list        mux_connecting; /* remote side: streams connecting */
+  timer_list        mux_waiting;    /* local side: clients waiting for a tunnel */
+  timer_list        idling;      /* established pairs, by last activity (idle-timeout) */
+  timer_list        aging;       /* established pairs, by start (session-timeout) */
+  timer_list        mux_idling;  /* streams carrying data, likewise */
+  timer_list        mux_aging;
+  timer_list        starving;    /* io_uring: endpoints waiting for buffers to receive into */
+  warm_pool         *pools;      /* one per host_map; NULL without warm-pool nor mux */
+  int               pool_count;
+  tcp_conn          *dead;       /* see close_pair() */
+  mux_stream        *dead_streams; /* see mux_stream_free() */
+  mux_tunnel        *dead_tunnels;
+};
 
-    if (hm->pipe(&rsd, &cli_sa, cli_sa_len, &ip, cli_port, src, &local_cli_sa)) {
-      return 1;
-    }
+/*
+ * A client connection carried by a mux_tunnel: on the local side the
+ * client, on the remote side its destination.
+ */
+struct mux_stream {
+  tcp_endpoint ep;            /* first: handed back by the event loop */
+  mux_tunnel   *tunnel;       /* NULL while waiting for one */
+  warm_pool    *pool;         /* local side: where it waits */
+  unsigned int id;
+  int          connecting;    /* remote side: destination not answered yet */
+  int          closing;       /* MUX_CLOSE sent or received: no more frames */
+  long long    send_window;   /* bytes it may still send */
+  long long    received;      /* MUX_DATA bytes received */
+  long long    credited;      /* of those, handed back by MUX_WINDOW */
+  to_addr      *dst;          /* destination counting it as active */
+  conn_limit   *limit;        /* local side: counting its client; NULL if none */
+  unsigned int src;
+  timer        idle;          /* carrying data: in w->mux_idling */
+  timer        life;          /* carrying data: in w->mux_aging */
+  int          first_dst;
+  int          attempt;
+  int          skip_down;
+  long long    connect_start; /* now_us() clock */
+  timer        tm;            /* in w->mux_connecting or w->mux_waiting */
+  mux_stream   *next;         /* in its hash bucket, or in pool->waiting */
+  mux_stream   *next_dead;
+};
 
-    if ((csd >= PORTFWD_MAX_FD) || (rsd >= PORTFWD_MAX_FD)) {
-      syslog(LOG_ERR, "Destination socket descriptors overflow");
-      socket_close(csd);
-      socket_close(rsd);
-      return 0;
-    }
+static __thread slab_pool<mux_stream> stream_pool;
 
-    /*
-     * Add pair of communicating sockets.
-     */
-    fdset(csd, fds, maxfd);
-    fdset(rsd, fds, maxfd);
-  
-    /*
-     * Save peers so they can be remembered later.
-     */
-    dest_fd[csd] = rsd;
-    dest_fd[rsd] = csd;
-    if(NULL == fd_offset_table){
-      fd_offset_table = HashTableCreate(2000);
-      fd_offset_table -> valueDeallocator = free;
-    }
-  
-    clientSock_session_t*session_csd = (clientSock_session_t*)calloc(sizeof(clientSock_session_t),1);
-    session_csd -> inflate_when_copying = !on_remote_server;
-    clientSock_session_t*session_rsd = (clientSock_session_t*)calloc(sizeof(clientSock_session_t),1);
-    session_rsd -> inflate_when_copying = on_remote_server;
+/*
+ * A connection between the local and the remote server, keyed like
+ * any other, carrying streams. Its tcp_conn holds the session keys;
+ * the other endpoint of the pair has no socket.
+ */
+struct mux_tunnel {
+  tcp_endpoint       *ep;        /* the tunnel's socket */
+  host_map           *hm;
+  warm_pool          *pool;      /* local side; NULL on the remote side */
+  struct sockaddr_in cli_sa;     /* remote side: where the tunnel comes from */
+  struct ip_addr     ip;
+  int                cli_port;
+  struct sockaddr_in local_sa;
+  int                ready;      /* MUX_HELLO received */
+  int                congested;  /* too much output pending: streams stop reading */
+  int                broken;     /* to close once the event is handled */
+  int                closed;
+  unsigned int       next_id;    /* streams ids only grow */
+  mux_stream         **buckets;  /* streams by id */
+  int                bucket_count;
+  int                streams;
+  mux_reader         reader;
+  long long          started_at; /* now_ms() clock */
+  mux_tunnel         *next;      /* in pool->tunnels */
+  mux_tunnel         *next_dead;
+};
 
-    HashTablePut(fd_offset_table, (void *)(1llu+csd), session_csd);
-    HashTablePut(fd_offset_table, (void *)(1llu+rsd), session_rsd);
+static void warm_fill(tcp_worker *w, warm_pool *pool);
+static mux_tunnel *mux_tunnel_new(tcp_endpoint *tep, host_map *hm, warm_pool *pool, const struct sockaddr_in *cli_sa,
+                                  int cli_port, const struct sockaddr_in *local_sa);
+static void mux_tunnel_start(tcp_worker *w, mux_tunnel *t);
+static int uring_start(tcp_worker *w, tcp_endpoint *ep);
 
-    long long ky_server_side = 0ll;
-    long long ky_local_side = 0ll;
+/*
+ * Stops forwarding between a pair of communicating sockets.
+ */
+static void end_pair(tcp_worker *w, tcp_endpoint *ep)
+{
+  int src_fd = ep->fd;
+  int trg_fd = ep->peer->fd;
 
-    if(on_remote_server){
-      fill_rand((unsigned char*)& ky_server_side, 8);
-      int wdd = write(csd, &ky_server_side, 8);
-      assert(wdd=8);
-      int rdd = read(csd, &ky_local_side, 8);
-      assert(rdd==8);
-    }else{
-      fill_rand((unsigned char*)&ky_local_side, 8);
-      int wdd = write(rsd, &ky_local_side, 8);
-      assert(wdd=8);
-      int rdd = read(rsd,  &ky_server_side, 8);
-      assert(rdd==8);
-    }
+  DEBUGFD(syslog(LOG_DEBUG, "client_socket: closed socket (FD %d or %d)", src_fd, trg_fd));
 
-    int xx;
-    session_csd -> session_key = 0;
-    session_rsd -> session_key = 0;
-    for(xx = 91; xx < 99; xx++){
-      session_csd -> session_key |=  (0xff & pseudo_rand_key_offset(confusing_key, xx, ky_local_side));
-      session_rsd -> session_key |=  (0xff & pseudo_rand_key_offset(confusing_key, xx, ky_server_side));
+  w->idling.remove(&ep->conn->idle);
+  w->aging.remove(&ep->conn->life);
+  w->starving.remove(&ep->starve);
+  w->starving.remove(&ep->peer->starve);
+  close_pair(&w->loop, ep, &w->dead);
+}
 
-      session_csd -> session_key = session_csd -> session_key << 8;
-      session_rsd -> session_key = session_rsd -> session_key << 8;
-    }
-  
-    return 0;
-  }
+/*
+ * Arms the idle-timeout and session-timeout of a session starting to
+ * carry data, in "idling" and "aging".
+ */
+static void timeouts_start(tcp_worker *w, timer_list *idling, timer *idle, timer_list *aging, timer *life)
+{
+  const map_opts *opts = w->svc->opts;
 
-  static void handle_first() {
-    Try_connect_delayer *s = Try_connect_delayers;
-    Try_connect_delayers = Try_connect_delayers->next;
-    if (Try_connect_delayers == NULL)
-      tail = NULL;
-    if (s->pipe()) {
-      s->queue();
-    } else {
-      delete s;
-    }
-  }
+  if (opts->idle_timeout)
+    idling->insert(idle, w->now + opts->idle_timeout * 1000LL);
+  if (opts->session_timeout)
+    aging->insert(life, w->now + opts->session_timeout * 1000LL);
+}
 
-  static int ready() {
-    return Try_connect_delayers != NULL && Try_connect_delayers->timeout <= time(NULL);
-  }
+/*
+ * Any event for a session is activity: its idle timer moves to the
+ * tail of "idling", which takes the round's clock, so this is O(1).
+ */
+static void timeouts_touch(tcp_worker *w, timer_list *idling, timer *idle)
+{
+  if (timer_list::linked(idle) && idle->deadline != w->now + w->svc->opts->idle_timeout * 1000LL)
+    idling->insert(idle, w->now + w->svc->opts->idle_timeout * 1000LL);
+}
 
-  static int queued() {
-    return Try_connect_delayers != NULL;
-  }
+/*
+ * Plain maps move data with splice(), unless io_uring does.
+ */
+static int splicing(const tcp_worker *w)
+{
+  return w->svc->splice && !w->loop.completions();
+}
+
+/*
+ * Ends a draining pair once its output is flushed; otherwise updates
+ * the conditions both sockets are watched for.
+ */
+static void settle_pair(tcp_worker *w, tcp_endpoint *ep)
+{
+  tcp_endpoint *peer = ep->peer;
 
-  static time_t earliest() {
-    return Try_connect_delayers->timeout;
+  if (ep->draining && !out_pending(ep) && !out_pending(peer)) {
+    end_pair(w, ep);
+    return;
   }
 
-};
+  if (watch_events(&w->loop, ep) || watch_events(&w->loop, peer))
+    end_pair(w, ep);
+}
 
+/*
+ * Closes the pairs idle or open for too long at "now".
+ */
+static void pair_expire(tcp_worker *w, long long now)
+{
+  timer *tm;
+  while ((tm = w->idling.expired(now))) {
+    tcp_conn *conn = (tcp_conn *) tm->owner;
+    ONVERBOSE(syslog(LOG_DEBUG, "TCP pipe: FD %d idle for %d seconds: closing", conn->ep[0].fd, w->svc->opts->idle_timeout));
+    end_pair(w, conn->ep);
+  }
 
-Try_connect_delayer *Try_connect_delayer::Try_connect_delayers = NULL;
-Try_connect_delayer *Try_connect_delayer::tail = NULL;
+  while ((tm = w->aging.expired(now))) {
+    tcp_conn *conn = (tcp_conn *) tm->owner;
+    ONVERBOSE(syslog(LOG_DEBUG, "TCP pipe: FD %d open for %d seconds: closing", conn->ep[0].fd, w->svc->opts->session_timeout));
+    end_pair(w, conn->ep);
+  }
+}
 
+/*
+ * Seconds a fragile map waits before trying all destinations again.
+ */
+const int RETRY_DELAY = 10;
 
-void mother_socket(int sd, fd_set *fds, int dest_fd[], int *maxfd, vector<host_map*> *map_list, const struct ip_addr *src, int fragile, int is_remote_server, long long confusing_key)
-{
+/*
+ * A client whose session is not established yet.
+ *
+ * Connections are non-blocking and driven by the event loop: the
+ * destinations of the host_map are tried in turn, each for at most
+ * connect-timeout seconds and passing over those that are down (see
+ * host_map::track_health()), and a fragile map starts over after
+ * RETRY_DELAY seconds when none of them answers (CONNECTING). Session
+ * keys are then exchanged within handshake-timeout seconds
+ * (AWAIT_KEY); with pipeline-keys, the remote server sends its own
+ * key before connecting (see send_key_early()). Whatever the client
+ * sends meanwhile is kept in "early" and forwarded once the session
+ * is ESTABLISHED.
+ *
+ * A delayer without a client warms a connection for a warm_pool: once
+ * keyed it stays IDLE until new_client() hands it a client, or becomes
+ * a mux_tunnel. So does the client of a mux map on the remote server.
+ */
+class Try_connect_delayer {
+private:
+  enum { CONNECTING, AWAIT_KEY, IDLE } state;
+  tcp_worker *w;
+  host_map *hm;
   struct sockaddr_in cli_sa;
-  socklen_t cli_sa_len = sizeof(cli_sa);
+  struct ip_addr ip;
+  int cli_port;
+  struct sockaddr_in local_cli_sa;
+  tcp_endpoint *ep;      /* ep[0]: client; ep[1]: upstream */
+  int first_dst;
+  int attempt;
+  int skip_down;         /* pass over destinations that are down */
+  long long connect_start;  /* now_us() clock */
+  timer tm;              /* in w->connecting, w->retrying or w->handshaking */
+  long long own_key;
+  int key_made;          /* own_key made, and key_sent of it sent */
+  long long peer_key;
+  int key_sent;
+  int key_got;
+  char *early;
+  int early_len;
+  int early_eof;
+  int watch_client;
+  int watch_upstream;    /* IDLE: upstream still watched */
+  warm_pool *pool;       /* warming or IDLE for it; NULL once with a client */
+  int for_tunnel;        /* warming a tunnel for it */
+  Try_connect_delayer *next_idle;
+  long long parked_at;   /* now_ms() clock */
 
   /*
-   * Accept new client on "csd"
+   * On the remote server the client socket carries the session
+   * key exchange, which must be left in the socket for handshake().
    */
-  int csd = accept(sd, (struct sockaddr *) &cli_sa, &cli_sa_len);
-  if (csd < 0) {
-    syslog(LOG_ERR, "Can't accept TCP socket: %m");
-    return;
+  unsigned int client_mask() const {
+    return w->svc->is_remote && !w->svc->opts->plain ? 0 : (int) EV_READ;
   }
-	
-  int cli_port = ntohs(cli_sa.sin_port);
 
-  /*
-   * Get local address
-   */
-  struct sockaddr_in local_cli_sa;
-  socklen_t local_cli_sa_len = sizeof(local_cli_sa);
-  if (getsockname(sd, (struct sockaddr *) &local_cli_sa, &local_cli_sa_len)) {
-    syslog(LOG_ERR, "mother_socket(): Can't get local sockname: %m");
-    socket_close(csd);
-    return;
+  int watch_client_for(unsigned int mask) {
+    if (watch_client ? w->loop.modify(ep[0].fd, mask, &ep[0]) : w->loop.add(ep[0].fd, mask, &ep[0]))
+      return -1;
+    watch_client = 1;
+    return 0;
+  }
+
+  void unwatch_client() {
+    if (watch_client) {
+      w->loop.remove(ep[0].fd);
+      watch_client = 0;
+    }
   }
 
-  ONVERBOSE(syslog(LOG_DEBUG, "TCP connection from %s:%d", inet_ntoa(cli_sa.sin_addr), cli_port));
-  
   /*
-   * Check client address (ip, port).
+   * Starts a round over the destinations, healthy ones only unless
+   * all are down.
    */
-  struct ip_addr ip;
-  ip.addr = (char *) &(cli_sa.sin_addr.s_addr);
-  ip.len  = addr_len;
+  int connect_first() {
+    long long now = now_ms();
+    first_dst = hm->first_dst(now);
+    attempt = 0;
+    skip_down = !hm->all_down(now);
+    return connect_next();
+  }
 
-  host_map *hm = tcp_match(map_list, &ip, cli_port);
-  if (!hm) {
-    ONVERBOSE(syslog(LOG_DEBUG, "Address miss"));
-    socket_close(csd);
-    return;
+  int connect_next() {
+    const tcp_service *svc = w->svc;
+    long long now = now_ms();
+
+    for (; attempt < hm->dst_count(); ++attempt) {
+      if (skip_down && !hm->dst_up(first_dst + attempt, now))
+	continue;
+
+      int rsd;
+      if (hm->connect_dst(&rsd, first_dst + attempt, &cli_sa, sizeof(cli_sa), &ip, cli_port, svc->source, &local_cli_sa, svc->opts, fast_open())) {
+	hm->dst_failed(first_dst + attempt);
+	continue;
+      }
+
+      if (w->loop.add(rsd, EV_WRITE, &ep[1])) {
+	socket_close(rsd);
+	continue;
+      }
+
+      ep[1].fd = rsd;
+      ep->conn->dst = hm->dst_at(first_dst + attempt);
+      ep->conn->dst->opened();
+      connect_start = now_us();
+      w->connecting.insert(&tm, now_ms() + svc->opts->connect_timeout * 1000LL);
+      return 0;
+    }
+
+    return -1;
   }
-  ONVERBOSE(syslog(LOG_DEBUG, "Address match"));
 
   /*
-   * Connect to destination on "rsd"
+   * The current destination failed: go on with the next one.
    */
-  Try_connect_delayer *s = new Try_connect_delayer(hm, &cli_sa, &ip, cli_port, src, &local_cli_sa,
-                           csd, fds, dest_fd, maxfd, is_remote_server, confusing_key );
-  if (s->pipe()) {
-    if (fragile)
-      s->queue();
-    else {
-      ONVERBOSE(syslog(LOG_DEBUG, "Could not connect to remote destination"));
-      socket_close(csd);
-      delete s;
+  void failed() {
+    hm->dst_failed(first_dst + attempt);
+    w->connecting.remove(&tm);
+    if (ep[1].fd != -1) {
+      w->loop.remove(ep[1].fd);
+      socket_close(ep[1].fd);
+      ep[1].fd = -1;
     }
+    if (ep->conn->dst) {
+      ep->conn->dst->closed();
+      ep->conn->dst = 0;
+    }
+
+    ++attempt;
+    if (connect_next())
+      give_up();
   }
+
+  void give_up() {
+    if (pool) {
+      ONVERBOSE(syslog(LOG_WARNING, "Warm pool: Can't connect to any destination"));
+      drop();
+      return;
+    }
+
+    syslog(LOG_ERR, "TCP pipe: Can't forward incoming connection from %s:%d to any destination", addrtostr(&ip), cli_port);
+
+    if (!w->svc->fragile) {
+      ONVERBOSE(syslog(LOG_DEBUG, "Could not connect to remote destination"));
+      drop();
+      return;
+    }
+
+    unwatch_client();
+    w->retrying.insert(&tm, now_ms() + RETRY_DELAY * 1000LL);
+  }
+
+  void drop() {
+    if (pool)
+      leave_pool();
+    w->connecting.remove(&tm);
+    w->retrying.remove(&tm);
+    w->handshaking.remove(&tm);
+    unwatch_client();
+    if (ep[0].fd != -1) {
+      socket_close(ep[0].fd);
+      ep[0].fd = -1;
+    }
+    close_pair(&w->loop, ep, &w->dead);
+    release();
+  }
+
+  /*
+   * Whether the session key exchange runs with the destination, which
+   * is only known to work once it is over.
+   */
+  int handshakes_with_dst() const {
+    return !w->svc->is_remote && !w->svc->opts->plain;
+  }
+
+  /*
+   * Whether the upstream socket may use TCP Fast Open: only where we
+   * send the session key first and wait for the peer's, which is
+   * what tells a destination that took the connection from one that
+   * never saw it.
+   */
+  int fast_open() const {
+    return w->svc->opts->fast_open && handshakes_with_dst();
+  }
+
+  /*
+   * The destination is known to work: it is up, and took this long.
+   */
+  void dst_answered() {
+    hm->dst_ok(first_dst + attempt);
+    ep->conn->dst->add_latency_us(now_us() - connect_start);
+  }
+
+  /*
+   * The key exchange broke down.
+   */
+  void handshake_failed() {
+    if (handshakes_with_dst())
+      hm->dst_failed(first_dst + attempt);
+    drop();
+  }
+
+  void release() {
+    ep[0].delayer = 0;
+    ep[1].delayer = 0;
+    delete this;
+  }
+
+  /*
+   * Reads what the client sends before the upstream connection is up.
+   */
+  void client_readable() {
+    if (!early)
+      early = (char *) malloc(BUF_SZ);
+    if (!early) {
+      syslog(LOG_ERR, "Can't allocate early data buffer");
+      drop();
+      return;
+    }
+
+    int rd = read(ep[0].fd, early + early_len, BUF_SZ - early_len);
+    if (rd < 0) {
+      if (errno == EAGAIN || errno == EINTR)
+	return;
+      syslog(LOG_ERR, "copy: Failure reading from socket: %m");
+      drop();
+      return;
+    }
+
+    if (!rd)
+      early_eof = 1;
+    early_len += rd;
+
+    /*
+     * Leave the rest in the socket until connected.
+     */
+    if (early_eof || early_len == BUF_SZ)
+      unwatch_client();
+  }
+
+  void upstream_ready() {
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    if (getsockopt(ep[1].fd, SOL_SOCKET, SO_ERROR, &err, &err_len))
+      err = errno;
+    if (err) {
+      ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: Can't connect %s:%d to destination %d: %s", addrtostr(&ip), cli_port, (first_dst + attempt) % hm->dst_count(), strerror(err)));
+      failed();
+      return;
+    }
+
+    connected();
+  }
+
+  void connected() {
+    w->connecting.remove(&tm);
+    ONVERBOSE2(syslog(LOG_DEBUG, "TCP pipe: connected: %s:%d => destination %d", addrtostr(&ip), cli_port, (first_dst + attempt) % hm->dst_count()));
+    hm->dst_connected(first_dst + attempt);
+    if (!handshakes_with_dst())
+      dst_answered();
+
+    exchange_keys();
+  }
+
+  void exchange_keys() {
+    /*
+     * Plain maps have no session keys.
+     */
+    if (w->svc->opts->plain)
+      keyed();
+    else
+      handshake();
+  }
+
+  /*
+   * Makes our session key.
+   *
+   * Returns -1 on failure, the delayer being dropped; 0 on success.
+   */
+  int make_own_key() {
+    const tcp_service *svc = w->svc;
+
+    unsigned int nonce;
+    if (fill_rand((unsigned char *) &nonce, sizeof(nonce))) {
+      drop();
+      return -1;
+    }
+    own_key = ks2_own_key(svc->XOR_key, svc->conf_key, nonce);
+    key_made = 1;
+    return 0;
+  }
+
+  /*
+   * Pipelined session keys, on the remote server: sends our key to
+   * the client before connecting to the destination, so that it
+   * crosses the local side's key meanwhile. Both keys still key the
+   * session, as in any exchange: the local side needs nothing of its
+   * own, and either end may pipeline or not. handshake() writes what
+   * did not fit.
+   *
+   * Returns -1 on failure, the delayer being dropped; 0 on success.
+   */
+  int send_key_early() {
+    if (make_own_key())
+      return -1;
+
+    int wr = write(ep[0].fd, (char *) &own_key, 8);
+    if (wr < 0 && errno != EAGAIN && errno != EINTR) {
+      syslog(LOG_ERR, "TCP pipe: Can't send session key to %s:%d: %m", addrtostr(&ip), cli_port);
+      drop();
+      return -1;
+    }
+    if (wr > 0)
+      key_sent = wr;
+    return 0;
+  }
+
+  /*
+   * Enters AWAIT_KEY: both ends send their 8-byte session key at once,
+   * then wait for the other's. On the remote server the key exchange
+   * goes through the client socket; the upstream socket is meanwhile
+   * watched for errors only, and whatever it sends stays queued.
+   */
+  void handshake() {
+    const tcp_service *svc = w->svc;
+    int rsd = ep[1].fd;
+
+    state = AWAIT_KEY;
+    if (!key_made && make_own_key())
+      return;
+    key_got = 0;
+
+    /*
+     * Once our key is out, only the peer's is waited for.
+     */
+    unsigned int mask = key_sent < 8 ? EV_READ | EV_WRITE : EV_READ;
+
+    if (svc->is_remote) {
+      if ((rsd != -1 && w->loop.modify(rsd, 0, &ep[1])) || watch_client_for(mask)) {
+	drop();
+	return;
+      }
+    }
+    else if (w->loop.modify(rsd, EV_READ | EV_WRITE, &ep[1])) {
+      drop();
+      return;
+    }
+
+    w->handshaking.insert(&tm, now_ms() + svc->opts->handshake_timeout * 1000LL);
+  }
+
+  /*
+   * Moves the key exchange on. Reads no more than the peer's key:
+   * what follows belongs to the session.
+   */
+  void key_ready(tcp_endpoint *e) {
+    int fd = e->fd;
+
+    if (key_sent < 8) {
+      int wr = write(fd, (char *) &own_key + key_sent, 8 - key_sent);
+      if (wr < 0 && errno != EAGAIN && errno != EINTR && errno != EINPROGRESS) {
+	syslog(LOG_ERR, "TCP pipe: Can't send session key to %s:%d: %m", addrtostr(&ip), cli_port);
+	handshake_failed();
+	return;
+      }
+      if (wr > 0)
+	key_sent += wr;
+      if (key_sent == 8 && w->loop.modify(fd, EV_READ, e)) {
+	drop();
+	return;
+      }
+    }
+
+    if (key_got < 8) {
+      int rd = read(fd, (char *) &peer_key + key_got, 8 - key_got);
+      if (rd < 0) {
+	if (errno == EAGAIN || errno == EINTR)
+	  return;
+	syslog(LOG_ERR, "TCP pipe: Can't receive session key from %s:%d: %m", addrtostr(&ip), cli_port);
+	handshake_failed();
+	return;
+      }
+      if (!rd) {
+	ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: Connection closed during key exchange: %s:%d", addrtostr(&ip), cli_port));
+	handshake_failed();
+	return;
+      }
+      key_got += rd;
+    }
+
+    if (key_sent == 8 && key_got == 8)
+      keyed();
+  }
+
+  /*
+   * The upstream connection is ready for a client.
+   */
+  void keyed() {
+    w->handshaking.remove(&tm);
+    if (handshakes_with_dst())
+      dst_answered();
+
+    if (for_tunnel || (w->svc->is_remote && w->svc->opts->mux))
+      become_tunnel();
+    else if (ep[0].fd == -1)
+      park();
+    else
+      established();
+  }
+
+  /*
+   * Hands the connection over to a mux_tunnel: upstream on the local
+   * side, the client on the remote side.
+   */
+  void become_tunnel() {
+    const tcp_service *svc = w->svc;
+
+    if (!svc->opts->plain)
+      session_keys();
+
+    mux_tunnel *t = mux_tunnel_new(&ep[svc->is_remote ? 0 : 1], hm, pool, &cli_sa, cli_port, &local_cli_sa);
+    if (!t) {
+      drop();
+      return;
+    }
+    if (pool) {
+      --pool->mux_warming;
+      pool = 0;
+    }
+
+    tcp_worker *worker = w;
+    release();
+    mux_tunnel_start(worker, t);
+  }
+
+  /*
+   * IDLE: waits in the pool for new_client(). The upstream socket is
+   * watched for hangups; whatever it sends meanwhile stays queued.
+   */
+  void park() {
+    if (w->loop.modify(ep[1].fd, EV_READ | EV_HANGUP, &ep[1])) {
+      drop();
+      return;
+    }
+    watch_upstream = 1;
+
+    --pool->warming;
+    state = IDLE;
+    next_idle = pool->idle;
+    pool->idle = this;
+    ++pool->idle_count;
+    parked_at = now_ms();
+  }
+
+  void idle_event(unsigned int ready) {
+    char c;
+    int rd = ready & ~EV_READ ? 0 : recv(ep[1].fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (rd < 0 && (errno == EAGAIN || errno == EINTR))
+      return;
+    if (rd <= 0) {
+      ONVERBOSE2(syslog(LOG_DEBUG, "Warm pool: idle connection closed"));
+      drop();
+      return;
+    }
+
+    /*
+     * Data before any client: the destination talks first. Keep it
+     * for the client, still watching for the destination hanging up,
+     * which would leave the client with a dead connection.
+     */
+    if (w->loop.modify(ep[1].fd, EV_HANGUP, &ep[1]))
+      drop();
+  }
+
+  /*
+   * Accounts for a warming or IDLE connection going away. The pool is
+   * refilled at once, unless connections keep failing or closing
+   * early.
+   */
+  void leave_pool() {
+    warm_pool *p = pool;
+    pool = 0;
+
+    int backoff;
+    if (state == IDLE) {
+      Try_connect_delayer **d = &p->idle;
+      while (*d != this)
+	d = &(*d)->next_idle;
+      *d = next_idle;
+      --p->idle_count;
+      backoff = now_ms() - parked_at < RETRY_DELAY * 1000LL;
+    }
+    else {
+      if (for_tunnel)
+	--p->mux_warming;
+      else
+	--p->warming;
+      backoff = 1;
+    }
+
+    if (backoff)
+      w->refilling.insert(&p->refill, now_ms() + RETRY_DELAY * 1000LL);
+    else
+      warm_fill(w, p);
+  }
+
+  /*
+   * ESTABLISHED: hands the pair over to client_socket().
+   */
+  void established() {
+    const tcp_service *svc = w->svc;
+    int rsd = ep[1].fd;
+
+    if (!svc->opts->plain)
+      session_keys();
+
+    if (splicing(w) && (open_pipe(&ep[0]) || open_pipe(&ep[1]))) {
+      drop();
+      return;
+    }
+
+    /*
+     * Watch pair of communicating sockets.
+     */
+    if (watch_upstream ? w->loop.modify(rsd, EV_READ, &ep[1]) : w->loop.add(rsd, EV_READ, &ep[1])) {
+      drop();
+      return;
+    }
+    ep[1].events = EV_READ;
+    if (watch_client_for(EV_READ)) {
+      drop();
+      return;
+    }
+    ep[0].events = EV_READ;
+
+    /*
+     * Forward what the client sent meanwhile.
+     */
+    tcp_endpoint *pair = ep;
+    int fail = early_len && buf_forward(&ep[0], early, early_len, svc);
+    if (early_eof) {
+      ep[0].draining = 1;
+      ep[1].draining = 1;
+    }
+    tcp_worker *worker = w;
+    release();
+
+    if (fail) {
+      end_pair(worker, pair);
+      return;
+    }
+
+    timeouts_start(worker, &worker->idling, &pair->conn->idle, &worker->aging, &pair->conn->life);
+    if (uring_start(worker, pair)) {
+      end_pair(worker, pair);
+      return;
+    }
+    settle_pair(worker, pair);
+  }
+
+  /*
+   * Session keys.
+   */
+  void session_keys() {
+    int on_remote_server = w->svc->is_remote;
+    long long confusing_key = w->svc->conf_key;
+
+    clientSock_session_t*session_csd = &ep->conn->session[0];
+    session_csd -> inflate_when_copying = !on_remote_server;
+    clientSock_session_t*session_rsd = &ep->conn->session[1];
+    session_rsd -> inflate_when_copying = on_remote_server;
+
+    ep[0].session = session_csd;
+    ep[1].session = session_rsd;
+
+    long long ky_server_side = on_remote_server ? own_key : peer_key;
+    long long ky_local_side = on_remote_server ? peer_key : own_key;
+
+    /*
+     * Version 2 when the peer tagged its key as we did ours.
+     */
+    if (ks2_tagged(peer_key, w->svc->XOR_key, confusing_key)) {
+      session_csd -> version = 2;
+      session_rsd -> version = 2;
+      ks2_setup(&session_csd -> ks2, w->svc->XOR_key, confusing_key, ky_local_side, ky_server_side);
+      ks2_setup(&session_rsd -> ks2, w->svc->XOR_key, confusing_key, ky_server_side, ky_local_side);
+      ONVERBOSE2(syslog(LOG_DEBUG, "TCP pipe: %s:%d: wire protocol 2", addrtostr(&ip), cli_port));
+      return;
+    }
+    session_csd -> version = 1;
+    session_rsd -> version = 1;
+
+    int xx;
+    session_csd -> session_key = 0;
+    session_rsd -> session_key = 0;
+    for(xx = 91; xx < 99; xx++){
+      session_csd -> session_key |=  (0xff & pseudo_rand_key_offset(confusing_key, xx, ky_local_side));
+      session_rsd -> session_key |=  (0xff & pseudo_rand_key_offset(confusing_key, xx, ky_server_side));
+
+      session_csd -> session_key = session_csd -> session_key << 8;
+      session_rsd -> session_key = session_rsd -> session_key << 8;
+    }
+  }
+
+public:
+  Try_connect_delayer(tcp_worker *w, host_map *hm, const struct sockaddr_in *cli_sa,
+          int cli_port, const struct sockaddr_in *local_cli_sa, tcp_endpoint *ep) {
+    this->state = CONNECTING;
+    this->w = w;
+    this->hm = hm;
+    this->cli_sa = *cli_sa;
+    this->ip.addr = (char *) &(this->cli_sa.sin_addr.s_addr);
+    this->ip.len = addr_len;
+    this->cli_port = cli_port;
+    this->local_cli_sa = *local_cli_sa;
+    this->ep = ep;
+    this->ep[0].delayer = this;
+    this->ep[1].delayer = this;
+    this->first_dst = 0;
+    this->attempt = 0;
+    this->skip_down = 0;
+    this->connect_start = 0;
+    timer_list::init(&this->tm, this);
+    this->own_key = 0;
+    this->key_made = 0;
+    this->peer_key = 0;
+    this->key_sent = 0;
+    this->key_got = 0;
+    this->early = NULL;
+    this->early_len = 0;
+    this->early_eof = 0;
+    this->watch_client = 0;
+    this->watch_upstream = 1;
+    this->pool = 0;
+    this->for_tunnel = 0;
+    this->next_idle = 0;
+    this->parked_at = 0;
+  }
+
+  ~Try_connect_delayer() {
+    free(early);
+  }
+
+  void start() {
+    if (ep[0].fd != -1 && !w->loop.add(ep[0].fd, client_mask(), &ep[0]))
+      watch_client = 1;
+
+    /*
+     * Remote end of a tunnel: streams connect once opened.
+     */
+    if (w->svc->is_remote && w->svc->opts->mux) {
+      exchange_keys();
+      return;
+    }
+
+    if (w->svc->is_remote && w->svc->opts->pipeline_keys && !w->svc->opts->plain && send_key_early())
+      return;
+
+    if (connect_first())
+      give_up();
+  }
+
+  /*
+   * Starts warming a connection for "pool", or a tunnel.
+   *
+   * Returns -1 on failure; 0 on success.
+   */
+  static int warm(tcp_worker *w, warm_pool *pool, int for_tunnel) {
+    tcp_endpoint *ep = new_pair(-1, -1);
+    if (!ep)
+      return -1;
+
+    struct sockaddr_in none;
+    memset(&none, 0, sizeof(none));
+    Try_connect_delayer *d = new Try_connect_delayer(w, pool->hm, &none, 0, &none, ep);
+    d->pool = pool;
+    d->for_tunnel = for_tunnel;
+    if (for_tunnel)
+      ++pool->mux_warming;
+    else
+      ++pool->warming;
+    d->start();
+    return 0;
+  }
+
+  /*
+   * Takes an IDLE connection of "pool" for a client.
+   *
+   * Returns NULL if none is left; the delayer, out of the pool, on
+   * success.
+   */
+  static Try_connect_delayer *take(warm_pool *pool) {
+    Try_connect_delayer *d = pool->idle;
+    if (!d)
+      return 0;
+
+    pool->idle = d->next_idle;
+    --pool->idle_count;
+    d->pool = 0;
+    return d;
+  }
+
+  /*
+   * Gives client "csd" the upstream connection, ending in ESTABLISHED.
+   */
+  void attach(int csd, const struct sockaddr_in *cli_sa, int cli_port, const struct sockaddr_in *local_cli_sa) {
+    this->cli_sa = *cli_sa;
+    this->cli_port = cli_port;
+    this->local_cli_sa = *local_cli_sa;
+    ep[0].fd = csd;
+    if (w->svc->limit) {
+      ep->conn->limit = w->svc->limit;
+      ep->conn->src = cli_sa->sin_addr.s_addr;
+    }
+    state = AWAIT_KEY;
+    ONVERBOSE2(syslog(LOG_DEBUG, "TCP pipe: %s:%d: warm connection to destination %d", addrtostr(&ip), cli_port, (first_dst + attempt) % hm->dst_count()));
+    established();
+  }
+
+  void event(tcp_endpoint *e, unsigned int ready) {
+    int is_remote = w->svc->is_remote;
+
+    if (state == IDLE) {
+      idle_event(ready);
+      return;
+    }
+
+    if (state == AWAIT_KEY) {
+      if (e == &ep[is_remote ? 0 : 1])
+	key_ready(e);
+      else if (!is_remote)
+	client_readable();
+      else
+	drop(); /* upstream error or hangup */
+      return;
+    }
+
+    if (e == &ep[1])
+      upstream_ready();
+    else if (client_mask())
+      client_readable();
+    else
+      drop(); /* client error or hangup */
+  }
+
+  void timed_out() {
+    ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: Timeout connecting %s:%d to destination %d", addrtostr(&ip), cli_port, (first_dst + attempt) % hm->dst_count()));
+    failed();
+  }
+
+  void handshake_timed_out() {
+    ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: Timeout exchanging session keys for %s:%d", addrtostr(&ip), cli_port));
+    handshake_failed();
+  }
+
+  void retry() {
+    if (!early_eof && !watch_client && early_len < BUF_SZ && !w->loop.add(ep[0].fd, client_mask(), &ep[0]))
+      watch_client = 1;
+
+    if (connect_first())
+      give_up();
+  }
+
+  /*
+   * Runs the timers due at "now".
+   */
+  static void expire(tcp_worker *w, long long now) {
+    timer *t;
+    while ((t = w->connecting.expired(now)))
+      ((Try_connect_delayer *) t->owner)->timed_out();
+    while ((t = w->retrying.expired(now)))
+      ((Try_connect_delayer *) t->owner)->retry();
+    while ((t = w->handshaking.expired(now)))
+      ((Try_connect_delayer *) t->owner)->handshake_timed_out();
+    while ((t = w->refilling.expired(now)))
+      warm_fill(w, (warm_pool *) t->owner);
+  }
+
+};
+
+
+/*
+ * Tops up the tunnels and warm connections of a pool, unless it is
+ * backing off.
+ */
+static void warm_fill(tcp_worker *w, warm_pool *pool)
+{
+  while (!timer_list::linked(&pool->refill) && pool->tunnel_count + pool->mux_warming < pool->mux)
+    if (Try_connect_delayer::warm(w, pool, 1)) {
+      w->refilling.insert(&pool->refill, now_ms() + RETRY_DELAY * 1000LL);
+      return;
+    }
+
+  while (!timer_list::linked(&pool->refill) && pool->idle_count + pool->warming < pool->target)
+    if (Try_connect_delayer::warm(w, pool, 0)) {
+      w->refilling.insert(&pool->refill, now_ms() + RETRY_DELAY * 1000LL);
+      break;
+    }
+}
+
+/*
+ * Sets up the warm pools of a worker, its share of warm-pool or mux
+ * for each host_map. Maps whose destinations depend on the client,
+ * and transparent proxying, need a client before connecting: they
+ * have none.
+ */
+static void warm_start(tcp_worker *w)
+{
+  const tcp_service *svc = w->svc;
+  int share = svc->opts->warm_pool / svc->workers + (w->id < svc->opts->warm_pool % svc->workers);
+  int mux = svc->opts->mux / svc->workers + (w->id < svc->opts->mux % svc->workers);
+
+  /*
+   * Each worker carries its clients over tunnels of its own. The
+   * remote end of a tunnel takes nothing else: no warm connections.
+   */
+  if (svc->opts->mux) {
+    mux = MAX(mux, 1);
+    share = 0;
+  }
+
+  w->pools = 0;
+  w->pool_count = 0;
+  if ((!share && !mux) || svc->is_remote)
+    return;
+#ifdef HAVE_MSG_PROXY
+  if (transparent_proxy)
+    return;
+#endif
+
+  w->pools = new warm_pool[svc->map_list->get_size()];
+
+  iterator<vector<host_map*>,host_map*> it(*svc->map_list);
+  for (it.start(); it.cont(); it.next()) {
+    host_map *hm = it.get();
+    if (hm->client_dependent()) {
+      if (mux && !w->id)
+	syslog(LOG_WARNING, "Multiplexed map: destinations depending on the client are connected one by one");
+      continue;
+    }
+
+    warm_pool *pool = &w->pools[w->pool_count++];
+    pool->hm           = hm;
+    pool->target       = share;
+    pool->idle         = 0;
+    pool->idle_count   = 0;
+    pool->warming      = 0;
+    pool->mux          = mux;
+    pool->mux_warming  = 0;
+    pool->tunnels      = 0;
+    pool->tunnel_count = 0;
+    pool->waiting      = 0;
+    timer_list::init(&pool->refill, pool);
+  }
+
+  for (int i = 0; i < w->pool_count; ++i)
+    warm_fill(w, &w->pools[i]);
+}
+
+/*
+ * Returns NULL if "hm" has no warm pool; the pool on success.
+ */
+static warm_pool *warm_find(tcp_worker *w, host_map *hm)
+{
+  for (int i = 0; i < w->pool_count; ++i)
+    if (w->pools[i].hm == hm)
+      return &w->pools[i];
+
+  return 0;
+}
+
+/*
+ * Returns NULL if "pool" has no warm connection left; the delayer
+ * holding one on success.
+ */
+static Try_connect_delayer *warm_take(tcp_worker *w, warm_pool *pool)
+{
+  Try_connect_delayer *d = Try_connect_delayer::take(pool);
+  warm_fill(w, pool);
+  return d;
+}
+
+/*
+ * Multiplexed tunnels (mux): a few long-lived connections between the
+ * local and the remote server, each carrying many clients as streams
+ * of frames (see mux.h). The local side connects and keys them like
+ * warm connections; on the remote side, every client of a mux map is
+ * a tunnel.
+ *
+ * Each stream may send MUX_WINDOW_SZ bytes ahead of its receiver,
+ * which hands them back with MUX_WINDOW frames as it writes them out:
+ * a slow client never holds up the others on its tunnel.
+ */
+const int MUX_BUCKETS = 16;
+
+static mux_stream **mux_bucket(mux_tunnel *t, unsigned int id)
+{
+  return &t->buckets[id & (t->bucket_count - 1)];
+}
+
+static mux_stream *mux_find(mux_tunnel *t, unsigned int id)
+{
+  for (mux_stream *s = *mux_bucket(t, id); s; s = s->next)
+    if (s->id == id)
+      return s;
+  return 0;
+}
+
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+static int mux_hash(mux_tunnel *t, mux_stream *s)
+{
+  if (t->streams >= t->bucket_count) {
+    int count = t->bucket_count * 2;
+    mux_stream **buckets = (mux_stream **) calloc(count, sizeof(*buckets));
+    if (!buckets) {
+      syslog(LOG_ERR, "Multiplexed tunnel: Can't allocate %d buckets", count);
+      return -1;
+    }
+    for (int i = 0; i < t->bucket_count; ++i)
+      while (t->buckets[i]) {
+	mux_stream *m = t->buckets[i];
+	t->buckets[i] = m->next;
+	m->next = buckets[m->id & (count - 1)];
+	buckets[m->id & (count - 1)] = m;
+      }
+    free(t->buckets);
+    t->buckets      = buckets;
+    t->bucket_count = count;
+  }
+
+  mux_stream **b = mux_bucket(t, s->id);
+  s->next = *b;
+  *b = s;
+  ++t->streams;
+  return 0;
+}
+
+static void mux_unhash(mux_tunnel *t, mux_stream *s)
+{
+  mux_stream **b = mux_bucket(t, s->id);
+  while (*b != s)
+    b = &(*b)->next;
+  *b = s->next;
+  --t->streams;
+}
+
+/*
+ * Sends a frame through the session transform of the tunnel. Failures
+ * mark it broken, for mux_check() to close it.
+ */
+static void mux_send(tcp_worker *w, mux_tunnel *t, char *frame, int len)
+{
+  const tcp_service *svc = w->svc;
+  tcp_endpoint *tep = t->ep;
+
+  if (t->broken)
+    return;
+
+  char *out = frame;
+  if (!svc->opts->plain)
+    apply_XOR_buf(svc->XOR_key, svc->conf_key, frame, &out, &len, tep->peer->session);
+  if (out_write(tep, out, len)) {
+    t->broken = 1;
+    return;
+  }
+
+  if (out_pending(tep) && watch_events(&w->loop, tep)) {
+    t->broken = 1;
+    return;
+  }
+
+  if (out_pending(tep) > OUT_HIGH_WATER)
+    t->congested = 1;
+}
+
+/*
+ * Sends a frame other than MUX_DATA, with a "len"-byte payload holding
+ * "value".
+ */
+static void mux_send_small(tcp_worker *w, mux_tunnel *t, unsigned int id, int type, unsigned int value, int len)
+{
+  char frame[MUX_HEADER + MUX_SMALL];
+
+  mux_header(frame, id, type, len);
+  for (int i = 0; i < len; ++i)
+    frame[MUX_HEADER + i] = (char) (value >> (8 * (len - 1 - i)));
+  mux_send(w, t, frame, MUX_HEADER + len);
+}
+
+/*
+ * Returns NULL on failure; the stream for socket "fd" on success.
+ */
+static mux_stream *mux_stream_new(int fd)
+{
+  mux_stream *s = stream_pool.get();
+  if (!s) {
+    syslog(LOG_ERR, "Can't allocate stream");
+    return 0;
+  }
+
+  init_endpoint(&s->ep, fd, &s->ep);
+  s->ep.peer      = 0;
+  s->ep.stream    = s;
+  s->tunnel        = 0;
+  s->pool          = 0;
+  s->id            = 0;
+  s->connecting    = 0;
+  s->closing       = 0;
+  s->send_window   = MUX_WINDOW_SZ;
+  s->received      = 0;
+  s->credited      = 0;
+  s->dst           = 0;
+  s->limit         = 0;
+  s->src           = 0;
+  timer_list::init(&s->idle, s);
+  timer_list::init(&s->life, s);
+  s->first_dst     = 0;
+  s->attempt       = 0;
+  s->skip_down     = 0;
+  s->connect_start = 0;
+  timer_list::init(&s->tm, s);
+  s->next          = 0;
+  s->next_dead     = 0;
+
+  return s;
+}
+
+/*
+ * Stops watching and closes the socket of a stream, and forgets it.
+ *
+ * The stream itself is only released by mux_free_dead(), since its
+ * socket may still be pending in the current batch of events.
+ */
+static void mux_stream_free(tcp_worker *w, mux_stream *s)
+{
+  if (s->tunnel)
+    mux_unhash(s->tunnel, s);
+  else if (s->pool) {
+    mux_stream **p = &s->pool->waiting;
+    while (*p != s)
+      p = &(*p)->next;
+    *p = s->next;
+  }
+
+  w->mux_connecting.remove(&s->tm);
+  w->mux_waiting.remove(&s->tm);
+  w->mux_idling.remove(&s->idle);
+  w->mux_aging.remove(&s->life);
+
+  if (s->ep.fd != -1) {
+    if (s->tunnel)
+      w->loop.remove(s->ep.fd);
+    socket_close(s->ep.fd);
+    s->ep.fd = -1;
+  }
+
+  if (s->dst) {
+    s->dst->closed();
+    s->dst = 0;
+  }
+
+  if (s->limit) {
+    s->limit->leave(s->src);
+    s->limit = 0;
+  }
+
+  s->next_dead = w->dead_streams;
+  w->dead_streams = s;
+}
+
+/*
+ * Ends a stream at once, telling the other side unless it knows.
+ */
+static void mux_stream_abort(tcp_worker *w, mux_stream *s)
+{
+  if (!s->closing)
+    mux_send_small(w, s->tunnel, s->id, MUX_CLOSE, 0, 0);
+  mux_stream_free(w, s);
+}
+
+/*
+ * Frees a draining stream once its output is flushed; otherwise hands
+ * back the window its socket took and updates the conditions it is
+ * watched for.
+ */
+static void mux_stream_settle(tcp_worker *w, mux_stream *s)
+{
+  mux_tunnel *t = s->tunnel;
+
+  if (s->connecting)
+    return;
+
+  if (s->ep.draining && !out_pending(&s->ep)) {
+    mux_stream_free(w, s);
+    return;
+  }
+
+  if (!s->closing) {
+    long long consumed = s->received - out_pending(&s->ep);
+    if (consumed - s->credited >= MUX_WINDOW_SZ / 4) {
+      mux_send_small(w, t, s->id, MUX_WINDOW, consumed - s->credited, 4);
+      s->credited = consumed;
+    }
+  }
+
+  s->ep.throttled = s->send_window <= 0 || t->congested;
+  if (watch_events(&w->loop, &s->ep))
+    mux_stream_abort(w, s);
+}
+
+/*
+ * Lets the streams of a tunnel that is no longer congested read
+ * again.
+ */
+static void mux_rewatch(tcp_worker *w, mux_tunnel *t)
+{
+  for (int i = 0; i < t->bucket_count; ++i) {
+    mux_stream *next;
+    for (mux_stream *s = t->buckets[i]; s; s = next) {
+      next = s->next;
+      mux_stream_settle(w, s);
+    }
+  }
+}
+
+/*
+ * Stops watching and closes a tunnel with all its streams.
+ */
+static void mux_tunnel_close(tcp_worker *w, mux_tunnel *t)
+{
+  if (t->closed)
+    return;
+  t->closed = 1;
+
+  ONVERBOSE(syslog(LOG_DEBUG, "Multiplexed tunnel: FD %d closed with %d streams", t->ep->fd, t->streams));
+
+  for (int i = 0; i < t->bucket_count; ++i)
+    while (t->buckets[i])
+      mux_stream_free(w, t->buckets[i]);
+
+  close_pair(&w->loop, t->ep, &w->dead);
+
+  /*
+   * Replace it, unless tunnels keep failing or closing early.
+   */
+  warm_pool *p = t->pool;
+  if (p) {
+    mux_tunnel **pt = &p->tunnels;
+    while (*pt != t)
+      pt = &(*pt)->next;
+    *pt = t->next;
+    --p->tunnel_count;
+
+    if (now_ms() - t->started_at < RETRY_DELAY * 1000LL)
+      w->refilling.insert(&p->refill, now_ms() + RETRY_DELAY * 1000LL);
+    else
+      warm_fill(w, p);
+  }
+
+  t->next_dead = w->dead_tunnels;
+  w->dead_tunnels = t;
+}
+
+/*
+ * Closes a tunnel marked broken while handling an event.
+ */
+static void mux_check(tcp_worker *w, mux_tunnel *t)
+{
+  if (t && t->broken)
+    mux_tunnel_close(w, t);
+}
+
+static void mux_free_dead(tcp_worker *w)
+{
+  while (w->dead_streams) {
+    mux_stream *s = w->dead_streams;
+    w->dead_streams = s->next_dead;
+    free(s->ep.out);
+    stream_pool.put(s);
+  }
+
+  while (w->dead_tunnels) {
+    mux_tunnel *t = w->dead_tunnels;
+    w->dead_tunnels = t->next_dead;
+    free(t->buckets);
+    delete t;
+  }
+}
+
+/*
+ * Returns NULL on failure; the tunnel over endpoint "tep" on success.
+ */
+static mux_tunnel *mux_tunnel_new(tcp_endpoint *tep, host_map *hm, warm_pool *pool, const struct sockaddr_in *cli_sa,
+                                  int cli_port, const struct sockaddr_in *local_sa)
+{
+  mux_stream **buckets = (mux_stream **) calloc(MUX_BUCKETS, sizeof(*buckets));
+  if (!buckets) {
+    syslog(LOG_ERR, "Can't allocate multiplexed tunnel");
+    return 0;
+  }
+
+  mux_tunnel *t = new mux_tunnel;
+  t->ep           = tep;
+  t->hm           = hm;
+  t->pool         = pool;
+  t->cli_sa       = *cli_sa;
+  t->ip.addr      = (char *) &(t->cli_sa.sin_addr.s_addr);
+  t->ip.len       = addr_len;
+  t->cli_port     = cli_port;
+  t->local_sa     = *local_sa;
+  t->ready        = 0;
+  t->congested    = 0;
+  t->broken       = 0;
+  t->closed       = 0;
+  t->next_id      = 1;
+  t->buckets      = buckets;
+  t->bucket_count = MUX_BUCKETS;
+  t->streams      = 0;
+  mux_reader_init(&t->reader);
+  t->started_at   = now_ms();
+  t->next         = 0;
+  t->next_dead    = 0;
+
+  return t;
+}
+
+/*
+ * Local side: returns NULL if "pool" has no tunnel up; the one
+ * carrying the fewest streams otherwise.
+ */
+static mux_tunnel *mux_take(warm_pool *pool)
+{
+  mux_tunnel *best = 0;
+  for (mux_tunnel *t = pool->tunnels; t; t = t->next)
+    if (!t->broken && (!best || t->streams < best->streams))
+      best = t;
+  return best;
+}
+
+/*
+ * Local side: opens a stream for the client of "s" over tunnel "t".
+ * The client may send at once: frames keep their order.
+ */
+static void mux_attach(tcp_worker *w, mux_stream *s, mux_tunnel *t)
+{
+  w->mux_waiting.remove(&s->tm);
+
+  s->id = t->next_id++;
+  if (mux_hash(t, s)) {
+    socket_close(s->ep.fd);
+    if (s->limit)
+      s->limit->leave(s->src);
+    stream_pool.put(s);
+    return;
+  }
+  s->tunnel    = t;
+  s->ep.tunnel = t;
+
+  ONVERBOSE2(syslog(LOG_DEBUG, "Multiplexed tunnel: FD %d: client FD %d on stream %u", t->ep->fd, s->ep.fd, s->id));
+
+  mux_send_small(w, t, s->id, MUX_OPEN, 0, 0);
+
+  if (w->loop.add(s->ep.fd, EV_READ, &s->ep)) {
+    socket_close(s->ep.fd);
+    s->ep.fd = -1;
+    mux_stream_abort(w, s);
+    return;
+  }
+  s->ep.events = EV_READ;
+
+  timeouts_start(w, &w->mux_idling, &s->idle, &w->mux_aging, &s->life);
+  mux_stream_settle(w, s);
+}
+
+/*
+ * Local side: carries client "csd" over the least busy tunnel of
+ * "pool", or has it wait for one for at most connect-timeout plus
+ * handshake-timeout seconds.
+ */
+static void mux_accept(tcp_worker *w, warm_pool *pool, int csd, unsigned int src)
+{
+  mux_stream *s = mux_stream_new(csd);
+  if (!s) {
+    socket_close(csd);
+    if (w->svc->limit)
+      w->svc->limit->leave(src);
+    return;
+  }
+  s->pool = pool;
+  if (w->svc->limit) {
+    s->limit = w->svc->limit;
+    s->src = src;
+  }
+
+  mux_tunnel *t = mux_take(pool);
+  if (t) {
+    mux_attach(w, s, t);
+    mux_check(w, t);
+    return;
+  }
+
+  ONVERBOSE2(syslog(LOG_DEBUG, "Multiplexed tunnel: client FD %d waiting for a tunnel", csd));
+  s->next = pool->waiting;
+  pool->waiting = s;
+  w->mux_waiting.insert(&s->tm, now_ms() + (w->svc->opts->connect_timeout + w->svc->opts->handshake_timeout) * 1000LL);
+}
+
+/*
+ * Watches a keyed tunnel and greets the other side, which is to greet
+ * back before anything else.
+ */
+static void mux_tunnel_start(tcp_worker *w, mux_tunnel *t)
+{
+  tcp_endpoint *tep = t->ep;
+  warm_pool *pool = t->pool;
+
+  tep->tunnel = t;
+  if (pool) {
+    t->next = pool->tunnels;
+    pool->tunnels = t;
+    ++pool->tunnel_count;
+  }
+
+  if (w->loop.modify(tep->fd, EV_READ, tep)) {
+    mux_tunnel_close(w, t);
+    return;
+  }
+  tep->events = EV_READ;
+
+  /*
+   * MUX_WINDOW frames are small and must not wait for acknowledgment.
+   */
+  int one = 1;
+  if (setsockopt(tep->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)))
+    syslog(LOG_WARNING, "Multiplexed tunnel: Can't set TCP_NODELAY: %m");
+
+  ONVERBOSE(syslog(LOG_DEBUG, "Multiplexed tunnel: FD %d up", tep->fd));
+
+  mux_send_small(w, t, 0, MUX_HELLO, MUX_VERSION, 1);
+
+  while (pool && pool->waiting && !t->broken) {
+    mux_stream *s = pool->waiting;
+    pool->waiting = s->next;
+    mux_attach(w, s, t);
+  }
+
+  mux_check(w, t);
+}
+
+/*
+ * Remote side: tries the destinations of the tunnel's host_map in
+ * turn for a stream, as Try_connect_delayer does for a client.
+ *
+ * Returns -1 when none is left; 0 when connecting.
+ */
+static int mux_connect_next(tcp_worker *w, mux_stream *s)
+{
+  const tcp_service *svc = w->svc;
+  mux_tunnel *t = s->tunnel;
+  host_map *hm = t->hm;
+  long long now = now_ms();
+
+  for (; s->attempt < hm->dst_count(); ++s->attempt) {
+    int index = s->first_dst + s->attempt;
+    if (s->skip_down && !hm->dst_up(index, now))
+      continue;
+
+    int rsd;
+    if (hm->connect_dst(&rsd, index, &t->cli_sa, sizeof(t->cli_sa), &t->ip, t->cli_port, svc->source, &t->local_sa, svc->opts, 0)) {
+      hm->dst_failed(index);
+      continue;
+    }
+
+    if (w->loop.add(rsd, EV_WRITE, &s->ep)) {
+      socket_close(rsd);
+      continue;
+    }
+
+    s->ep.fd     = rsd;
+    s->ep.events = EV_WRITE;
+    s->dst = hm->dst_at(index);
+    s->dst->opened();
+    s->connect_start = now_us();
+    w->mux_connecting.insert(&s->tm, now_ms() + svc->opts->connect_timeout * 1000LL);
+    return 0;
+  }
+
+  return -1;
+}
+
+/*
+ * Remote side: the current destination of a stream failed: go on with
+ * the next one.
+ */
+static void mux_stream_failed(tcp_worker *w, mux_stream *s)
+{
+  host_map *hm = s->tunnel->hm;
+
+  hm->dst_failed(s->first_dst + s->attempt);
+  w->mux_connecting.remove(&s->tm);
+  if (s->ep.fd != -1) {
+    w->loop.remove(s->ep.fd);
+    socket_close(s->ep.fd);
+    s->ep.fd = -1;
+  }
+  if (s->dst) {
+    s->dst->closed();
+    s->dst = 0;
+  }
+
+  ++s->attempt;
+  if (mux_connect_next(w, s)) {
+    syslog(LOG_ERR, "Multiplexed tunnel: Can't forward stream %u from %s:%d to any destination", s->id, addrtostr(&s->tunnel->ip), s->tunnel->cli_port);
+    mux_stream_abort(w, s);
+  }
+}
+
+static void mux_stream_connected(tcp_worker *w, mux_stream *s)
+{
+  host_map *hm = s->tunnel->hm;
+  int index = s->first_dst + s->attempt;
+
+  int err = 0;
+  socklen_t err_len = sizeof(err);
+  if (getsockopt(s->ep.fd, SOL_SOCKET, SO_ERROR, &err, &err_len))
+    err = errno;
+  if (err) {
+    ONVERBOSE(syslog(LOG_WARNING, "Multiplexed tunnel: Can't connect stream %u to destination %d: %s", s->id, index % hm->dst_count(), strerror(err)));
+    mux_stream_failed(w, s);
+    return;
+  }
+
+  w->mux_connecting.remove(&s->tm);
+  hm->dst_connected(index);
+  hm->dst_ok(index);
+  s->dst->add_latency_us(now_us() - s->connect_start);
+  s->connecting = 0;
+  ONVERBOSE2(syslog(LOG_DEBUG, "Multiplexed tunnel: stream %u => destination %d", s->id, index % hm->dst_count()));
+  timeouts_start(w, &w->mux_idling, &s->idle, &w->mux_aging, &s->life);
+
+  /*
+   * Forward what came meanwhile.
+   */
+  if (out_flush(&s->ep)) {
+    mux_stream_abort(w, s);
+    return;
+  }
+
+  mux_stream_settle(w, s);
+}
+
+/*
+ * Remote side: a stream opened by the local side.
+ */
+static void mux_open_in(tcp_worker *w, mux_tunnel *t, unsigned int id)
+{
+  if (!w->svc->is_remote || id < t->next_id) {
+    syslog(LOG_ERR, "Multiplexed tunnel: Unexpected stream %u", id);
+    t->broken = 1;
+    return;
+  }
+  t->next_id = id + 1;
+
+  mux_stream *s = mux_stream_new(-1);
+  if (!s) {
+    mux_send_small(w, t, id, MUX_CLOSE, 0, 0);
+    return;
+  }
+  s->id = id;
+  if (mux_hash(t, s)) {
+    stream_pool.put(s);
+    mux_send_small(w, t, id, MUX_CLOSE, 0, 0);
+    return;
+  }
+  s->tunnel     = t;
+  s->ep.tunnel  = t;
+  s->connecting = 1;
+
+  long long now = now_ms();
+  s->first_dst = t->hm->first_dst(now);
+  s->skip_down = !t->hm->all_down(now);
+  if (mux_connect_next(w, s)) {
+    syslog(LOG_ERR, "Multiplexed tunnel: Can't forward stream %u from %s:%d to any destination", id, addrtostr(&t->ip), t->cli_port);
+    mux_stream_abort(w, s);
+  }
+}
+
+/*
+ * Payload for a stream, kept until connected on the remote side.
+ */
+static void mux_data_in(tcp_worker *w, mux_stream *s, const char *data, int len)
+{
+  if (s->received + len - s->credited > MUX_WINDOW_SZ) {
+    syslog(LOG_ERR, "Multiplexed tunnel: Stream %u overran its window", s->id);
+    s->tunnel->broken = 1;
+    return;
+  }
+  s->received += len;
+
+  if (s->connecting ? out_queue(&s->ep, data, len) : out_write(&s->ep, data, len)) {
+    mux_stream_abort(w, s);
+    return;
+  }
+
+  mux_stream_settle(w, s);
+}
+
+/*
+ * Handles a frame, or a piece of MUX_DATA payload, received on a
+ * tunnel. Frames for streams already closing are dropped.
+ */
+static void mux_frame_in(tcp_worker *w, mux_tunnel *t, const mux_frame *f)
+{
+  if (!t->ready) {
+    if (f->type != MUX_HELLO || f->value != MUX_VERSION) {
+      syslog(LOG_ERR, "Multiplexed tunnel: Peer of FD %d does not speak version %d", t->ep->fd, MUX_VERSION);
+      t->broken = 1;
+      return;
+    }
+    t->ready = 1;
+    return;
+  }
+
+  if (f->type == MUX_OPEN) {
+    mux_open_in(w, t, f->id);
+    return;
+  }
+
+  mux_stream *s = mux_find(t, f->id);
+  if (!s || s->closing)
+    return;
+
+  timeouts_touch(w, &w->mux_idling, &s->idle);
+
+  switch (f->type) {
+  case MUX_DATA:
+    mux_data_in(w, s, f->data, f->len);
+    break;
+  case MUX_WINDOW:
+    s->send_window += f->value;
+    mux_stream_settle(w, s);
+    break;
+  case MUX_CLOSE:
+    s->closing     = 1;
+    s->ep.draining = 1;
+    mux_stream_settle(w, s);
+    break;
+  }
+}
+
+/*
+ * Returns -1 on failure or EOF; 0 on success.
+ */
+static int mux_tunnel_read(tcp_worker *w, mux_tunnel *t)
+{
+  const tcp_service *svc = w->svc;
+  tcp_endpoint *tep = t->ep;
+
+  char buf[BUF_SZ];
+  int rd = read(tep->fd, buf, BUF_SZ);
+  if (!rd) {
+    ONVERBOSE(syslog(LOG_DEBUG, "Multiplexed tunnel: FD %d closed by peer", tep->fd));
+    return -1;
+  }
+  if (rd < 0) {
+    if (errno == EAGAIN || errno == EINTR)
+      return 0;
+    syslog(LOG_ERR, "Multiplexed tunnel: Failure reading from socket: %m");
+    return -1;
+  }
+
+  char *in = buf;
+  if (!svc->opts->plain)
+    apply_XOR_buf(svc->XOR_key, svc->conf_key, buf, &in, &rd, tep->session);
+
+  for (int used = 0; used < rd && !t->broken; ) {
+    mux_frame f;
+    int ready;
+    int n = mux_read(&t->reader, in + used, rd - used, &f, &ready);
+    if (n < 0)
+      return -1;
+    used += n;
+    if (ready)
+      mux_frame_in(w, t, &f);
+  }
+
+  return 0;
+}
+
+static void mux_tunnel_event(tcp_worker *w, mux_tunnel *t, unsigned int ready)
+{
+  tcp_endpoint *tep = t->ep;
+
+  if (ready & EV_WRITE) {
+    if (out_flush(tep))
+      t->broken = 1;
+    else if (t->congested && out_pending(tep) < OUT_LOW_WATER) {
+      t->congested = 0;
+      mux_rewatch(w, t);
+    }
+  }
+
+  if (!t->broken && (ready & ~EV_WRITE) && mux_tunnel_read(w, t))
+    t->broken = 1;
+
+  if (!t->broken && watch_events(&w->loop, tep))
+    t->broken = 1;
+
+  mux_check(w, t);
+}
+
+/*
+ * Returns -1 on failure; 1 on EOF; 0 on success.
+ */
+static int mux_stream_read(tcp_worker *w, mux_stream *s)
+{
+  char buf[BUF_SZ];
+  int len = BUF_SZ - MUX_HEADER;
+  if (s->send_window < len)
+    len = s->send_window;
+  if (len <= 0)
+    return 0;
+
+  int rd = read(s->ep.fd, buf + MUX_HEADER, len);
+  if (!rd)
+    return 1;
+  if (rd < 0) {
+    if (errno == EAGAIN || errno == EINTR)
+      return 0;
+    syslog(LOG_ERR, "copy: Failure reading from socket: %m");
+    return -1;
+  }
+
+  mux_header(buf, s->id, MUX_DATA, rd);
+  s->send_window -= rd;
+  mux_send(w, s->tunnel, buf, MUX_HEADER + rd);
+  return 0;
+}
+
+/*
+ * Like client_socket(), for a stream.
+ */
+static void mux_stream_event(tcp_worker *w, mux_stream *s, unsigned int ready)
+{
+  mux_tunnel *t = s->tunnel;
+
+  timeouts_touch(w, &w->mux_idling, &s->idle);
+
+  if (s->connecting) {
+    mux_stream_connected(w, s);
+    mux_check(w, t);
+    return;
+  }
+
+  if (ready & EV_WRITE) {
+    if (out_flush(&s->ep)) {
+      mux_stream_abort(w, s);
+      mux_check(w, t);
+      return;
+    }
+  }
+
+  unsigned int failed = ready & ~(EV_READ | EV_WRITE);
+  if (failed && s->ep.draining) {
+    mux_stream_free(w, s);
+    return;
+  }
+
+  if (failed || ((ready & EV_READ) && !s->ep.throttled && !s->ep.draining)) {
+    int res = mux_stream_read(w, s);
+    if (res < 0) {
+      mux_stream_abort(w, s);
+      mux_check(w, t);
+      return;
+    }
+    if (res > 0) {
+      mux_send_small(w, t, s->id, MUX_CLOSE, 0, 0);
+      s->closing     = 1;
+      s->ep.draining = 1;
+    }
+  }
+
+  mux_stream_settle(w, s);
+  mux_check(w, t);
+}
+
+/*
+ * Runs the timers of streams due at "now".
+ */
+static void mux_expire(tcp_worker *w, long long now)
+{
+  timer *tm;
+  while ((tm = w->mux_connecting.expired(now))) {
+    mux_stream *s = (mux_stream *) tm->owner;
+    mux_tunnel *t = s->tunnel;
+    ONVERBOSE(syslog(LOG_WARNING, "Multiplexed tunnel: Timeout connecting stream %u to destination %d", s->id, (s->first_dst + s->attempt) % t->hm->dst_count()));
+    mux_stream_failed(w, s);
+    mux_check(w, t);
+  }
+
+  while ((tm = w->mux_waiting.expired(now))) {
+    mux_stream *s = (mux_stream *) tm->owner;
+    syslog(LOG_WARNING, "Multiplexed tunnel: None up for client FD %d", s->ep.fd);
+    mux_stream_free(w, s);
+  }
+
+  while ((tm = w->mux_idling.expired(now))) {
+    mux_stream *s = (mux_stream *) tm->owner;
+    mux_tunnel *t = s->tunnel;
+    ONVERBOSE(syslog(LOG_DEBUG, "Multiplexed tunnel: Stream %u idle for %d seconds: closing", s->id, w->svc->opts->idle_timeout));
+    mux_stream_abort(w, s);
+    mux_check(w, t);
+  }
+
+  while ((tm = w->mux_aging.expired(now))) {
+    mux_stream *s = (mux_stream *) tm->owner;
+    mux_tunnel *t = s->tunnel;
+    ONVERBOSE(syslog(LOG_DEBUG, "Multiplexed tunnel: Stream %u open for %d seconds: closing", s->id, w->svc->opts->session_timeout));
+    mux_stream_abort(w, s);
+    mux_check(w, t);
+  }
+}
+
+/*
+ * Starts forwarding for a client accepted on listener "ls".
+ */
+static void new_client(tcp_worker *w, tcp_listener *ls, int csd, struct sockaddr_in *cli_sa)
+{
+  int cli_port = ntohs(cli_sa->sin_port);
+
+  ONVERBOSE(syslog(LOG_DEBUG, "TCP connection from %s:%d", inet_ntoa(cli_sa->sin_addr), cli_port));
+  
+  /*
+   * Check client address (ip, port).
+   */
+  struct ip_addr ip;
+  ip.addr = (char *) &(cli_sa->sin_addr.s_addr);
+  ip.len  = addr_len;
+
+  host_map *hm = tcp_match(w->svc->map_list, &ip, cli_port);
+  if (!hm) {
+    ONVERBOSE(syslog(LOG_DEBUG, "Address miss"));
+    socket_close(csd);
+    return;
+  }
+  ONVERBOSE(syslog(LOG_DEBUG, "Address match"));
+
+  /*
+   * Turn away clients beyond max-connections or max-per-source.
+   */
+  conn_limit *limit = w->svc->limit;
+  unsigned int src = cli_sa->sin_addr.s_addr;
+  if (limit && limit->enter(src)) {
+    ONVERBOSE(syslog(LOG_WARNING, "TCP connection from %s:%d over limits: closing", inet_ntoa(cli_sa->sin_addr), cli_port));
+    socket_close(csd);
+    return;
+  }
+
+  tcp_tune(csd, w->svc->opts);
+
+  warm_pool *pool = warm_find(w, hm);
+  if (pool && pool->mux) {
+    mux_accept(w, pool, csd, src);
+    return;
+  }
+
+  Try_connect_delayer *warm = pool ? warm_take(w, pool) : 0;
+  if (warm) {
+    warm->attach(csd, cli_sa, cli_port, &ls->local_sa);
+    return;
+  }
+
+  /*
+   * Connect to destination on "rsd"
+   */
+  tcp_endpoint *ep = new_pair(csd, -1);
+  if (!ep) {
+    socket_close(csd);
+    if (limit)
+      limit->leave(src);
+    return;
+  }
+  if (limit) {
+    ep->conn->limit = limit;
+    ep->conn->src = src;
+  }
+  Try_connect_delayer *s = new Try_connect_delayer(w, hm, cli_sa, cli_port, &ls->local_sa, ep);
+  s->start();
+}
+
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+static int open_spare_fd(tcp_worker *w)
+{
+  w->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  return w->spare_fd == -1 ? -1 : 0;
+}
+
+/*
+ * Out of descriptors: gives up the spare one to accept a client and
+ * close it at once, rather than leaving it queued and the listener
+ * readable forever.
+ *
+ * Returns -1 if there was no spare descriptor; 0 on success.
+ */
+static int turn_away(tcp_worker *w, tcp_listener *ls)
+{
+  if (w->spare_fd == -1 && open_spare_fd(w))
+    return -1;
+
+  if (!w->shedding) {
+    syslog(LOG_WARNING, "Out of file descriptors: turning clients away");
+    w->shedding = 1;
+  }
+
+  close(w->spare_fd);
+  int csd = accept4(ls->ep.fd, 0, 0, SOCK_CLOEXEC);
+  if (csd != -1)
+    close(csd);
+  open_spare_fd(w);
+  return 0;
 }
 
-void client_socket(int src_fd, fd_set *fds, int dest_fd[], int *maxfd, const struct ip_addr *actv_ip, const struct ip_addr *pasv_ip, long long XOR_key, long long confusing_key)
+/*
+ * Starts forwarding for client "csd", just accepted on listener "ls".
+ */
+static void accepted(tcp_worker *w, tcp_listener *ls, int csd, struct sockaddr_in *cli_sa)
 {
+  w->shedding = 0;
+
   /*
-   * Copy data.
+   * Over accept-rate: reset at once, before looking the client up
+   * or connecting anywhere, leaving no TIME_WAIT behind.
    */
-  int trg_fd = dest_fd[src_fd];
-  int fail = buf_copy(src_fd, trg_fd, actv_ip, pasv_ip, XOR_key, confusing_key);
-  if (fail) {
+  if (w->limiter && !w->limiter->allow(cli_sa->sin_addr.s_addr, w->now)) {
+    ONVERBOSE2(syslog(LOG_DEBUG, "TCP connection from %s:%d over accept-rate: resetting", inet_ntoa(cli_sa->sin_addr), ntohs(cli_sa->sin_port)));
+    struct linger abort = { 1, 0 };
+    setsockopt(csd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    close(csd);
+    return;
+  }
+
+  new_client(w, ls, csd, cli_sa);
+}
+
+/*
+ * Accepts the clients waiting on a listener, up to ACCEPT_BUDGET:
+ * the event loop reports it again if more are left.
+ */
+void mother_socket(tcp_worker *w, tcp_listener *ls)
+{
+  for (int n = 0; n < ACCEPT_BUDGET; ++n) {
+    struct sockaddr_in cli_sa;
+    socklen_t cli_sa_len = sizeof(cli_sa);
+
     /*
-     * Remove pair of communicating sockets.
+     * Accept new client on "csd"
      */
-    DEBUGFD(syslog(LOG_DEBUG, "client_socket: closed socket (FD %d or %d)", src_fd, trg_fd));
+    int csd = accept4(ls->ep.fd, (struct sockaddr *) &cli_sa, &cli_sa_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (csd < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+	return;
+      if (errno == EINTR || errno == ECONNABORTED)
+	continue;
+      if ((errno == EMFILE || errno == ENFILE) && !turn_away(w, ls))
+	continue;
+      syslog(LOG_ERR, "Can't accept TCP socket: %m");
+      return;
+    }
 
-    remove_fd_offset(src_fd);
-    remove_fd_offset(trg_fd);
-    fdclear(src_fd, fds, maxfd);
-    fdclear(trg_fd, fds, maxfd);
-    socket_close(src_fd);
-    socket_close(trg_fd);
-    gc_clean(src_fd);
-    gc_clean(trg_fd);
+    accepted(w, ls, csd, &cli_sa);
   }
 }
 
-void tcp_forward(const struct ip_addr *listen, const struct ip_addr *source, vector<int> *port_list,
-                 vector<host_map*> *map_list, const struct ip_addr *actv_ip, const struct ip_addr *pasv_ip,
-                 int uid, int gid, int fragile, long long XOR_key, long long conf_key, int is_remote)
+/*
+ * io_uring completions, see event_loop::completions(): established
+ * pairs are handed over to them unless something calls for reading
+ * the sockets ourselves, that is FTP rewriting. Each endpoint then
+ * receives for as long as it is neither throttled nor draining,
+ * straight into the buffers of the event loop, where the XOR
+ * transform runs in place. Its peer sends from
+ * that buffer when it has nothing else pending, from chunks of copies
+ * otherwise; the sends of an endpoint go in chains, one at a time,
+ * which keeps them in order.
+ */
+
+/*
+ * Queues "len" bytes to send to ep. "buf" is the buffer of the event
+ * loop they lie in, if they may be sent in place, or -1; either way
+ * it is taken over.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int sendq_add(event_loop *loop, tcp_endpoint *ep, char *data, int len, int buf)
 {
-  fd_set fds, tmp_fds, ms_fds;
-  int fd_set_len = sizeof(fd_set);
-  int maxfd = 0;
+  out_seg *s = ep->sendq_tail;
 
-  FD_ZERO(&fds);
-  FD_ZERO(&ms_fds);
+  if (buf != -1 && len && !s) {
+    s = seg_pool.get();
+    if (!s) {
+      syslog(LOG_ERR, "copy: Can't allocate pending output");
+      loop->give_back(buf);
+      return -1;
+    }
+    s->data      = data;
+    s->len       = len;
+    s->off       = 0;
+    s->buf       = buf;
+    s->in_flight = 0;
+    s->next      = 0;
+    ep->sendq      = s;
+    ep->sendq_tail = s;
+    ep->queued    += len;
+    return 0;
+  }
 
-  iterator<vector<int>,int> it(*port_list);
-  for (it.start(); it.cont(); it.next()) {
+  int fail = 0;
+  while (len) {
+    if (!s || s->in_flight || s->buf != -1 || s->len == OUT_CHUNK) {
+      out_seg *t = seg_pool.get();
+      out_chunk *c = t ? chunk_pool.get() : 0;
+      if (!c) {
+	if (t)
+	  seg_pool.put(t);
+	syslog(LOG_ERR, "copy: Can't allocate %d bytes of pending output", OUT_CHUNK);
+	fail = -1;
+	break;
+      }
+      t->data      = c->data;
+      t->len       = 0;
+      t->off       = 0;
+      t->buf       = -1;
+      t->in_flight = 0;
+      t->next      = 0;
+      if (s)
+	s->next = t;
+      else
+	ep->sendq = t;
+      ep->sendq_tail = t;
+      s = t;
+    }
 
-    int port = it.get();
-    int sd = tcp_listen(listen, &port, 3);
-    if (sd == -1) {
-      close_sockets(port_list);
+    int n = MIN(len, OUT_CHUNK - s->len);
+    memcpy(s->data + s->len, data, n);
+    s->len     += n;
+    ep->queued += n;
+    data += n;
+    len  -= n;
+  }
+
+  if (buf != -1)
+    loop->give_back(buf);
+  return fail;
+}
+
+/*
+ * Sends what ep has pending, unless sends are in flight already.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int uring_flush(tcp_worker *w, tcp_endpoint *ep)
+{
+  if (ep->sending || !ep->sendq)
+    return 0;
+
+  struct iovec iov[SEND_CHAIN];
+  void *tokens[SEND_CHAIN];
+  int n = 0;
+  for (out_seg *s = ep->sendq; s && n < SEND_CHAIN; s = s->next, ++n) {
+    iov[n].iov_base = s->data + s->off;
+    iov[n].iov_len  = s->len - s->off;
+    tokens[n] = s;
+  }
+  if (w->loop.send(ep->fd, iov, tokens, n))
+    return -1;
+
+  for (int i = 0; i < n; ++i)
+    ((out_seg *) tokens[i])->in_flight = 1;
+  ep->sending = n;
+  return 0;
+}
+
+/*
+ * Receives on ep, unless it does already, or is throttled, draining
+ * or waiting for buffers.
+ *
+ * Receives are multishot while the peer keeps up. Once it fell behind
+ * they go one buffer at a time, until a receive drains the socket
+ * with nothing pending for the peer: a multishot receive empties the
+ * socket before a stop reaches it, which would queue up to its whole
+ * receive buffer again.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int uring_recv(tcp_worker *w, tcp_endpoint *ep)
+{
+  if (ep->receiving != RECV_OFF || ep->throttled || ep->draining || timer_list::linked(&ep->starve))
+    return 0;
+
+  if (ep->one_shot ? w->loop.recv(ep->fd, ep) : w->loop.recv_all(ep->fd, ep))
+    return -1;
+  ep->receiving = RECV_ON;
+  return 0;
+}
+
+/*
+ * Stops receiving on ep; uring_received() hears of it last.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+static int uring_stop(tcp_worker *w, tcp_endpoint *ep)
+{
+  if (ep->receiving != RECV_ON)
+    return 0;
+
+  if (w->loop.stop_recv(ep->fd))
+    return -1;
+  ep->receiving = RECV_STOPPING;
+  return 0;
+}
+
+/*
+ * Hands an established pair over to completions, if the event loop
+ * has them and nothing is pending that the pair would have to finish
+ * first.
+ *
+ * Returns -1 on failure; 0 on success, whether handed over or not.
+ */
+static int uring_start(tcp_worker *w, tcp_endpoint *ep)
+{
+  const tcp_service *svc = w->svc;
+  tcp_endpoint *peer = ep->peer;
+
+  if (ep->uring || !w->loop.completions() || svc->actv_ip || svc->pasv_ip)
+    return 0;
+  if (ep->draining || out_pending(ep) || out_pending(peer))
+    return 0;
+
+  if (w->loop.remove(ep->fd) || w->loop.remove(peer->fd))
+    return -1;
+  ep->uring       = 1;
+  peer->uring     = 1;
+  ep->events      = 0;
+  peer->events    = 0;
+  ep->throttled   = 0;
+  peer->throttled = 0;
+
+  return uring_recv(w, ep) || uring_recv(w, peer) ? -1 : 0;
+}
+
+/*
+ * ep received "res" bytes into buffer "buf" of the event loop, or
+ * reached EOF (0), or failed (-errno). It goes on receiving if "more",
+ * or receives again unless its peer has too much to send already.
+ */
+static void uring_received(tcp_worker *w, tcp_endpoint *ep, int res, int buf, int more)
+{
+  const tcp_service *svc = w->svc;
+  tcp_endpoint *peer = ep->peer;
+
+  if (ep->fd == -1) {
+    if (buf != -1)
+      w->loop.give_back(buf); /* closed earlier in this round */
+    return;
+  }
+
+  timeouts_touch(w, &w->idling, &ep->conn->idle);
+  if (!more)
+    ep->receiving = RECV_OFF;
+
+  if (res > 0) {
+    char *data = w->loop.buffer(buf);
+    char *out = data;
+    if (!svc->opts->plain)
+      apply_XOR_buf(svc->XOR_key, svc->conf_key, data, &out, &res, ep->session);
+
+    int fail = sendq_add(&w->loop, peer, out, res, out == data ? buf : -1);
+    if (out != data)
+      w->loop.give_back(buf);
+    if (fail || uring_flush(w, peer)) {
+      end_pair(w, ep);
+      return;
+    }
+
+    if (out_pending(peer) > OUT_HIGH_WATER)
+      ep->throttled = 1;
+
+    if (!ep->one_shot && out_pending(peer) > OUT_LOW_WATER) {
+      ep->one_shot = 1;
+      if (uring_stop(w, ep)) {
+	end_pair(w, ep);
+	return;
+      }
+    }
+    else if (ep->one_shot && res < w->loop.buffer_len() && out_pending(peer) <= res)
+      ep->one_shot = 0;
+  }
+  else if (!res) {
+    ep->draining   = 1;
+    peer->draining = 1;
+    if (uring_stop(w, peer)) {
+      end_pair(w, ep);
       return;
     }
+  }
+  else if (res == -ENOBUFS)
+    w->starving.insert(&ep->starve, w->now + STARVE_RETRY);
+  else if (res != -ECANCELED) {
+    errno = -res;
+    syslog(LOG_ERR, "copy: Failure reading from socket: %m");
+    end_pair(w, ep);
+    return;
+  }
 
-    fdset(sd, &fds, &maxfd); /* Add sd to set for select() */
-    FD_SET(sd, &ms_fds);     /* Mark sd as mother socket */
+  if (uring_recv(w, ep)) {
+    end_pair(w, ep);
+    return;
   }
+  settle_pair(w, ep);
+}
 
-  if (drop_privileges(uid, gid)) {
-    close_sockets(port_list);
+/*
+ * Piece "s" of the output of ep is sent: "res" bytes, or -errno. With
+ * ep NULL or closed, s was left to us by sendq_drop().
+ */
+static void uring_sent(tcp_worker *w, tcp_endpoint *ep, out_seg *s, int res)
+{
+  s->in_flight = 0;
+  if (!ep || ep->fd == -1) {
+    seg_free(&w->loop, s);
     return;
   }
 
-  int dest_fd[PORTFWD_MAX_FD];
+  --ep->sending;
+  timeouts_touch(w, &w->idling, &ep->conn->idle);
+
+  if (res > 0) {
+    s->off     += res;
+    ep->queued -= res;
+  }
+  else if (res < 0 && res != -ECANCELED) {
+    errno = -res;
+    if (write_error()) {
+      end_pair(w, ep);
+      return;
+    }
+  }
+  if (ep->sending)
+    return; /* rest of the chain */
+
+  /*
+   * Pieces cancelled after a short send go again.
+   */
+  while (ep->sendq && ep->sendq->off == ep->sendq->len) {
+    out_seg *done = ep->sendq;
+    ep->sendq = done->next;
+    seg_free(&w->loop, done);
+  }
+  if (!ep->sendq)
+    ep->sendq_tail = 0;
+
+  tcp_endpoint *peer = ep->peer;
+  if (peer->throttled && out_pending(ep) < OUT_LOW_WATER) {
+    peer->throttled = 0;
+    if (uring_recv(w, peer)) {
+      end_pair(w, ep);
+      return;
+    }
+  }
 
-  for (int fd = 0; fd < PORTFWD_MAX_FD; ++fd)
-    grandchild_pid[fd] = -1;
+  if (uring_flush(w, ep)) {
+    end_pair(w, ep);
+    return;
+  }
+  settle_pair(w, ep);
+}
+
+/*
+ * Listener "ls" accepted client "res", or failed (-errno). It goes on
+ * accepting if "more".
+ */
+static void uring_accepted(tcp_worker *w, tcp_listener *ls, int res, int more)
+{
+  if (!more && w->loop.accept_all(ls->ep.fd, &ls->ep))
+    syslog(LOG_ERR, "Can't accept TCP sockets on FD %d any more", ls->ep.fd);
+
+  if (res < 0) {
+    if (res == -EINTR || res == -ECONNABORTED)
+      return;
+    if ((res == -EMFILE || res == -ENFILE) && !turn_away(w, ls))
+      return;
+    errno = -res;
+    syslog(LOG_ERR, "Can't accept TCP socket: %m");
+    return;
+  }
+
+  struct sockaddr_in cli_sa;
+  socklen_t cli_sa_len = sizeof(cli_sa);
+  if (getpeername(res, (struct sockaddr *) &cli_sa, &cli_sa_len)) {
+    ONVERBOSE2(syslog(LOG_DEBUG, "TCP connection gone before forwarding: %m"));
+    close(res);
+    return;
+  }
+
+  accepted(w, ls, res, &cli_sa);
+}
+
+/*
+ * Receives again on the endpoints that ran out of buffers a moment
+ * before "now".
+ */
+static void uring_restart(tcp_worker *w, long long now)
+{
+  timer *tm;
+  while ((tm = w->starving.expired(now))) {
+    tcp_endpoint *ep = (tcp_endpoint *) tm->owner;
+    if (uring_recv(w, ep))
+      end_pair(w, ep);
+  }
+}
+
+void client_socket(tcp_worker *w, tcp_endpoint *ep, unsigned int ready)
+{
+  const tcp_service *svc = w->svc;
+  tcp_endpoint *peer = ep->peer;
+
+  timeouts_touch(w, &w->idling, &ep->conn->idle);
+
+  /*
+   * Flush pending output; let the peer read again once it drops
+   * below the low-water mark.
+   */
+  if (ready & EV_WRITE) {
+    if (out_flush(ep)) {
+      end_pair(w, ep);
+      return;
+    }
+    if (peer->throttled && out_pending(ep) < OUT_LOW_WATER)
+      peer->throttled = 0;
+  }
+
+  /*
+   * Errors and hangups are reported whatever the conditions watched:
+   * read anyway, so that they are not reported forever.
+   */
+  unsigned int failed = ready & ~(EV_READ | EV_WRITE);
+  if (failed && ep->draining) {
+    end_pair(w, ep);
+    return;
+  }
+
+  /*
+   * Copy data.
+   */
+  if (failed || ((ready & EV_READ) && !ep->throttled && !ep->draining)) {
+    int res = splicing(w) ? buf_splice(ep) : buf_copy(ep, svc);
+    if (res < 0) {
+      end_pair(w, ep);
+      return;
+    }
+    if (res > 0) {
+      ep->draining   = 1;
+      peer->draining = 1;
+    }
+  }
+
+  if (uring_start(w, ep)) {
+    end_pair(w, ep);
+    return;
+  }
+  settle_pair(w, ep);
+}
+
+static void pin_to_cpu(int id)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus < 1)
+    return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(id % cpus, &set);
+
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (err)
+    syslog(LOG_WARNING, "Can't pin worker %d to CPU %ld: %s", id, id % cpus, strerror(err));
+  else
+    ONVERBOSE(syslog(LOG_DEBUG, "Worker %d pinned to CPU %ld", id, id % cpus));
+}
+
+static void *tcp_worker_run(void *arg)
+{
+  tcp_worker *w = (tcp_worker *) arg;
+  const tcp_service *svc = w->svc;
+
+  if (svc->opts->cpu_affinity)
+    pin_to_cpu(w->id);
+
+  if (w->loop.open(EVENTS_PER_WAIT, svc->opts->io_uring))
+    return 0;
+
+  iterator<vector<int>,int> it(w->listeners);
+  for (it.start(); it.cont(); it.next()) {
 
-  for (;;) { /* forever */
     /*
-     * Restores tmp_fds from fds.
+     * Mark sd as mother socket
      */
-    memcpy(&tmp_fds, &fds, fd_set_len);
+    tcp_listener *ls = new tcp_listener;
+    init_endpoint(&ls->ep, it.get(), 0);
+
+    socklen_t local_sa_len = sizeof(ls->local_sa);
+    if (getsockname(ls->ep.fd, (struct sockaddr *) &ls->local_sa, &local_sa_len)) {
+      syslog(LOG_ERR, "Worker %d: Can't get local sockname: %m", w->id);
+      return 0;
+    }
+
+    if (socket_nonblock(ls->ep.fd, 1))
+      return 0;
+    if (w->loop.completions() ? w->loop.accept_all(ls->ep.fd, &ls->ep) : w->loop.add(ls->ep.fd, EV_READ, &ls->ep))
+      return 0;
+  }
 
-    struct timeval tv;
-    struct timeval *tvp = NULL;
-    if (Try_connect_delayer::queued()) {
-      time_t now = time(NULL);
-      tv.tv_sec = MAX(Try_connect_delayer::earliest() - now, 0);
-      tv.tv_usec = 0;
-      tvp = &tv;
+  ONVERBOSE(syslog(LOG_DEBUG, "Worker %d serving %d listening sockets", w->id, w->listeners.get_size()));
+
+  w->dead = 0;
+  w->dead_streams = 0;
+  w->dead_tunnels = 0;
+  w->shedding = 0;
+  if (open_spare_fd(w))
+    syslog(LOG_WARNING, "Worker %d: Can't keep a spare file descriptor: %m", w->id);
+  w->now = now_ms();
+
+  w->limiter = 0;
+  if (svc->opts->accept_rate) {
+    const map_opts *opts = svc->opts;
+    w->limiter = new accept_limit;
+    if (w->limiter->setup(opts->accept_rate, opts->accept_burst ? opts->accept_burst : opts->accept_rate,
+                          opts->accept_prefix, svc->workers)) {
+      syslog(LOG_ERR, "Worker %d: Can't allocate accept-rate buckets", w->id);
+      return 0;
     }
+  }
+
+  warm_start(w);
+
+  for (;;) { /* forever */
+
+    long long now = now_ms();
+    int timeout = w->handshaking.wait_ms(now, w->retrying.wait_ms(now, w->connecting.wait_ms(now, -1)));
+    timeout = w->refilling.wait_ms(now, timeout);
+    timeout = w->mux_connecting.wait_ms(now, w->mux_waiting.wait_ms(now, timeout));
+    timeout = w->idling.wait_ms(now, w->aging.wait_ms(now, timeout));
+    timeout = w->mux_idling.wait_ms(now, w->mux_aging.wait_ms(now, timeout));
+    timeout = w->starving.wait_ms(now, timeout);
 
     /*
      * Wait for event: connection on mother sockets or data on anything else.
      */
-    DEBUGFD(syslog(LOG_DEBUG, "TCP select(): %d FDs", maxfd));
-    int nd = select(maxfd, &tmp_fds, 0, 0, tvp);
-    if (nd == -1) {
-      if (errno != EINTR)
-	syslog(LOG_ERR, "TCP select() failed: %m");
+    int nd = w->loop.wait(timeout);
+    if (nd == -1)
       continue;
+
+    now = now_ms();
+    w->now = now;
+    Try_connect_delayer::expire(w, now);
+    mux_expire(w, now);
+    pair_expire(w, now);
+    uring_restart(w, now);
+
+    for (int i = 0; i < nd; ++i) {
+      tcp_endpoint *ep = (tcp_endpoint *) w->loop.ready_ctx(i);
+      int kind = w->loop.ready_kind(i);
+      if (kind == EV_SENT)
+	uring_sent(w, ep, (out_seg *) w->loop.ready_token(i), w->loop.ready_result(i));
+      else if (kind == EV_RECEIVED)
+	uring_received(w, ep, w->loop.ready_result(i), w->loop.ready_buf(i), w->loop.ready_more(i));
+      else if (kind == EV_ACCEPTED)
+	uring_accepted(w, (tcp_listener *) ep, w->loop.ready_result(i), w->loop.ready_more(i));
+      else if (ep->mother)
+	mother_socket(w, (tcp_listener *) ep);
+      else if (ep->fd == -1)
+	continue; /* closed earlier in this round */
+      else if (ep->uring)
+	continue; /* handed over to completions earlier in this round */
+      else if (ep->stream)
+	mux_stream_event(w, ep->stream, w->loop.ready_mask(i));
+      else if (ep->tunnel)
+	mux_tunnel_event(w, ep->tunnel, w->loop.ready_mask(i));
+      else if (ep->delayer)
+	ep->delayer->event(ep, w->loop.ready_mask(i));
+      else
+	client_socket(w, ep, w->loop.ready_mask(i));
     }
 
-    while (Try_connect_delayer::ready())
-        Try_connect_delayer::handle_first();
+    free_pairs(&w->dead);
+    mux_free_dead(w);
 
-    for (int fd = 0; nd; ++fd)
-      if (FD_ISSET(fd, &tmp_fds)) {
-	--nd;
-	if (FD_ISSET(fd, &ms_fds))
-	  mother_socket(fd, &fds, dest_fd, &maxfd, map_list, source, fragile, is_remote, conf_key);
-	else
-	  client_socket(fd, &fds, dest_fd, &maxfd, actv_ip, pasv_ip, XOR_key, conf_key);
+  } /* main loop */
+
+  return 0;
+}
+
+/*
+ * TCP Fast Open is only used as far as net.ipv4.tcp_fastopen allows:
+ * 1 for connecting, 2 for listening. Only the key exchanges of the
+ * local side connect with it (see Try_connect_delayer::fast_open()).
+ */
+static void check_fast_open(int connecting)
+{
+  FILE *f = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+  if (!f)
+    return;
+
+  int mode;
+  if (fscanf(f, "%d", &mode) == 1) {
+    if (connecting && !(mode & 1))
+      syslog(LOG_WARNING, "TCP Fast Open disabled for outgoing connections: net.ipv4.tcp_fastopen is %d", mode);
+    if (!(mode & 2))
+      syslog(LOG_WARNING, "TCP Fast Open disabled for listening sockets: net.ipv4.tcp_fastopen is %d", mode);
+  }
+  fclose(f);
+}
+
+/*
+ * Probes the destinations that are down every health-check seconds.
+ */
+static void *health_check_run(void *arg)
+{
+  const tcp_service *svc = (const tcp_service *) arg;
+
+  for (;;) {
+    sleep(svc->opts->health_check);
+
+    iterator<vector<host_map*>,host_map*> it(*svc->map_list);
+    for (it.start(); it.cont(); it.next())
+      it.get()->probe_down(svc->source, svc->opts->connect_timeout);
+  }
+
+  return 0;
+}
+
+void tcp_forward(const struct ip_addr *listen, const struct ip_addr *source, vector<int> *port_list,
+                 vector<host_map*> *map_list, const struct ip_addr *actv_ip, const struct ip_addr *pasv_ip,
+                 int uid, int gid, int fragile, long long XOR_key, long long conf_key, int is_remote,
+                 const struct map_opts *opts)
+{
+  int workers = opts->workers;
+
+  if (on_the_fly_dns)
+    name_cache.start();
+
+  raise_fd_limit();
+
+  if (opts->fast_open)
+    check_fast_open(!is_remote && !opts->plain);
+
+  tcp_service svc;
+  svc.source    = source;
+  svc.map_list  = map_list;
+  svc.actv_ip   = actv_ip;
+  svc.pasv_ip   = pasv_ip;
+  svc.fragile   = fragile;
+  svc.XOR_key   = XOR_key;
+  svc.conf_key  = conf_key;
+  svc.is_remote = is_remote;
+  svc.splice    = opts->plain && !actv_ip && !pasv_ip;
+  svc.workers   = workers;
+  if (opts->plain && !svc.splice)
+    ONVERBOSE(syslog(LOG_DEBUG, "Plain map rewriting FTP: copying through user space"));
+  if (opts->mux && (actv_ip || pasv_ip))
+    syslog(LOG_WARNING, "Multiplexed map: FTP addresses are not rewritten");
+  if (opts->mux && opts->warm_pool)
+    syslog(LOG_WARNING, "Multiplexed map: warm-pool ignored");
+  svc.opts      = opts;
+  svc.limit     = opts->max_connections || opts->max_per_source ? new conn_limit(opts->max_connections, opts->max_per_source) : 0;
+
+  tcp_worker *w = new tcp_worker[workers];
+  for (int i = 0; i < workers; ++i) {
+    w[i].id  = i;
+    w[i].svc = &svc;
+  }
+
+  /*
+   * Listen before dropping privileges, for every worker.
+   */
+  iterator<vector<int>,int> it(*port_list);
+  for (it.start(); it.cont(); it.next()) {
+
+    int port = it.get();
+    for (int i = 0; i < workers; ++i) {
+      int sd = tcp_listen(listen, &port, opts->backlog, workers > 1, opts);
+      if (sd == -1) {
+	for (int j = 0; j < workers; ++j)
+	  close_sockets(&w[j].listeners);
+	return;
       }
+      w[i].listeners.push(sd);
+    }
+  }
 
-  } /* main loop */
+  if (drop_privileges(uid, gid)) {
+    for (int j = 0; j < workers; ++j)
+      close_sockets(&w[j].listeners);
+    return;
+  }
+
+  iterator<vector<host_map*>,host_map*> it2(*map_list);
+  for (it2.start(); it2.cont(); it2.next())
+    it2.get()->track_health(opts->eject_after, opts->health_check > 0);
+
+  if (opts->eject_after > 0 && opts->health_check > 0) {
+    pthread_t thread;
+    int err = pthread_create(&thread, 0, health_check_run, &svc);
+    if (err)
+      syslog(LOG_ERR, "Can't start health checks: %s", strerror(err));
+  }
+
+  for (int i = 1; i < workers; ++i) {
+    int err = pthread_create(&w[i].thread, 0, tcp_worker_run, &w[i]);
+    if (err)
+      syslog(LOG_ERR, "Can't start worker %d: %s", i, strerror(err));
+  }
 
+  w[0].thread = pthread_self();
+  tcp_worker_run(&w[0]);
 }
 
 static void do_udp_forward(const struct ip_addr *source, 
@@ -1248,6 +4157,9 @@ void udp_forward(const struct ip_addr *listen_addr, const struct ip_addr *source
 
   FD_ZERO(&fds);
 
+  if (on_the_fly_dns)
+    name_cache.start();
+
   iterator<vector<int>,int> it(*port_list);
   for (it.start(); it.cont(); it.next()) {
 
@@ -1297,7 +4209,7 @@ void udp_forward(const struct ip_addr *listen_addr, const struct ip_addr *source
 	  continue;
 	}
         char *buf2 = NULL;
-        apply_XOR_buf(XOR_key, 0ll, buf, &buf2,&rd, 0, 0);
+        apply_XOR_buf(XOR_key, 0ll, buf, &buf2,&rd, 0);
 
 	/*
 	 * Get local address
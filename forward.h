@@ -11,37 +11,30 @@
 #include "host_map.hpp"
 #include "portfwd.h"
 #include "fd_set.h"
+#include "map_opts.h"
+#include "keystream2.h"
 
-
-typedef struct KeyValuePair_struct {
-    const void *key;
-    void *value;
-    struct KeyValuePair_struct *next;
-} KeyValuePair;
-
-typedef struct {
-    long numOfBuckets;
-    long numOfElements;
-    KeyValuePair **bucketArray;
-    float idealRatio, lowerRehashThreshold, upperRehashThreshold;
-    int (*keycmp)(const void *key1, const void *key2);
-    int (*valuecmp)(const void *value1, const void *value2);
-    unsigned long (*hashFunction)(const void *key);
-    void (*keyDeallocator)(void *key);
-    void (*valueDeallocator)(void *value);
-} HashTable;
-
-void *HashTableGet(const HashTable *hashTable, const void *key);
-int HashTablePut(HashTable *hashTable, const void *key, void *value);
-void HashTableRemove(HashTable *hashTable, const void *key);
-HashTable *HashTableCreate(long numOfBuckets);
-
-extern int grandchild_pid[PORTFWD_MAX_FD];
-
-int buf_copy(int src_fd, int trg_fd, int pasv);
-int tcp_listen(const struct ip_addr *ip, int *port, int queue);
-
-void tcp_forward(const struct ip_addr *listen, const struct ip_addr *source, vector<int> *port_list, vector<host_map*> *map_list, const struct ip_addr *actv_ip, const struct ip_addr *pasv_ip, int uid, int gid, int fragile, long long XOR_key, long long confuse_key, int is_remote_server);
+/*
+ * Keystream state of what is read from one socket of a pair.
+ */
+typedef struct{
+  unsigned long long in_offset;
+  unsigned long long out_offset;
+  unsigned long long session_key;
+  int inflate_when_copying;
+  char *inflated;      /* output of apply_XOR_buf(), when inflating */
+  int inflated_size;
+  int version;         /* wire protocol: 1, or 2 with ks2 (and offsets in the inflated stream) */
+  ks2_key ks2;
+} clientSock_session_t;
+
+void apply_XOR_buf(long long XOR_key, long long confusing_key, char *buf, char ** buf2, int * rd, clientSock_session_t * session);
+
+int tcp_listen(const struct ip_addr *ip, int *port, int queue, int reuse_port, const struct map_opts *opts);
+void tcp_tune_buffers(int sd, const struct map_opts *opts);
+void tcp_tune(int sd, const struct map_opts *opts);
+
+void tcp_forward(const struct ip_addr *listen, const struct ip_addr *source, vector<int> *port_list, vector<host_map*> *map_list, const struct ip_addr *actv_ip, const struct ip_addr *pasv_ip, int uid, int gid, int fragile, long long XOR_key, long long confuse_key, int is_remote_server, const struct map_opts *opts);
 void udp_forward(const struct ip_addr *listen, const struct ip_addr *source, vector<int> *port_list, vector<host_map*> *map_list, int uid, int gid, long long XOR_key);
 
 #endif /* FORWARD_H */
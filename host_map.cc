@@ -4,7 +4,10 @@
   $Id: host_map.cc,v 1.1.1.1 2019/04/06 10:36:07 cvs Exp $
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <poll.h>
 #include <syslog.h>
 #include <errno.h>
 #include <sys/time.h>
@@ -12,11 +15,20 @@
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include "portfwd.h"
+#include "forward.h"
 #include "host_map.hpp"
 #include "solve.h"
 
+static void show_dst(const to_addr *dst)
+{
+  dst->show();
+  if (dst->get_weight() != 1)
+    syslog(LOG_INFO, " weight %d", dst->get_weight());
+}
+
 void host_map::show() const
 {
   iterator<vector<from_addr*>,from_addr*> it(*src_list);
@@ -32,18 +44,67 @@ void host_map::show() const
 
   syslog(LOG_INFO, " => ");
 
+  static const char *balance_names[] = { "failover", "round-robin", "least-conn", "least-latency" };
+  if (balance != BALANCE_ROUND_ROBIN)
+    syslog(LOG_INFO, "%s ", balance_names[balance]);
+
   iterator<vector<to_addr*>,to_addr*> it2(*dst_list);
   it2.start();
   if (it2.cont()) {
-    it2.get()->show();
+    show_dst(it2.get());
     it2.next();
   }
   for (; it2.cont(); it2.next()) {
     syslog(LOG_INFO, ", ");
-    it2.get()->show();
+    show_dst(it2.get());
   }
 }
 
+/*
+ * Round robin goes through a schedule where each destination comes
+ * as often as its weight, spread out as evenly as can be: each turn
+ * goes to the destination furthest behind its share.
+ */
+void host_map::build_schedule()
+{
+  int size = dst_list->get_size();
+  if (size < 1)
+    return; /* the grammar allows no empty dst_list */
+
+  /*
+   * Weights are at most MAX_WEIGHT, but there is no bound on the
+   * number of destinations.
+   */
+  size_t total = 0;
+  for (int i = 0; i < size; ++i)
+    total += dst_list->get_at(i)->get_weight();
+  if (total > INT_MAX / sizeof(int)) {
+    syslog(LOG_ERR, "Round robin schedule too long: %lu turns", (unsigned long) total);
+    exit(1);
+  }
+
+  schedule = (int *) malloc(total * sizeof(int));
+  int *behind = (int *) calloc(size, sizeof(int));
+  if (!schedule || !behind) {
+    syslog(LOG_ERR, "Can't allocate round robin schedule of %lu turns: %m", (unsigned long) total);
+    exit(1);
+  }
+
+  for (int turn = 0; turn < (int) total; ++turn) {
+    int best = 0;
+    for (int i = 0; i < size; ++i) {
+      behind[i] += dst_list->get_at(i)->get_weight();
+      if (behind[i] > behind[best])
+	best = i;
+    }
+    behind[best] -= total;
+    schedule[turn] = best;
+  }
+  schedule_len = total;
+
+  free(behind);
+}
+
 static int make_tcp_outgoing_socket(const struct ip_addr *src, const struct sockaddr_in *cli_sa, unsigned int cli_sa_len)
 {
   /*
@@ -127,107 +188,377 @@ static int make_tcp_outgoing_socket(const struct ip_addr *src, const struct sock
 }
 
 /*
- * Returns -1 on failure; 0 on success.
+ * Seconds a destination found down is passed over when no probe can
+ * bring it back.
+ */
+const int EJECT_SECONDS = 30;
+
+/*
+ * Destinations go down after "eject_after" consecutive connect or
+ * handshake failures (0: never). A down destination is passed over
+ * while another is up: until probe_down() reaches it when "probing",
+ * otherwise for EJECT_SECONDS, after which clients try it again.
  */
-int host_map::pipe(int *sd, const struct sockaddr_in *cli_sa, 
-		   unsigned int cli_sa_len, const struct ip_addr *ip, 
-		   int port, const struct ip_addr *src, 
-		   const struct sockaddr_in *local_cli_sa)
+void host_map::track_health(int eject_after, int probing)
 {
-  const int tmp_len = 32;
-  char tmp[tmp_len];
+  if (eject_after < 1)
+    return;
 
-  /*
-   * Scan all destination addresses
-   */
+  health = (dst_health *) calloc(dst_list->get_size(), sizeof(dst_health));
+  if (!health) {
+    syslog(LOG_ERR, "Can't allocate destination health: %m");
+    return;
+  }
+
+  this->eject_after = eject_after;
+  this->probing     = probing;
+}
 
-  /* Save starting address */
-  int last_dst_index = next_dst_index;
+int host_map::dst_up(int index, long long now) const
+{
+  if (!health)
+    return 1;
 
-  for (;;) {
+  long long down_until = health[index % dst_list->get_size()].down_until;
+  return !down_until || down_until <= now;
+}
 
-    safe_strcpy(tmp, addrtostr(ip), tmp_len); 
+int host_map::all_down(long long now) const
+{
+  for (int i = 0; i < dst_list->get_size(); ++i)
+    if (dst_up(i, now))
+      return 0;
+  return 1;
+}
+
+/*
+ * The destination up with the least load for its weight: active
+ * connections, times the average latency for BALANCE_LEAST_LATENCY.
+ * Ties go to each destination in turn.
+ *
+ * Returns -1 when all are down; destination index on success.
+ */
+int host_map::least_loaded(long long now)
+{
+  int size = dst_list->get_size();
+  unsigned int start = __sync_fetch_and_add(&ticket, 1);
+
+  int best = -1;
+  double best_load = 0;
+  for (int i = 0; i < size; ++i) {
+    int index = (start + i) % size;
+    if (!dst_up(index, now))
+      continue;
 
     /*
-     * Get current destination address
+     * Counting the connection to come favours idle fast
+     * destinations over idle slow ones.
      */
-    to_addr *dst_addr = dst_list->get_at(next_dst_index);
+    const to_addr *dst = dst_list->get_at(index);
+    double load = dst->get_active();
+    if (balance == BALANCE_LEAST_LATENCY)
+      load = (load + 1) * dst->get_latency_us();
+    load /= dst->get_weight();
+
+    if (best == -1 || load < best_load) {
+      best = index;
+      best_load = load;
+    }
+  }
 
-    const struct ip_addr *dst_ip;
-    int dst_port;
-    if (dst_addr->get_addr(get_protoname(P_TCP), cli_sa, local_cli_sa, &dst_ip, &dst_port)) {
-      ONVERBOSE(syslog(LOG_INFO, "TCP pipe: Could not load next destination address for: %s:%d", tmp, port));
-      return -1;
+  return best;
+}
+
+/*
+ * The destination a new connection tries first, as "balance" has it
+ * among those up. Following attempts go on from there in order (see
+ * connect_dst()).
+ */
+int host_map::first_dst(long long now)
+{
+  int size = dst_list->get_size();
+
+  switch (balance) {
+  case BALANCE_ROUND_ROBIN:
+    {
+      unsigned int turn = __sync_fetch_and_add(&ticket, 1);
+      for (int i = 0; i < schedule_len; ++i) {
+	int index = schedule[(turn + i) % schedule_len];
+	if (dst_up(index, now))
+	  return index;
+      }
+      return schedule[turn % schedule_len];
     }
-    
-    ONVERBOSE2(syslog(LOG_DEBUG, "TCP pipe: trying: %s:%d => %s:%d", tmp, port, addrtostr(dst_ip), dst_port));
 
-    /*
-     * Create outgoing socket
-     */
-    int rsd = make_tcp_outgoing_socket(src, cli_sa, cli_sa_len);
-    if (rsd < 0) {
-      syslog(LOG_ERR, "TCP pipe: Could not create outgoing socket");
-      return -1;
+  case BALANCE_LEAST_CONN:
+  case BALANCE_LEAST_LATENCY:
+    {
+      int index = least_loaded(now);
+      return index == -1 ? next_dst_index : index;
     }
-    
-    /*
-     * Put current destination address in a "sockaddr_in" struct
-     */
 
-    struct sockaddr_in sa;
-    sa.sin_family      = PF_INET;
-    sa.sin_port        = htons(dst_port);
-    sa.sin_addr.s_addr = *((unsigned int *) dst_ip->addr);
-    memset((char *) sa.sin_zero, 0, sizeof(sa.sin_zero));
+  default:
+    break;
+  }
 
-    /*
-     * Try current destination address
-     */
-    if (connect(rsd, (struct sockaddr *) &sa, sizeof(sa))) {
-      ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: Can't connect %s:%d to %s:%d: %m", tmp, port, inet_ntoa(sa.sin_addr), dst_port));
+  /*
+   * Failover: the last one known to work, or the next one up after it.
+   */
+  int first = next_dst_index;
+  for (int i = 0; i < size; ++i)
+    if (dst_up(first + i, now))
+      return (first + i) % size;
 
-      /*
-       * Close the socket, as it can't be reused
-       */
-      close(rsd); 
+  return first;
+}
 
-      /*
-       * Switch to next address
-       */
-      next_dst_index = (next_dst_index + 1) % dst_list->get_size();
+/*
+ * Destination "index" failed: switch to the next one, unless another
+ * connection already did, and take it down after too many failures
+ * in a row.
+ */
+void host_map::dst_failed(int index)
+{
+  int size = dst_list->get_size();
+  index %= size;
+  __sync_bool_compare_and_swap(&next_dst_index, index, (index + 1) % size);
 
-      /*
-       * If all addresses were tried without success, give up
-       */
-      if (next_dst_index == last_dst_index) {
-	syslog(LOG_ERR, "TCP pipe: Can't forward incoming connection from %s:%d to any destination", tmp, port);
-	return -1;
-      }
+  if (!health)
+    return;
 
-      continue;
+  dst_health *h = &health[index];
+  if (__sync_add_and_fetch(&h->failures, 1) < eject_after)
+    return;
+
+  const struct ip_addr *ip;
+  int port;
+  int probed = probing && !dst_list->get_at(index)->fixed_addr(&ip, &port);
+
+  /*
+   * Probed destinations stay down until a probe reaches them.
+   */
+  long long down_until = probed ? LLONG_MAX : now_ms() + EJECT_SECONDS * 1000LL;
+  long long was = h->down_until;
+  if (__sync_bool_compare_and_swap(&h->down_until, was, down_until) && !was)
+    syslog(LOG_WARNING, "Destination %d down after %d failures", index, h->failures);
+}
+
+/*
+ * Destination "index" took a connection: the next one starts after
+ * it, as with the blocking pipe() of old, unless "failover" keeps to
+ * the last one known to work.
+ */
+void host_map::dst_connected(int index)
+{
+  if (balance == BALANCE_FAILOVER)
+    return;
+
+  int size = dst_list->get_size();
+  index %= size;
+  __sync_bool_compare_and_swap(&next_dst_index, index, (index + 1) % size);
+}
+
+/*
+ * Destination "index" answered: it is up again.
+ */
+void host_map::dst_ok(int index)
+{
+  if (!health)
+    return;
+
+  dst_health *h = &health[index % dst_list->get_size()];
+  h->failures = 0;
+  long long was = h->down_until;
+  if (was && __sync_bool_compare_and_swap(&h->down_until, was, 0))
+    syslog(LOG_INFO, "Destination %d up", index % dst_list->get_size());
+}
+
+/*
+ * Connects to destination "index" from "src" (if not NULL), waiting
+ * at most "timeout" seconds.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+int host_map::probe_dst(int index, const struct ip_addr *src, int timeout)
+{
+  const struct ip_addr *dst_ip;
+  int dst_port;
+  if (dst_list->get_at(index)->fixed_addr(&dst_ip, &dst_port))
+    return -1;
+
+  int sd = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, get_protonumber(P_TCP));
+  if (sd == -1) {
+    syslog(LOG_ERR, "host_map::probe_dst(): Can't create TCP socket: %m");
+    return -1;
+  }
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = PF_INET;
+
+  if (src) {
+    sa.sin_port        = htons(0);
+    sa.sin_addr.s_addr = *((unsigned int *) src->addr);
+    if (bind(sd, (struct sockaddr *) &sa, sizeof(sa))) {
+      syslog(LOG_ERR, "host_map::probe_dst(): Can't bind TCP socket to local source address: %s: %m", inet_ntoa(sa.sin_addr));
+      close(sd);
+      return -1;
     }
+  }
 
-    /*
-     * Here we have a good outgoing connection on "rsd"
-     */
+  sa.sin_port        = htons(dst_port);
+  sa.sin_addr.s_addr = *((unsigned int *) dst_ip->addr);
 
-    /*
-     * Return outgoing socket
-     */
-    *sd = rsd;
+  int err = 0;
+  if (connect(sd, (struct sockaddr *) &sa, sizeof(sa))) {
+    err = errno;
+    if (err == EINPROGRESS) {
+      struct pollfd pfd;
+      pfd.fd     = sd;
+      pfd.events = POLLOUT;
+      int nd = poll(&pfd, 1, timeout * 1000);
+      socklen_t err_len = sizeof(err);
+      if (nd < 1)
+	err = nd ? errno : ETIMEDOUT;
+      else if (getsockopt(sd, SOL_SOCKET, SO_ERROR, &err, &err_len))
+	err = errno;
+    }
+  }
+  close(sd);
+
+  if (err) {
+    ONVERBOSE2(syslog(LOG_DEBUG, "Health check: destination %d: %s:%d: %s", index, inet_ntoa(sa.sin_addr), dst_port, strerror(err)));
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Probes the destinations that are down, bringing back those that
+ * answer.
+ */
+void host_map::probe_down(const struct ip_addr *src, int timeout)
+{
+  if (!health)
+    return;
+
+  long long now = now_ms();
+  for (int i = 0; i < dst_list->get_size(); ++i)
+    if (!dst_up(i, now) && !probe_dst(i, src, timeout))
+      dst_ok(i);
+}
+
+int host_map::dst_count() const
+{
+  return dst_list->get_size();
+}
+
+to_addr *host_map::dst_at(int index) const
+{
+  return dst_list->get_at(index % dst_list->get_size());
+}
+
+int host_map::client_dependent() const
+{
+  for (int i = 0; i < dst_list->get_size(); ++i)
+    if (dst_list->get_at(i)->client_dependent())
+      return 1;
+  return 0;
+}
+
+/*
+ * Starts a non-blocking connection to destination "index" (taken
+ * modulo the number of destinations). Completion is to be waited
+ * for with the socket becoming writable.
+ *
+ * The socket is tuned as asked by "opts". With "fast_open", a
+ * destination that handed out a TCP Fast Open cookie before gets the
+ * SYN with the first write, carrying its bytes: the socket is
+ * writable at once, and a destination refusing is only noticed by
+ * that write or the next read. Only ask for it where the caller
+ * writes first and waits for an answer: a destination that talks
+ * first would never see the connection.
+ *
+ * Returns -1 on failure; 0 on success.
+ */
+int host_map::connect_dst(int *sd, int index, const struct sockaddr_in *cli_sa,
+			  unsigned int cli_sa_len, const struct ip_addr *ip,
+			  int port, const struct ip_addr *src,
+			  const struct sockaddr_in *local_cli_sa, const struct map_opts *opts,
+			  int fast_open)
+{
+  const int tmp_len = 32;
+  char tmp[tmp_len];
+
+  safe_strcpy(tmp, addrtostr(ip), tmp_len); 
+
+  /*
+   * Get destination address
+   */
+  to_addr *dst_addr = dst_list->get_at(index % dst_list->get_size());
 
-    ONVERBOSE2(syslog(LOG_DEBUG, "TCP pipe: connected: %s:%d => %s:%d", tmp, port, addrtostr(dst_ip), dst_port));
+  const struct ip_addr *dst_ip;
+  int dst_port;
+  if (dst_addr->get_addr(get_protoname(P_TCP), cli_sa, local_cli_sa, &dst_ip, &dst_port)) {
+    ONVERBOSE(syslog(LOG_INFO, "TCP pipe: Could not load next destination address for: %s:%d", tmp, port));
+    return -1;
+  }
     
-    break;
+  ONVERBOSE2(syslog(LOG_DEBUG, "TCP pipe: trying: %s:%d => %s:%d", tmp, port, addrtostr(dst_ip), dst_port));
+
+  /*
+   * Create outgoing socket
+   */
+  int rsd = make_tcp_outgoing_socket(src, cli_sa, cli_sa_len);
+  if (rsd < 0) {
+    syslog(LOG_ERR, "TCP pipe: Could not create outgoing socket");
+    return -1;
+  }
+
+  if (socket_nonblock(rsd, 1)) {
+    close(rsd);
+    return -1;
   }
 
+  tcp_tune_buffers(rsd, opts);
+  tcp_tune(rsd, opts);
+
+  if (fast_open) {
+#ifdef TCP_FASTOPEN_CONNECT
+    int one = 1;
+    if (setsockopt(rsd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &one, sizeof(one)))
+      ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: Can't use TCP Fast Open: setsockopt(TCP_FASTOPEN_CONNECT) failed: %m"));
+#else
+    ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: TCP Fast Open not supported"));
+#endif
+  }
+    
   /*
-   * Switch to next destination address
-   * (left ready for the next incoming connection)
+   * Put destination address in a "sockaddr_in" struct
    */
-  next_dst_index = (next_dst_index + 1) % dst_list->get_size();
-  
+
+  struct sockaddr_in sa;
+  sa.sin_family      = PF_INET;
+  sa.sin_port        = htons(dst_port);
+  sa.sin_addr.s_addr = *((unsigned int *) dst_ip->addr);
+  memset((char *) sa.sin_zero, 0, sizeof(sa.sin_zero));
+
+  /*
+   * Try destination address
+   */
+  if (connect(rsd, (struct sockaddr *) &sa, sizeof(sa)) && errno != EINPROGRESS) {
+    ONVERBOSE(syslog(LOG_WARNING, "TCP pipe: Can't connect %s:%d to %s:%d: %m", tmp, port, inet_ntoa(sa.sin_addr), dst_port));
+
+    /*
+     * Close the socket, as it can't be reused
+     */
+    close(rsd); 
+    return -1;
+  }
+
+  *sd = rsd;
+
   return 0;
 }
 
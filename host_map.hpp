@@ -12,6 +12,25 @@
 #include "vector.hpp"
 #include "from_addr.hpp"
 #include "to_addr.hpp"
+#include "map_opts.h"
+
+/*
+ * How a new connection picks the destination it tries first.
+ */
+enum balance_t {
+  BALANCE_FAILOVER,      /* the last one known to work */
+  BALANCE_ROUND_ROBIN,   /* in turn, as often as their weights say: the default */
+  BALANCE_LEAST_CONN,    /* fewest connections for its weight */
+  BALANCE_LEAST_LATENCY  /* quickest to answer, for how busy it is */
+};
+
+/*
+ * Health of a destination, shared by the workers of a map.
+ */
+struct dst_health {
+  int       failures;    /* consecutive connect or handshake failures */
+  long long down_until;  /* now_ms() clock; 0: up */
+};
 
 class host_map
 {
@@ -20,20 +39,56 @@ private:
   vector<to_addr*>   *dst_list;
   int next_dst_index;
 
+  balance_t balance;
+  int *schedule;         /* round robin: destinations in turn */
+  int schedule_len;
+  unsigned int ticket;   /* connections seen, for taking turns */
+
+  dst_health *health;    /* NULL: no health tracking */
+  int eject_after;
+  int probing;
+
+  int probe_dst(int index, const struct ip_addr *src, int timeout);
+  void build_schedule();
+  int least_loaded(long long now);
+
 public:
-  host_map(vector<from_addr*> *src, vector<to_addr*> *dst)
+  host_map(vector<from_addr*> *src, vector<to_addr*> *dst, balance_t bal)
     {
       src_list = src;
       dst_list = dst;
       next_dst_index = 0;
+      balance = bal;
+      schedule = 0;
+      schedule_len = 0;
+      ticket = 0;
+      if (balance == BALANCE_ROUND_ROBIN)
+	build_schedule();
+      health = 0;
+      eject_after = 0;
+      probing = 0;
     }
 
   void show() const;
 
-  int pipe(int *sd, const struct sockaddr_in *cli_sa, 	
-	   unsigned int cli_sa_len, const struct ip_addr *ip, 
-	   int port, const struct ip_addr *src, 	
-	   const struct sockaddr_in *local_cli_sa);
+  void track_health(int eject_after, int probing);
+  int dst_up(int index, long long now) const;
+  int all_down(long long now) const;
+  void probe_down(const struct ip_addr *src, int timeout);
+
+  int first_dst(long long now);
+  void dst_failed(int index);
+  void dst_connected(int index);
+  void dst_ok(int index);
+  int dst_count() const;
+  to_addr *dst_at(int index) const;
+  int client_dependent() const;
+
+  int connect_dst(int *sd, int index, const struct sockaddr_in *cli_sa,
+		  unsigned int cli_sa_len, const struct ip_addr *ip,
+		  int port, const struct ip_addr *src,
+		  const struct sockaddr_in *local_cli_sa, const struct map_opts *opts,
+		  int fast_open);
 
   void udp_forward(const struct ip_addr *source, 
 		   const struct sockaddr_in *cli_sa, 
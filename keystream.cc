@@ -0,0 +1,293 @@
+/*
+  keystream.cc
+
+  $Id: keystream.cc,v 1.1 2026/10/17 18:02:11 cvs Exp $
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEYSTREAM_AVX2
+#endif
+
+#include "keystream.h"
+
+/*
+ * The portfwdXOR program is not for protecting the data to the maximum
+ * level. It is to camouflage the communication so that it cannot be
+ * censored at a low cost. Hence the pseudo RNG is very simple.
+ *
+ * This is the reference: keystream() must produce the very same values,
+ * or peers stop understanding each other.
+ */
+int pseudo_rand_key_offset(long long key, long long offset, long long session_key){
+  return (int) (( key ^(((offset + key)<< 27) % 2038074739ll ) ^ (( offset <<3+ session_key ) % 3603804991llu ))% 41621llu );
+}
+
+/*
+ * pseudo_rand_key_offset() is
+ *
+ *   (key ^ (y % M1) ^ (z % M2)) % M3
+ *
+ * with y = (offset + key) << 27 and z = offset << ((3 + session_key) & 63),
+ * both wrapping around 2^64 (and the shift count taken modulo 64, as
+ * the processor does). Along consecutive offsets, y and z grow by
+ * constant steps, so both remainders can be carried over with an
+ * addition and a compare instead of a 64-bit division each. Only the
+ * final remainder is computed afresh.
+ */
+static const long long          M1 = 2038074739ll;
+static const unsigned long long M2 = 3603804991llu;
+static const unsigned long long M3 = 41621llu;
+
+struct ks_state {
+  long long          y;
+  long long          a;  /* y % M1, sign of y */
+  unsigned long long z;
+  long long          b;  /* z % M2 */
+};
+
+static int shift_count(long long session_key)
+{
+  return (int) ((3ull + (unsigned long long) session_key) & 63);
+}
+
+static void ks_at(ks_state *st, long long key, long long offset, int s)
+{
+  st->y = (long long) (((unsigned long long) offset + (unsigned long long) key) << 27);
+  st->a = st->y % M1;
+  st->z = (unsigned long long) offset << s;
+  st->b = (long long) (st->z % M2);
+}
+
+static int ks_value(const ks_state *st, long long key)
+{
+  return (int) (((unsigned long long) (key ^ st->a) ^ (unsigned long long) st->b) % M3);
+}
+
+/*
+ * Moves the state "k" offsets on: y by dy = k << 27 (less than M1 for
+ * k up to 8), z by dz, whose remainder is db; w is 2^64 % M2.
+ */
+static void ks_step(ks_state *st, unsigned long long dy, unsigned long long dz, long long db, long long w)
+{
+  long long y = (long long) ((unsigned long long) st->y + dy);
+  if ((y ^ st->y) < 0)
+    st->a = y % M1; /* sign changed */
+  else {
+    st->a += dy;
+    if (y < 0 ? st->a > 0 : st->a >= M1)
+      st->a -= M1;
+  }
+  st->y = y;
+
+  unsigned long long z = st->z + dz;
+  st->b += db;
+  if (st->b >= (long long) M2)
+    st->b -= M2;
+  if (z < st->z) { /* wrapped around 2^64 */
+    st->b -= w;
+    if (st->b < 0)
+      st->b += M2;
+  }
+  st->z = z;
+}
+
+static void keystream_shifted(int *ks, int n, long long key, long long offset, int s)
+{
+  if (n <= 0)
+    return;
+
+  unsigned long long dz = 1ull << s;
+  long long db = (long long) (dz % M2);
+  long long w = (long long) ((0ull - M2) % M2);
+
+  ks_state st;
+  ks_at(&st, key, offset, s);
+  ks[0] = ks_value(&st, key);
+  for (int i = 1; i < n; ++i) {
+    ks_step(&st, 1ull << 27, dz, db, w);
+    ks[i] = ks_value(&st, key);
+  }
+}
+
+static void keystream_scalar(int *ks, int n, long long key, long long offset, long long session_key)
+{
+  keystream_shifted(ks, n, key, offset, shift_count(session_key));
+}
+
+#ifdef KEYSTREAM_AVX2
+
+/*
+ * Eight 32-bit lanes, one per offset, each stepping 8 offsets on, over
+ * a run where y keeps its sign and, for shift counts up to 32, z does
+ * not wrap around 2^64 (see keystream_avx2()).
+ *
+ * Everything fits in 32 bits: a is kept as y mod M1 in [0, M1), which
+ * gives the C remainder back as y keeps its sign, and b is below 2^32.
+ * The high half of key ^ a ^ b is then one of two values (a < 0 or
+ * not), whose remainders are computed beforehand, and the low half is
+ * divided by M3 with a multiplication. Larger shift counts make z wrap
+ * every 2^(64 - s) offsets: each lane follows its offset modulo that.
+ */
+__attribute__((target("avx2")))
+static void keystream_avx2_run(int *ks, int n, long long key, long long offset, int s)
+{
+  int i = 0;
+
+  if (n >= 16) {
+    unsigned long long dz = 8ull << s;
+    unsigned int db = (unsigned int) (dz % M2);
+    unsigned int w = (unsigned int) ((0ull - M2) % M2);
+    unsigned int dy = 8u << 27; /* less than M1 */
+    int track = s > 32;
+    unsigned int p = track ? 1u << (64 - s) : 0;
+    unsigned int kp = track ? 8 & (p - 1) : 0;
+
+    unsigned int fm[8], b[8], u[8];
+    ks_state st;
+    for (int j = 0; j < 8; ++j) {
+      ks_at(&st, key, offset + j, s);
+      fm[j] = (unsigned int) (st.a < 0 ? st.a + M1 : st.a);
+      b[j] = (unsigned int) st.b;
+      u[j] = (unsigned int) (offset + j) & (p - 1);
+    }
+    int neg = st.y < 0;
+
+    unsigned long long key_hi = (unsigned long long) key >> 32;
+    unsigned int h0 = (unsigned int) ((key_hi << 32) % M3);
+    unsigned int h1 = (unsigned int) (((key_hi ^ 0xFFFFFFFFull) << 32) % M3);
+
+    /*
+     * floor(v / M3) is (v * mag) >> 47 or one less, for any 32-bit v.
+     */
+    unsigned int mag = (unsigned int) ((1ull << 47) / M3);
+
+    const __m256i zero   = _mm256_setzero_si256();
+    const __m256i v_neg  = neg ? _mm256_set1_epi32(-1) : zero;
+    const __m256i v_klo  = _mm256_set1_epi32((int) key);
+    const __m256i v_mag  = _mm256_set1_epi64x(mag);
+    const __m256i v_m1   = _mm256_set1_epi32((int) M1);
+    const __m256i v_m3   = _mm256_set1_epi32((int) M3);
+    const __m256i v_m3_1 = _mm256_set1_epi32((int) M3 - 1);
+    const __m256i v_h0   = _mm256_set1_epi32((int) h0);
+    const __m256i v_h1   = _mm256_set1_epi32((int) h1);
+    const __m256i v_dy   = _mm256_set1_epi32((int) dy);
+    const __m256i v_dy_w = _mm256_set1_epi32((int) (dy - (unsigned int) M1));
+    const __m256i v_t1   = _mm256_set1_epi32((int) ((unsigned int) M1 - dy - 1));
+    const __m256i v_db   = _mm256_set1_epi32((int) db);
+    const __m256i v_db_w = _mm256_set1_epi32((int) (db - (unsigned int) M2));
+    const __m256i v_t2   = _mm256_set1_epi32((int) ((unsigned int) M2 - db));
+    const __m256i v_w    = _mm256_set1_epi32((int) w);
+    const __m256i v_w_w  = _mm256_set1_epi32((int) (w - (unsigned int) M2));
+    const __m256i v_kp   = _mm256_set1_epi32((int) kp);
+    const __m256i v_kp_w = _mm256_set1_epi32((int) (kp - p));
+    const __m256i v_t3   = _mm256_set1_epi32((int) (p - kp - 1));
+
+    __m256i v_fm = _mm256_loadu_si256((const __m256i *) fm);
+    __m256i v_b  = _mm256_loadu_si256((const __m256i *) b);
+    __m256i v_u  = _mm256_loadu_si256((const __m256i *) u);
+
+    for (; i + 8 <= n; i += 8) {
+
+      /*
+       * Output: (key ^ a ^ b) % M3.
+       */
+      __m256i a_neg = _mm256_andnot_si256(_mm256_cmpeq_epi32(v_fm, zero), v_neg);
+      __m256i a = _mm256_sub_epi32(v_fm, _mm256_and_si256(a_neg, v_m1));
+      __m256i v = _mm256_xor_si256(_mm256_xor_si256(v_klo, a), v_b);
+      __m256i q_even = _mm256_srli_epi64(_mm256_mul_epu32(v, v_mag), 47);
+      __m256i q_odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(v, 32), v_mag), 47);
+      __m256i q = _mm256_blend_epi32(q_even, _mm256_slli_epi64(q_odd, 32), 0xAA);
+      __m256i r = _mm256_sub_epi32(v, _mm256_mullo_epi32(q, v_m3));
+      r = _mm256_sub_epi32(r, _mm256_and_si256(_mm256_cmpgt_epi32(r, v_m3_1), v_m3));
+      r = _mm256_add_epi32(r, _mm256_blendv_epi8(v_h0, v_h1, a_neg));
+      r = _mm256_sub_epi32(r, _mm256_and_si256(_mm256_cmpgt_epi32(r, v_m3_1), v_m3));
+      _mm256_storeu_si256((__m256i *) (ks + i), r);
+
+      /*
+       * Step: a += dy, b += db, modulo M1 and M2 (b may exceed 2^31).
+       */
+      v_fm = _mm256_add_epi32(v_fm, _mm256_blendv_epi8(v_dy, v_dy_w, _mm256_cmpgt_epi32(v_fm, v_t1)));
+      __m256i b_over = _mm256_cmpeq_epi32(_mm256_max_epu32(v_b, v_t2), v_b);
+      v_b = _mm256_add_epi32(v_b, _mm256_blendv_epi8(v_db, v_db_w, b_over));
+
+      if (track) {
+	__m256i wrapped = _mm256_cmpgt_epi32(v_u, v_t3);
+	v_u = _mm256_add_epi32(v_u, _mm256_blendv_epi8(v_kp, v_kp_w, wrapped));
+	__m256i b_under = _mm256_cmpeq_epi32(_mm256_max_epu32(v_b, v_w), v_b);
+	v_b = _mm256_sub_epi32(v_b, _mm256_and_si256(wrapped, _mm256_blendv_epi8(v_w_w, v_w, b_under)));
+      }
+    }
+  }
+
+  keystream_shifted(ks + i, n - i, key, offset + i, s);
+}
+
+/*
+ * Splits the offsets into runs for keystream_avx2_run().
+ */
+__attribute__((target("avx2")))
+static void keystream_avx2(int *ks, int n, long long key, long long offset, long long session_key)
+{
+  int s = shift_count(session_key);
+
+  while (n > 0) {
+
+    /*
+     * y changes sign with bit 36 of offset + key.
+     */
+    unsigned long long x = (unsigned long long) offset + (unsigned long long) key;
+    unsigned long long len = (x | ((1ull << 36) - 1)) + 1 - x;
+
+    if (s <= 32) {
+      unsigned long long mask = ~0ull >> s;
+      unsigned long long to_wrap = mask - ((unsigned long long) offset & mask) + 1; /* 0: 2^64 */
+      if (to_wrap && to_wrap < len)
+	len = to_wrap;
+    }
+
+    int m = len < (unsigned long long) n ? (int) len : n;
+    keystream_avx2_run(ks, m, key, offset, s);
+    ks     += m;
+    offset += m;
+    n      -= m;
+  }
+}
+
+#endif /* KEYSTREAM_AVX2 */
+
+typedef void (*keystream_fn)(int *ks, int n, long long key, long long offset, long long session_key);
+
+static keystream_fn keystream_pick()
+{
+#ifdef KEYSTREAM_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return keystream_avx2;
+#endif
+  return keystream_scalar;
+}
+
+/*
+ * Chosen once, before any worker thread starts.
+ */
+static const keystream_fn keystream_impl = keystream_pick();
+
+void keystream(int *ks, int n, long long key, long long offset, long long session_key)
+{
+  keystream_impl(ks, n, key, offset, session_key);
+}
+
+void keystream_xor(char *buf, int len, long long key, long long offset, long long session_key)
+{
+  int ks[KEYSTREAM_CHUNK];
+
+  for (int done = 0; done < len; done += KEYSTREAM_CHUNK) {
+    int n = len - done < KEYSTREAM_CHUNK ? len - done : KEYSTREAM_CHUNK;
+    keystream_impl(ks, n, key, offset + done, session_key);
+    for (int i = 0; i < n; ++i)
+      buf[done + i] ^= (ks[i] & 0xff);
+  }
+}
+
+/* Eof: keystream.cc */
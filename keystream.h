@@ -0,0 +1,30 @@
+/*
+  keystream.h
+
+  $Id: keystream.h,v 1.1 2026/10/17 18:02:11 cvs Exp $
+ */
+
+#ifndef KEYSTREAM_H
+#define KEYSTREAM_H
+
+/*
+ * Values worth computing at once.
+ */
+#define KEYSTREAM_CHUNK 512
+
+int pseudo_rand_key_offset(long long key, long long offset, long long session_key);
+
+/*
+ * ks[i] = pseudo_rand_key_offset(key, offset + i, session_key),
+ * for i in [0, n).
+ */
+void keystream(int *ks, int n, long long key, long long offset, long long session_key);
+
+/*
+ * XORs buf[i] with the low byte of the same values.
+ */
+void keystream_xor(char *buf, int len, long long key, long long offset, long long session_key);
+
+#endif /* KEYSTREAM_H */
+
+/* Eof: keystream.h */
@@ -0,0 +1,422 @@
+/*
+  keystream2.cc
+
+  $Id: keystream2.cc,v 1.1 2026/10/17 20:31:47 cvs Exp $
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KEYSTREAM2_AVX2
+#endif
+
+#include "keystream2.h"
+
+/*
+ * ChaCha20 with a 64-bit block counter and a 64-bit nonce, the nonce
+ * telling the streams apart. The key is made of the XOR key, the
+ * confusing key and both session keys.
+ */
+enum {
+  KS2_DATA   = 0,  /* XORed with every byte, inserted ones included */
+  KS2_DENSE  = 1,  /* insertion maps, first blocks */
+  KS2_TAG    = 2,  /* tags of session keys */
+  KS2_SPARSE = 3   /* insertion maps, further blocks */
+};
+
+/*
+ * Blocks computed at once: a multiple of the vector width.
+ */
+#define KS2_BATCH 32
+
+/*
+ * Insertion maps have bit i set when byte i of a block is inserted.
+ *
+ * In the first KS2_DENSE_BLOCKS blocks, about one byte in 4 is, which
+ * hides the size of short exchanges as version 1 does: each map ANDs
+ * two words of a block of its own. Further on, 64 bits drawn for each
+ * block (8 blocks per block of the stream) place 4 candidates, each
+ * kept or not: about one byte in 32.
+ */
+#define KS2_DENSE_BLOCKS 1024
+
+typedef unsigned int u32x4 __attribute__((vector_size(16)));
+
+#define ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define ROTL16(v) ROTL(v, 16)
+#define ROTL8(v)  ROTL(v, 8)
+
+#define QUARTER(a, b, c, d)			\
+  a += b; d ^= a; d = ROTL16(d);		\
+  c += d; b ^= c; b = ROTL(b, 12);		\
+  a += b; d ^= a; d = ROTL8(d);			\
+  c += d; b ^= c; b = ROTL(b, 7);
+
+#define DOUBLE_ROUND(x)				\
+  QUARTER(x[0], x[4], x[8],  x[12]);		\
+  QUARTER(x[1], x[5], x[9],  x[13]);		\
+  QUARTER(x[2], x[6], x[10], x[14]);		\
+  QUARTER(x[3], x[7], x[11], x[15]);		\
+  QUARTER(x[0], x[5], x[10], x[15]);		\
+  QUARTER(x[1], x[6], x[11], x[12]);		\
+  QUARTER(x[2], x[7], x[8],  x[13]);		\
+  QUARTER(x[3], x[4], x[9],  x[14]);
+
+static const unsigned int sigma[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 }; /* "expand 32-byte k" */
+
+/*
+ * Four consecutive blocks from "block" on, one per vector lane: 64
+ * words to out.
+ */
+static void chacha20_4(const unsigned int k[8], unsigned int stream, unsigned long long block, unsigned int *out)
+{
+  u32x4 s[16];
+
+  for (int i = 0; i < 4; ++i)
+    s[i] = (u32x4) { sigma[i], sigma[i], sigma[i], sigma[i] };
+  for (int i = 0; i < 8; ++i)
+    s[4 + i] = (u32x4) { k[i], k[i], k[i], k[i] };
+  for (int l = 0; l < 4; ++l) {
+    s[12][l] = (unsigned int) (block + l);
+    s[13][l] = (unsigned int) ((block + l) >> 32);
+  }
+  s[14] = (u32x4) { stream, stream, stream, stream };
+  s[15] = (u32x4) { 0, 0, 0, 0 };
+
+  u32x4 x[16];
+  for (int i = 0; i < 16; ++i)
+    x[i] = s[i];
+
+  for (int r = 0; r < 10; ++r) {
+    DOUBLE_ROUND(x);
+  }
+
+  for (int i = 0; i < 16; ++i)
+    x[i] += s[i];
+
+  /*
+   * Transposes 4 words at a time from lanes to blocks.
+   */
+  for (int i = 0; i < 16; i += 4) {
+    u32x4 t0 = __builtin_shuffle(x[i],     x[i + 1], (u32x4) { 0, 4, 1, 5 });
+    u32x4 t1 = __builtin_shuffle(x[i],     x[i + 1], (u32x4) { 2, 6, 3, 7 });
+    u32x4 t2 = __builtin_shuffle(x[i + 2], x[i + 3], (u32x4) { 0, 4, 1, 5 });
+    u32x4 t3 = __builtin_shuffle(x[i + 2], x[i + 3], (u32x4) { 2, 6, 3, 7 });
+    u32x4 b0 = __builtin_shuffle(t0, t2, (u32x4) { 0, 1, 4, 5 });
+    u32x4 b1 = __builtin_shuffle(t0, t2, (u32x4) { 2, 3, 6, 7 });
+    u32x4 b2 = __builtin_shuffle(t1, t3, (u32x4) { 0, 1, 4, 5 });
+    u32x4 b3 = __builtin_shuffle(t1, t3, (u32x4) { 2, 3, 6, 7 });
+    memcpy(out + i,      &b0, 16);
+    memcpy(out + 16 + i, &b1, 16);
+    memcpy(out + 32 + i, &b2, 16);
+    memcpy(out + 48 + i, &b3, 16);
+  }
+}
+
+#ifdef KEYSTREAM2_AVX2
+
+typedef unsigned int  u32x8 __attribute__((vector_size(32)));
+typedef unsigned char u8x32 __attribute__((vector_size(32)));
+
+/*
+ * Same as chacha20_4() for 8 blocks, with byte shuffles for the
+ * rotations by 16 and 8.
+ */
+__attribute__((target("avx2")))
+static void chacha20_8(const unsigned int k[8], unsigned int stream, unsigned long long block, unsigned int *out)
+{
+#undef ROTL16
+#undef ROTL8
+#define ROTL16(v) ((u32x8) __builtin_shuffle((u8x32) (v), (u8x32) {	\
+	2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,		\
+	18, 19, 16, 17, 22, 23, 20, 21, 26, 27, 24, 25, 30, 31, 28, 29 }))
+#define ROTL8(v) ((u32x8) __builtin_shuffle((u8x32) (v), (u8x32) {	\
+	3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,		\
+	19, 16, 17, 18, 23, 20, 21, 22, 27, 24, 25, 26, 31, 28, 29, 30 }))
+
+  u32x8 s[16];
+
+  for (int i = 0; i < 4; ++i)
+    s[i] = (u32x8) { sigma[i], sigma[i], sigma[i], sigma[i], sigma[i], sigma[i], sigma[i], sigma[i] };
+  for (int i = 0; i < 8; ++i)
+    s[4 + i] = (u32x8) { k[i], k[i], k[i], k[i], k[i], k[i], k[i], k[i] };
+  for (int l = 0; l < 8; ++l) {
+    s[12][l] = (unsigned int) (block + l);
+    s[13][l] = (unsigned int) ((block + l) >> 32);
+  }
+  s[14] = (u32x8) { stream, stream, stream, stream, stream, stream, stream, stream };
+  s[15] = (u32x8) { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+  u32x8 x[16];
+  for (int i = 0; i < 16; ++i)
+    x[i] = s[i];
+
+  for (int r = 0; r < 10; ++r) {
+    DOUBLE_ROUND(x);
+  }
+
+  unsigned int w[16][8];
+  for (int i = 0; i < 16; ++i) {
+    x[i] += s[i];
+    memcpy(w[i], &x[i], sizeof(w[i]));
+  }
+  for (int l = 0; l < 8; ++l)
+    for (int i = 0; i < 16; ++i)
+      out[l * 16 + i] = w[i][l];
+}
+
+__attribute__((target("avx2")))
+static void blocks_avx2(const unsigned int k[8], unsigned int stream, unsigned long long block, int n, unsigned int *out)
+{
+  for (int i = 0; i < n; i += 8)
+    chacha20_8(k, stream, block + i, out + i * 16);
+}
+
+#endif /* KEYSTREAM2_AVX2 */
+
+static void blocks_generic(const unsigned int k[8], unsigned int stream, unsigned long long block, int n, unsigned int *out)
+{
+  for (int i = 0; i < n; i += 4)
+    chacha20_4(k, stream, block + i, out + i * 16);
+}
+
+typedef void (*blocks_fn)(const unsigned int k[8], unsigned int stream, unsigned long long block, int n, unsigned int *out);
+
+static blocks_fn blocks_pick()
+{
+#ifdef KEYSTREAM2_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return blocks_avx2;
+#endif
+  return blocks_generic;
+}
+
+/*
+ * Chosen once, before any worker thread starts.
+ */
+static const blocks_fn blocks_impl = blocks_pick();
+
+/*
+ * "n" blocks, rounded up to a multiple of 8: 16 words each to out.
+ */
+static void ks2_blocks(const ks2_key *ks, unsigned int stream, unsigned long long block, int n, unsigned int *out)
+{
+  blocks_impl(ks->k, stream, block, n, out);
+}
+
+/*
+ * The i-th 64 bit word of keystream words w, loaded without aliasing
+ * them.
+ */
+static inline unsigned long long ks2_word(const unsigned int *w, unsigned long long i)
+{
+  unsigned long long q;
+  memcpy(&q, w + 2 * i, sizeof(q));
+  return q;
+}
+
+static inline unsigned long long ks2_sparse_map(unsigned long long r)
+{
+  unsigned long long m = 0;
+  for (int c = 0; c < 4; ++c)
+    if (r >> (24 + c) & 1)
+      m |= 1ull << (r >> (6 * c) & 63);
+  return m;
+}
+
+/*
+ * Keystream and insertion maps of n blocks from "block" on, n being
+ * cut short at the end of the dense blocks.
+ */
+struct ks2_batch {
+  int                n;
+  unsigned int       data[KS2_BATCH * 16];
+  unsigned long long map[KS2_BATCH];
+};
+
+static void ks2_fill(const ks2_key *ks, ks2_batch *bt, unsigned long long block, int n)
+{
+  if (block < KS2_DENSE_BLOCKS && (unsigned long long) n > KS2_DENSE_BLOCKS - block)
+    n = (int) (KS2_DENSE_BLOCKS - block);
+  bt->n = n;
+
+  ks2_blocks(ks, KS2_DATA, block, n, bt->data);
+
+  if (!ks->confuse) {
+    for (int b = 0; b < n; ++b)
+      bt->map[b] = 0;
+    return;
+  }
+
+  unsigned int w[KS2_BATCH * 16];
+
+  if (block < KS2_DENSE_BLOCKS) {
+    ks2_blocks(ks, KS2_DENSE, block, n, w);
+    for (int b = 0; b < n; ++b)
+      bt->map[b] = ks2_word(w, b * 8) & ks2_word(w, b * 8 + 1);
+  }
+  else {
+    unsigned long long first = block / 8;
+    ks2_blocks(ks, KS2_SPARSE, first, (int) ((block + n - 1) / 8 - first) + 1, w);
+    for (int b = 0; b < n; ++b)
+      bt->map[b] = ks2_sparse_map(ks2_word(w, block + b - first * 8));
+  }
+}
+
+/*
+ * dst[j] = src[j] ^ k[j] for j in [0, c), a word at a time; dst may
+ * be src or lie before it.
+ */
+static inline void ks2_xor(char *dst, const char *src, const unsigned char *k, int c)
+{
+  int j = 0;
+  for (; j + 8 <= c; j += 8) {
+    unsigned long long a, b;
+    memcpy(&a, src + j, 8);
+    memcpy(&b, k + j, 8);
+    a ^= b;
+    memcpy(dst + j, &a, 8);
+  }
+  for (; j < c; ++j)
+    dst[j] = src[j] ^ k[j];
+}
+
+/*
+ * Bytes from i on up to the next insertion in map m, or the block end.
+ */
+static inline int ks2_run(unsigned long long m, int i)
+{
+  unsigned long long rest = m >> i;
+  return rest ? __builtin_ctzll(rest) : 64 - i;
+}
+
+static void ks2_key_words(ks2_key *ks, long long XOR_key, long long confusing_key, long long key, long long other)
+{
+  unsigned long long w[4] = {
+    (unsigned long long) XOR_key,
+    (unsigned long long) confusing_key,
+    (unsigned long long) key,
+    (unsigned long long) other
+  };
+
+  for (int i = 0; i < 4; ++i) {
+    ks->k[2 * i]     = (unsigned int) w[i];
+    ks->k[2 * i + 1] = (unsigned int) (w[i] >> 32);
+  }
+  ks->confuse = confusing_key != 0;
+}
+
+static unsigned int ks2_tag(long long XOR_key, long long confusing_key, unsigned int nonce)
+{
+  ks2_key ks;
+  unsigned int out[64];
+
+  ks2_key_words(&ks, XOR_key, confusing_key, 0, 0);
+  chacha20_4(ks.k, KS2_TAG, nonce, out);
+  return out[0];
+}
+
+long long ks2_own_key(long long XOR_key, long long confusing_key, unsigned int nonce)
+{
+  unsigned long long tag = ks2_tag(XOR_key, confusing_key, nonce);
+  return (long long) ((tag << 32) | nonce);
+}
+
+int ks2_tagged(long long key, long long XOR_key, long long confusing_key)
+{
+  unsigned long long k = (unsigned long long) key;
+  return ks2_tag(XOR_key, confusing_key, (unsigned int) k) == (unsigned int) (k >> 32);
+}
+
+void ks2_setup(ks2_key *ks, long long XOR_key, long long confusing_key, long long key, long long other)
+{
+  ks2_key_words(ks, XOR_key, confusing_key, key, other);
+}
+
+int ks2_inflate(const ks2_key *ks, unsigned long long *offset, const char *in, int len, char *out, int out_size, int *used)
+{
+  ks2_batch bt;
+  int rd = 0;
+  int wr = 0;
+
+  while (rd < len && wr < out_size) {
+
+    /*
+     * Blocks likely needed, counting a few insertions.
+     */
+    int n = (int) ((*offset % 64 + (len - rd) + (len - rd) / 8 + 63) / 64);
+    if (n > KS2_BATCH)
+      n = KS2_BATCH;
+    ks2_fill(ks, &bt, *offset / 64, n);
+
+    for (int b = 0; b < bt.n && rd < len && wr < out_size; ++b) {
+      const unsigned char *k = (const unsigned char *) (bt.data + b * 16);
+      unsigned long long m = bt.map[b];
+      int i = *offset % 64;
+      int start = i;
+
+      while (i < 64 && rd < len && wr < out_size) {
+	if (m >> i & 1) {
+	  out[wr++] = k[i++];
+	  continue;
+	}
+	int c = ks2_run(m, i);
+	if (c > len - rd)
+	  c = len - rd;
+	if (c > out_size - wr)
+	  c = out_size - wr;
+	ks2_xor(out + wr, in + rd, k + i, c);
+	rd += c;
+	wr += c;
+	i  += c;
+      }
+
+      *offset += i - start;
+    }
+  }
+
+  *used = rd;
+  return wr;
+}
+
+int ks2_deflate(const ks2_key *ks, unsigned long long *offset, char *buf, int len)
+{
+  ks2_batch bt;
+  int rd = 0;
+  int wr = 0;
+
+  while (rd < len) {
+    int n = (int) ((*offset % 64 + (len - rd) + 63) / 64);
+    if (n > KS2_BATCH)
+      n = KS2_BATCH;
+    ks2_fill(ks, &bt, *offset / 64, n);
+
+    for (int b = 0; b < bt.n && rd < len; ++b) {
+      const unsigned char *k = (const unsigned char *) (bt.data + b * 16);
+      unsigned long long m = bt.map[b];
+      int i = *offset % 64;
+      int end = 64 - i < len - rd ? 64 : i + len - rd;
+
+      *offset += end - i;
+      while (i < end) {
+	if (m >> i & 1) {
+	  ++i;
+	  ++rd;
+	  continue;
+	}
+	int c = ks2_run(m, i);
+	if (c > end - i)
+	  c = end - i;
+	ks2_xor(buf + wr, buf + rd, k + i, c);
+	rd += c;
+	wr += c;
+	i  += c;
+      }
+    }
+  }
+
+  return wr;
+}
+
+/* Eof: keystream2.cc */
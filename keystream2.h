@@ -0,0 +1,57 @@
+/*
+  keystream2.h
+
+  $Id: keystream2.h,v 1.1 2026/10/17 20:31:47 cvs Exp $
+ */
+
+#ifndef KEYSTREAM2_H
+#define KEYSTREAM2_H
+
+/*
+ * Wire protocol version 2: the inflated stream is ChaCha20 in counter
+ * mode, one 64-byte block of keystream and one of insertion map per
+ * 64 bytes. Peers agree on it during the session key exchange (see
+ * ks2_own_key()); others keep to version 1 (keystream.h).
+ */
+struct ks2_key {
+  unsigned int k[8];
+  int          confuse;  /* insertions, as with a confusing key */
+};
+
+/*
+ * Session key to send: 32 random bits and a tag telling version 2
+ * peers apart, which version 1 peers take for random bits as well.
+ */
+long long ks2_own_key(long long XOR_key, long long confusing_key, unsigned int nonce);
+
+/*
+ * Whether the key a peer sent comes from ks2_own_key().
+ */
+int ks2_tagged(long long key, long long XOR_key, long long confusing_key);
+
+/*
+ * Key for one direction: "key" is the session key of the side whose
+ * output is inflated, "other" the session key of its peer.
+ */
+void ks2_setup(ks2_key *ks, long long XOR_key, long long confusing_key, long long key, long long other);
+
+/*
+ * Inflates "len" bytes of "in" into at most out_size bytes of "out",
+ * from inflated offset *offset on. Stops once the input is used up or
+ * the output full; *used tells how much input went in.
+ *
+ * Returns the number of bytes written to "out".
+ */
+int ks2_inflate(const ks2_key *ks, unsigned long long *offset, const char *in, int len, char *out, int out_size, int *used);
+
+/*
+ * Undoes ks2_inflate() in place on "len" bytes of "buf" found at
+ * inflated offset *offset.
+ *
+ * Returns the number of bytes left in "buf".
+ */
+int ks2_deflate(const ks2_key *ks, unsigned long long *offset, char *buf, int len);
+
+#endif /* KEYSTREAM2_H */
+
+/* Eof: keystream2.h */
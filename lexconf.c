@@ -571,6 +571,7 @@ char *yytext_ptr;
 #line 8 "conf.lex"
 
 #include <stdio.h>
+#include <string.h>
 #include <syslog.h>
 
   /* Incluir antes de "yconf.h" */
@@ -646,9 +647,69 @@ void conf_error(const char *msg)
   show_last_token();
 }
 
+/*
+ * Tuning options are scanned as plain names and then looked up here,
+ * which keeps the scanner tables the same as the option set grows.
+ * conf.y takes these tokens for names wherever it expects a name (see
+ * "ident"), so the words are not reserved.
+ */
+struct conf_keyword {
+  const char *name;
+  int        token;
+};
+
+static const struct conf_keyword keyword_tab[] =
+{
+  { "workers",           TK_WORKERS },
+  { "cpu-affinity",      TK_CPU_AFFINITY },
+  { "io-uring",          TK_IO_URING },
+  { "connect-timeout",   TK_CONNECT_TIMEOUT },
+  { "handshake-timeout", TK_HANDSHAKE_TIMEOUT },
+  { "plain",             TK_PLAIN },
+  { "eject-after",       TK_EJECT_AFTER },
+  { "health-check",      TK_HEALTH_CHECK },
+  { "failover",          TK_FAILOVER },
+  { "round-robin",       TK_ROUND_ROBIN },
+  { "least-conn",        TK_LEAST_CONN },
+  { "least-latency",     TK_LEAST_LATENCY },
+  { "weight",            TK_WEIGHT },
+  { "warm-pool",         TK_WARM_POOL },
+  { "mux",               TK_MUX },
+  { "fast-open",         TK_FAST_OPEN },
+  { "pipeline-keys",     TK_PIPELINE_KEYS },
+  { "backlog",           TK_BACKLOG },
+  { "nodelay",           TK_NODELAY },
+  { "send-buffer",       TK_SEND_BUFFER },
+  { "receive-buffer",    TK_RECEIVE_BUFFER },
+  { "keepalive",         TK_KEEPALIVE },
+  { "notsent-lowat",     TK_NOTSENT_LOWAT },
+  { "max-connections",   TK_MAX_CONNECTIONS },
+  { "max-per-source",    TK_MAX_PER_SOURCE },
+  { "idle-timeout",      TK_IDLE_TIMEOUT },
+  { "session-timeout",   TK_SESSION_TIMEOUT },
+  { "accept-rate",       TK_ACCEPT_RATE },
+  { "accept-burst",      TK_ACCEPT_BURST },
+  { "accept-prefix",     TK_ACCEPT_PREFIX },
+  { "dns-ttl",           TK_DNS_TTL },
+  { "dns-negative-ttl",  TK_DNS_NEGATIVE_TTL },
+  { "dns-stale",         TK_DNS_STALE },
+  { 0,                   TK_NAME }
+};
+
+static int name_token(const char *name)
+{
+  const struct conf_keyword *k;
+
+  for (k = keyword_tab; k->name; ++k)
+    if (!strcmp(k->name, name))
+      break;
+
+  return k->token;
+}
+
 
 
-#line 652 "<stdout>"
+#line 713 "<stdout>"
 
 #define INITIAL 0
 #define Comment 1
@@ -868,14 +929,14 @@ YY_DECL
 		}
 
 	{
-#line 94 "conf.lex"
+#line 155 "conf.lex"
 
 
 
 		/* Reserved Symbols */
 
 
-#line 879 "<stdout>"
+#line 940 "<stdout>"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -934,97 +995,97 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 100 "conf.lex"
+#line 161 "conf.lex"
 return trap_tk(TK_TCP);
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 101 "conf.lex"
+#line 162 "conf.lex"
 return trap_tk(TK_UDP);
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 102 "conf.lex"
+#line 163 "conf.lex"
 return trap_tk(TK_FRAGILE);
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 104 "conf.lex"
+#line 165 "conf.lex"
 return trap_tk(TK_COLON);
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 105 "conf.lex"
+#line 166 "conf.lex"
 return trap_tk(TK_SCOLON);
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 106 "conf.lex"
+#line 167 "conf.lex"
 return trap_tk(TK_COMMA);
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 107 "conf.lex"
+#line 168 "conf.lex"
 return trap_tk(TK_SLASH);
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 108 "conf.lex"
+#line 169 "conf.lex"
 return trap_tk(TK_RANGE);
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 109 "conf.lex"
+#line 170 "conf.lex"
 return trap_tk(TK_LBRACE);
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 110 "conf.lex"
+#line 171 "conf.lex"
 return trap_tk(TK_RBRACE);
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 111 "conf.lex"
+#line 172 "conf.lex"
 return trap_tk(TK_ARROW);
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 113 "conf.lex"
+#line 174 "conf.lex"
 return trap_tk(TK_ACTV);
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 114 "conf.lex"
+#line 175 "conf.lex"
 return trap_tk(TK_PASV);
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 115 "conf.lex"
+#line 176 "conf.lex"
 return trap_tk(TK_USER);
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 116 "conf.lex"
+#line 177 "conf.lex"
 return trap_tk(TK_GROUP);
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 117 "conf.lex"
+#line 178 "conf.lex"
 return trap_tk(TK_XOR_KEY);
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 118 "conf.lex"
+#line 179 "conf.lex"
 return trap_tk(TK_CONFUSING_KEY);
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 119 "conf.lex"
+#line 180 "conf.lex"
 return trap_tk(TK_REMOTE_SERVER);
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 120 "conf.lex"
+#line 181 "conf.lex"
 { 
                     syslog(LOG_ERR, "Found deprecated 'bind-address' token at line %d, please use 'listen-on' instead", conf_line_number);
                     return trap_tk(TK_BIND);
@@ -1032,12 +1093,12 @@ YY_RULE_SETUP
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 124 "conf.lex"
+#line 185 "conf.lex"
 return trap_tk(TK_LISTEN);
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 125 "conf.lex"
+#line 186 "conf.lex"
 return trap_tk(TK_SOURCE);
 	YY_BREAK
 
@@ -1045,10 +1106,10 @@ return trap_tk(TK_SOURCE);
 
 case 22:
 YY_RULE_SETUP
-#line 131 "conf.lex"
+#line 192 "conf.lex"
 {
 		safe_strcpy(conf_ident, yytext, IDENT_BUF_SIZE);
-  		return trap_tk(TK_NAME);
+  		return trap_tk(name_token(yytext));
 		}
 	YY_BREAK
 
@@ -1056,13 +1117,13 @@ YY_RULE_SETUP
 
 case 23:
 YY_RULE_SETUP
-#line 140 "conf.lex"
+#line 201 "conf.lex"
 /* Ignore */
 	YY_BREAK
 case 24:
 /* rule 24 can match eol */
 YY_RULE_SETUP
-#line 141 "conf.lex"
+#line 202 "conf.lex"
 ++conf_line_number;
 	YY_BREAK
 
@@ -1070,7 +1131,7 @@ YY_RULE_SETUP
 
 case 25:
 YY_RULE_SETUP
-#line 147 "conf.lex"
+#line 208 "conf.lex"
 {
                 BEGIN(String);
 		conf_lex_str_curr = conf_lex_str_buf;
@@ -1079,7 +1140,7 @@ YY_RULE_SETUP
 case 26:
 /* rule 26 can match eol */
 YY_RULE_SETUP
-#line 151 "conf.lex"
+#line 212 "conf.lex"
 {
                 ++conf_line_number;
 		STR_CHAR(*yytext);
@@ -1088,12 +1149,12 @@ YY_RULE_SETUP
 case 27:
 /* rule 27 can match eol */
 YY_RULE_SETUP
-#line 155 "conf.lex"
+#line 216 "conf.lex"
 STR_CHAR(*yytext);
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 156 "conf.lex"
+#line 217 "conf.lex"
 {
                 BEGIN(INITIAL);
 		STR_CHAR('\0');
@@ -1101,7 +1162,7 @@ YY_RULE_SETUP
                 }
 	YY_BREAK
 case YY_STATE_EOF(String):
-#line 161 "conf.lex"
+#line 222 "conf.lex"
 {
 		conf_error("EOF at unterminated string");
 		return trap_tk(TK_ILLEGAL);
@@ -1112,32 +1173,32 @@ case YY_STATE_EOF(String):
 
 case 29:
 YY_RULE_SETUP
-#line 170 "conf.lex"
+#line 231 "conf.lex"
 ++comment_nesting; BEGIN(Comment);
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 171 "conf.lex"
+#line 232 "conf.lex"
 ++comment_nesting; 
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 172 "conf.lex"
+#line 233 "conf.lex"
 if (!--comment_nesting) BEGIN(INITIAL);
 	YY_BREAK
 case 32:
 /* rule 32 can match eol */
 YY_RULE_SETUP
-#line 173 "conf.lex"
+#line 234 "conf.lex"
 ++conf_line_number;
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 174 "conf.lex"
+#line 235 "conf.lex"
 /* Ignore */
 	YY_BREAK
 case YY_STATE_EOF(Comment):
-#line 175 "conf.lex"
+#line 236 "conf.lex"
 {
 			conf_error("EOF at unterminated comment");
 			return trap_tk(TK_ILLEGAL);
@@ -1148,7 +1209,7 @@ case YY_STATE_EOF(Comment):
 
 case 34:
 YY_RULE_SETUP
-#line 184 "conf.lex"
+#line 245 "conf.lex"
 { 
 		conf_error("Unknown token");
 		return trap_tk(TK_ILLEGAL);
@@ -1156,10 +1217,10 @@ YY_RULE_SETUP
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
-#line 189 "conf.lex"
+#line 250 "conf.lex"
 ECHO;
 	YY_BREAK
-#line 1163 "<stdout>"
+#line 1224 "<stdout>"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -2160,7 +2221,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 189 "conf.lex"
+#line 250 "conf.lex"
 
 
 
@@ -1,4 +1,4 @@
-CC="c++ -O1 -ggdb "
+CC="c++ -O1 -ggdb -pthread "
 rm -f *.o
 for f in `ls *[.]cc |grep -v portfwd.cc|grep -v lex.yy`; do t=`echo $f |sed 's/.cc$//g'`; $CC -o $t.o -c $f   -DPORTFWD_CONF=\"\" ; done
 for f in `ls *[.]c| grep -v lex.yy`; do t=`echo $f |sed 's/[.]c$//g'`; $CC -o $t.o -c $f   -DPORTFWD_CONF=\"\" ; done
@@ -0,0 +1,83 @@
+/*
+  map_opts.h
+
+  $Id: map_opts.h,v 1.1 2026/10/17 10:12:41 cvs Exp $
+ */
+
+#ifndef MAP_OPTS_H
+#define MAP_OPTS_H
+
+/*
+ * Tuning of a TCP map. Like xor-key, each option applies to the
+ * maps that follow it in the configuration file.
+ */
+struct map_opts {
+  int workers;            /* event loops per map, one thread each */
+  int cpu_affinity;       /* pin worker i to CPU i */
+  int io_uring;           /* event loops on io_uring rather than epoll */
+  int connect_timeout;    /* seconds per destination */
+  int handshake_timeout;  /* seconds for the session key exchange */
+  int plain;              /* no session keys nor XOR: splice() as is */
+  int eject_after;        /* failures in a row taking a destination down */
+  int health_check;       /* seconds between probes of those down */
+  int warm_pool;          /* local side: connections keyed in advance */
+  int mux;                /* tunnels carrying all clients; remote side: port takes tunnels only */
+  int fast_open;          /* TCP Fast Open: queue of listeners, and local side key exchanges; 0: off */
+  int pipeline_keys;      /* remote server: session key sent before connecting; either end alone */
+  int backlog;            /* listen() queue */
+  int nodelay;            /* TCP_NODELAY on client and destination sockets */
+  int send_buffer;        /* SO_SNDBUF, bytes; 0: system default */
+  int receive_buffer;     /* SO_RCVBUF, bytes; 0: system default */
+  int keepalive;          /* seconds idle before probing the peer; 0: off */
+  int notsent_lowat;      /* TCP_NOTSENT_LOWAT, bytes; 0: system default */
+  int max_connections;    /* clients served at once; 0: no limit */
+  int max_per_source;     /* of those, from one address; 0: no limit */
+  int idle_timeout;       /* seconds without traffic before closing a session; 0: none */
+  int session_timeout;    /* seconds a session may last; 0: forever */
+  int accept_rate;        /* clients accepted per second from one prefix; 0: no limit */
+  int accept_burst;       /* of those, at once; 0: accept_rate */
+  int accept_prefix;      /* bits of the source address making a prefix */
+  int dns_ttl;            /* --on-the-fly-dns: seconds a destination address is good for */
+  int dns_negative_ttl;   /* seconds between attempts to solve it after a failure */
+  int dns_stale;          /* seconds its last address is served past dns_ttl */
+};
+
+inline struct map_opts default_map_opts()
+{
+  struct map_opts opts;
+
+  opts.workers           = 1;
+  opts.cpu_affinity      = 0;
+  opts.io_uring          = 0;
+  opts.connect_timeout   = 10;
+  opts.handshake_timeout = 10;
+  opts.plain             = 0;
+  opts.eject_after       = 3;
+  opts.health_check      = 0;
+  opts.warm_pool         = 0;
+  opts.mux               = 0;
+  opts.fast_open         = 0;
+  opts.pipeline_keys     = 0;
+  opts.backlog           = 128;
+  opts.nodelay           = 0;
+  opts.send_buffer       = 0;
+  opts.receive_buffer    = 0;
+  opts.keepalive         = 0;
+  opts.notsent_lowat     = 0;
+  opts.max_connections   = 0;
+  opts.max_per_source    = 0;
+  opts.idle_timeout      = 0;
+  opts.session_timeout   = 0;
+  opts.accept_rate       = 0;
+  opts.accept_burst      = 0;
+  opts.accept_prefix     = 32;
+  opts.dns_ttl           = 60;
+  opts.dns_negative_ttl  = 5;
+  opts.dns_stale         = 300;
+
+  return opts;
+}
+
+#endif /* MAP_OPTS_H */
+
+/* Eof: map_opts.h */
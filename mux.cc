@@ -0,0 +1,124 @@
+/*
+  mux.cc
+
+  $Id: mux.cc,v 1.1 2026/10/17 22:40:12 cvs Exp $
+ */
+
+#include <string.h>
+#include <syslog.h>
+
+#include "mux.h"
+
+void mux_header(char *h, unsigned int id, int type, int len)
+{
+  h[0] = (char) (id >> 24);
+  h[1] = (char) (id >> 16);
+  h[2] = (char) (id >> 8);
+  h[3] = (char) id;
+  h[4] = (char) type;
+  h[5] = 0;
+  h[6] = (char) (len >> 8);
+  h[7] = (char) len;
+}
+
+void mux_reader_init(mux_reader *r)
+{
+  r->header_len = 0;
+  r->left       = 0;
+  r->small_len  = 0;
+}
+
+static unsigned int get_u32(const char *p)
+{
+  const unsigned char *u = (const unsigned char *) p;
+  return ((unsigned int) u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+/*
+ * Payload lengths allowed for each type.
+ */
+static int valid_len(int type, int len)
+{
+  switch (type) {
+  case MUX_HELLO:
+    return len == 1;
+  case MUX_WINDOW:
+    return len == 4;
+  case MUX_OPEN:
+  case MUX_CLOSE:
+    return len == 0;
+  case MUX_DATA:
+    return len > 0;
+  }
+  return 0;
+}
+
+int mux_read(mux_reader *r, const char *buf, int len, mux_frame *f, int *ready)
+{
+  int used = 0;
+  *ready = 0;
+
+  if (r->header_len < MUX_HEADER) {
+    int n = MUX_HEADER - r->header_len;
+    if (n > len)
+      n = len;
+    memcpy(r->header + r->header_len, buf, n);
+    r->header_len += n;
+    used += n;
+    if (r->header_len < MUX_HEADER)
+      return used;
+
+    const unsigned char *h = (const unsigned char *) r->header;
+    r->id        = get_u32(r->header);
+    r->type      = h[4];
+    r->left      = (h[6] << 8) | h[7];
+    r->small_len = 0;
+    if (!valid_len(r->type, r->left)) {
+      syslog(LOG_ERR, "Multiplexed tunnel: Malformed frame: type %d, length %d", r->type, r->left);
+      return -1;
+    }
+  }
+
+  f->id    = r->id;
+  f->type  = r->type;
+  f->data  = 0;
+  f->len   = 0;
+  f->value = 0;
+
+  if (r->type == MUX_DATA) {
+    int n = len - used;
+    if (n > r->left)
+      n = r->left;
+    if (!n)
+      return used;
+    f->data = buf + used;
+    f->len  = n;
+    r->left -= n;
+    used += n;
+    *ready = 1;
+  }
+  else {
+    int n = len - used;
+    if (n > r->left)
+      n = r->left;
+    memcpy(r->small + r->small_len, buf + used, n);
+    r->small_len += n;
+    r->left -= n;
+    used += n;
+    if (r->left)
+      return used;
+
+    if (r->type == MUX_HELLO)
+      f->value = (unsigned char) r->small[0];
+    else if (r->type == MUX_WINDOW)
+      f->value = get_u32(r->small);
+    *ready = 1;
+  }
+
+  if (!r->left)
+    r->header_len = 0;
+
+  return used;
+}
+
+/* Eof: mux.cc */
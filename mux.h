@@ -0,0 +1,84 @@
+/*
+  mux.h
+
+  $Id: mux.h,v 1.1 2026/10/17 22:40:12 cvs Exp $
+ */
+
+#ifndef MUX_H
+#define MUX_H
+
+/*
+ * Frames of a multiplexed tunnel: many streams, each a client
+ * connection, over one connection between the local and the remote
+ * server. Frames go through the session transform like any other
+ * bytes of the connection.
+ *
+ * Header: stream id (4 bytes), type (1), unused (1), payload length
+ * (2), in network byte order.
+ */
+const int MUX_HEADER = 8;
+
+enum mux_type {
+  MUX_HELLO,   /* first frame each way; payload: MUX_VERSION (1 byte) */
+  MUX_OPEN,    /* local side: new stream */
+  MUX_DATA,    /* stream bytes, within the window of the receiver */
+  MUX_WINDOW,  /* receiver consumed that many more bytes (4 bytes) */
+  MUX_CLOSE    /* stream over: sender is done with it */
+};
+
+const int MUX_VERSION = 1;
+
+/*
+ * Most payload of frames other than MUX_DATA.
+ */
+const int MUX_SMALL = 4;
+
+/*
+ * Bytes a stream may send ahead of the receiver's window updates.
+ */
+const int MUX_WINDOW_SZ = 256 * 1024;
+
+/*
+ * Writes a header for a frame of "len" payload bytes into "h".
+ */
+void mux_header(char *h, unsigned int id, int type, int len);
+
+/*
+ * A frame, or a piece of one: MUX_DATA payloads are handed out as
+ * they arrive.
+ */
+struct mux_frame {
+  unsigned int id;
+  int          type;
+  const char   *data;
+  int          len;
+  unsigned int value;  /* MUX_HELLO, MUX_WINDOW: payload */
+};
+
+/*
+ * Reassembles frames from the bytes read off a tunnel.
+ */
+struct mux_reader {
+  char         header[MUX_HEADER];
+  int          header_len;
+  unsigned int id;
+  int          type;
+  int          left;    /* payload bytes still to come */
+  char         small[MUX_SMALL];
+  int          small_len;
+};
+
+void mux_reader_init(mux_reader *r);
+
+/*
+ * Takes the next frame, or piece of MUX_DATA payload, out of "len"
+ * bytes of "buf".
+ *
+ * Returns -1 on a malformed frame; otherwise the number of bytes used,
+ * with *ready set when "f" holds something.
+ */
+int mux_read(mux_reader *r, const char *buf, int len, mux_frame *f, int *ready);
+
+#endif /* MUX_H */
+
+/* Eof: mux.h */
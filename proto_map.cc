@@ -10,7 +10,7 @@
 #include "forward.h"
 #include "portfwd.h"
 
-proto_map::proto_map(vector<int> *port_l, vector<host_map*> *map_l, struct ip_addr *actv, struct ip_addr *pasv, int user, int group, struct ip_addr listen, struct ip_addr *source, long long XORkey, long long confuskey, int isRemServer)
+proto_map::proto_map(vector<int> *port_l, vector<host_map*> *map_l, struct ip_addr *actv, struct ip_addr *pasv, int user, int group, struct ip_addr listen, struct ip_addr *source, long long XORkey, long long confuskey, int isRemServer, const struct map_opts *options)
 {
   port_list  = port_l;
   map_list   = map_l;
@@ -18,6 +18,7 @@ proto_map::proto_map(vector<int> *port_l, vector<host_map*> *map_l, struct ip_ad
   fragile    = 0; /* false */
   XOR_key = XORkey;
   is_remote_server = isRemServer;
+  opts       = *options;
 
   ftp_actv   = actv != NULL;
   if (ftp_actv)
@@ -57,6 +58,48 @@ void proto_map::show() const
 
   syslog(LOG_INFO, " /* uid: %d, gid: %d */", uid, gid);
   syslog(LOG_INFO, " /* listen: %s */", addrtostr(&local_listen));
+  syslog(LOG_INFO, " /* workers: %d%s%s */", opts.workers, opts.cpu_affinity ? ", pinned" : "", opts.io_uring ? ", io_uring" : "");
+  syslog(LOG_INFO, " /* connect-timeout: %d, handshake-timeout: %d */", opts.connect_timeout, opts.handshake_timeout);
+  syslog(LOG_INFO, " /* eject-after: %d, health-check: %d */", opts.eject_after, opts.health_check);
+  syslog(LOG_INFO, " /* backlog: %d%s */", opts.backlog, opts.nodelay ? ", nodelay" : "");
+
+  if (opts.send_buffer || opts.receive_buffer)
+    syslog(LOG_INFO, " /* send-buffer: %d, receive-buffer: %d */", opts.send_buffer, opts.receive_buffer);
+
+  if (opts.keepalive)
+    syslog(LOG_INFO, " /* keepalive: %d */", opts.keepalive);
+
+  if (opts.notsent_lowat)
+    syslog(LOG_INFO, " /* notsent-lowat: %d */", opts.notsent_lowat);
+
+  if (opts.max_connections || opts.max_per_source)
+    syslog(LOG_INFO, " /* max-connections: %d, max-per-source: %d */", opts.max_connections, opts.max_per_source);
+
+  if (opts.idle_timeout || opts.session_timeout)
+    syslog(LOG_INFO, " /* idle-timeout: %d, session-timeout: %d */", opts.idle_timeout, opts.session_timeout);
+
+  if (opts.accept_rate)
+    syslog(LOG_INFO, " /* accept-rate: %d, accept-burst: %d, accept-prefix: %d */", opts.accept_rate,
+           opts.accept_burst ? opts.accept_burst : opts.accept_rate, opts.accept_prefix);
+
+  if (on_the_fly_dns)
+    syslog(LOG_INFO, " /* dns-ttl: %d, dns-negative-ttl: %d, dns-stale: %d */", opts.dns_ttl,
+           opts.dns_negative_ttl, opts.dns_stale);
+
+  if (opts.plain)
+    syslog(LOG_INFO, " /* plain */");
+
+  if (opts.pipeline_keys)
+    syslog(LOG_INFO, " /* pipeline-keys */");
+
+  if (opts.warm_pool)
+    syslog(LOG_INFO, " /* warm-pool: %d */", opts.warm_pool);
+
+  if (opts.mux)
+    syslog(LOG_INFO, " /* mux: %d */", opts.mux);
+
+  if (opts.fast_open)
+    syslog(LOG_INFO, " /* fast-open: %d */", opts.fast_open);
 
   if (local_src)
     syslog(LOG_INFO, " /* source: %s */", addrtostr(&local_source));
@@ -92,7 +135,7 @@ void proto_map::serve(proto_t proto) const
 
   switch (proto) {
   case P_TCP:
-    tcp_forward(listen, local_src, port_list, map_list, ftp_actv ? &actv_ip : 0, ftp_pasv ? &pasv_ip : 0, uid, gid, fragile, XOR_key, confusing_key, is_remote_server);
+    tcp_forward(listen, local_src, port_list, map_list, ftp_actv ? &actv_ip : 0, ftp_pasv ? &pasv_ip : 0, uid, gid, fragile, XOR_key, confusing_key, is_remote_server, &opts);
     break;
 
   case P_UDP:
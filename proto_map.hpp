@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include "host_map.hpp"
 #include "solve.h"
+#include "map_opts.h"
 
 class proto_map
 {
@@ -29,9 +30,10 @@ private:
   int		    is_remote_server;
   long long         XOR_key;
   long long	    confusing_key;
+  struct map_opts   opts;
 
 public:
-  proto_map(vector<int> *port_l, vector<host_map*> *map_l, struct ip_addr *actv, struct ip_addr *pasv, int user, int group, struct ip_addr listen, struct ip_addr *source, long long XOR_key, long long confusing_key, int is_remote_server);
+  proto_map(vector<int> *port_l, vector<host_map*> *map_l, struct ip_addr *actv, struct ip_addr *pasv, int user, int group, struct ip_addr listen, struct ip_addr *source, long long XOR_key, long long confusing_key, int is_remote_server, const struct map_opts *opts);
 
   void show() const;
 
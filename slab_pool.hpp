@@ -0,0 +1,63 @@
+/*
+  slab_pool.hpp
+
+  $Id: slab_pool.hpp,v 1.1 2026/10/17 19:40:03 cvs Exp $
+ */
+
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <stdlib.h>
+
+/*
+ * Objects of type T carved out of slabs of "per_slab" at a time, and
+ * recycled through a free list. Slabs are never given back: a pool
+ * keeps the size of its busiest moment.
+ *
+ * T is plain data, neither constructed nor destroyed here. A pool
+ * has no constructor so that it may be __thread: zero-initialized,
+ * it is empty.
+ */
+template<class T, int per_slab = 64>
+class slab_pool
+{
+private:
+  union slot {
+    slot *next;
+    T    obj;
+  };
+
+  slot *free_list;
+
+public:
+  /*
+   * Returns NULL on failure; uninitialized object on success.
+   */
+  T *get()
+    {
+      if (!free_list) {
+	slot *slab = (slot *) malloc(per_slab * sizeof(slot));
+	if (!slab)
+	  return 0;
+	for (int i = per_slab - 1; i >= 0; --i) {
+	  slab[i].next = free_list;
+	  free_list = &slab[i];
+	}
+      }
+
+      slot *s = free_list;
+      free_list = s->next;
+      return &s->obj;
+    }
+
+  void put(T *obj)
+    {
+      slot *s = (slot *) obj;
+      s->next = free_list;
+      free_list = s;
+    }
+};
+
+#endif /* SLAB_POOL_HPP */
+
+/* Eof: slab_pool.hpp */
@@ -0,0 +1,11 @@
+# Builds the tests of tests/ and runs them all:
+#   sh test.sh
+# Exits with 1 if any fails.
+CC="c++ -O1 -ggdb -pthread "
+fail=0
+for f in tests/*_test.cc; do
+	t=`echo $f | sed 's/.cc$//g'`
+	echo "$t:"
+	$CC -I. -o $t $f && $t || fail=1
+done
+exit $fail
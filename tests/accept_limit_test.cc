@@ -0,0 +1,80 @@
+/*
+  accept_limit_test.cc
+
+  $Id: accept_limit_test.cc,v 1.1 2026/10/18 09:12:40 cvs Exp $
+
+  Checks of the accept-rate buckets: see test.sh.
+ */
+
+#include <stdio.h>
+#include <arpa/inet.h>
+
+#include "accept_limit.hpp"
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok)
+    ++failures;
+}
+
+/*
+ * Clients allowed out of "tries" from "addr" at "now".
+ */
+static int allowed(accept_limit *l, unsigned int addr, int tries, long long now)
+{
+  int n = 0;
+  for (int i = 0; i < tries; ++i)
+    n += l->allow(addr, now);
+  return n;
+}
+
+int main()
+{
+  const long long start = 1000;
+  unsigned int a = inet_addr("10.1.2.3");
+  unsigned int b = inet_addr("10.1.2.200");  /* same /24 */
+  unsigned int c = inet_addr("10.1.3.3");
+
+  {
+    accept_limit l;
+    l.setup(10, 5, 24, 1);
+    check(allowed(&l, a, 20, start) == 5, "a prefix gets its burst at once");
+    check(allowed(&l, b, 20, start) == 0, "addresses of a prefix share its bucket");
+    check(allowed(&l, c, 20, start) == 5, "other prefixes have buckets of their own");
+    check(allowed(&l, a, 20, start + 300) == 3, "buckets refill at the rate");
+    check(allowed(&l, a, 20, start + 60000) == 5, "buckets refill up to the burst");
+  }
+
+  {
+    accept_limit l;
+    l.setup(1, 4, 32, 2);
+    check(allowed(&l, a, 20, start) == 2, "workers share the burst");
+  }
+
+  /*
+   * Sources spread over many more prefixes than the table holds, each
+   * coming back again and again within one millisecond: colliding
+   * prefixes take buckets over, and must not find them full.
+   */
+  {
+    const int sources = 100000;
+    const int rounds  = 10;
+    accept_limit l;
+    l.setup(1, 1, 32, 1);
+
+    int n = 0;
+    for (int r = 0; r < rounds; ++r)
+      for (int i = 0; i < sources; ++i)
+	n += l.allow(htonl(0x0a000000 + i), start);
+
+    printf("    %d of %d clients from %d prefixes allowed\n", n, sources * rounds, sources);
+    check(n <= 4096, "colliding prefixes stay limited to the buckets of the table");
+  }
+
+  return failures ? 1 : 0;
+}
+
+/* Eof: accept_limit_test.cc */
@@ -0,0 +1,194 @@
+/*
+  keystream2_test.cc
+
+  $Id: keystream2_test.cc,v 1.1 2026/10/18 11:05:12 cvs Exp $
+
+  Checks of wire protocol 2: see test.sh. Built with the source
+  itself, to reach both kernels.
+ */
+
+#include <stdio.h>
+
+#include "keystream2.cc"
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok)
+    ++failures;
+}
+
+static unsigned long long rand_state = 88172645463325252ull;
+
+static unsigned long long rand64()
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 7;
+  rand_state ^= rand_state << 17;
+  return rand_state;
+}
+
+static const long long XOR_key       = 2026054146659ll;
+static const long long confusing_key = 74132604721569ll;
+
+/*
+ * The test vector of RFC 8439, 2.3.2: the block counter and nonce
+ * words fall on "block" and "stream" here.
+ */
+static int chacha20_vector(blocks_fn fn)
+{
+  static const unsigned int expected[16] = {
+    0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3, 0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+    0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9, 0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2
+  };
+  unsigned int k[8];
+  unsigned int out[8 * 16];
+
+  for (int i = 0; i < 8; ++i)
+    k[i] = (4 * i) | (4 * i + 1) << 8 | (4 * i + 2) << 16 | (unsigned int) (4 * i + 3) << 24;
+  fn(k, 0x4a000000, 1 | 0x09000000ull << 32, 8, out);
+  return !memcmp(out, expected, sizeof(expected));
+}
+
+/*
+ * Words of "fn" differing from chacha20_4() over n blocks from
+ * "block" on.
+ */
+static long long block_mismatches(blocks_fn fn, const unsigned int k[8], unsigned int stream, unsigned long long block, int n)
+{
+  unsigned int out[KS2_BATCH * 16];
+  unsigned int ref[64];
+  long long bad = 0;
+
+  fn(k, stream, block, n, out);
+  for (int i = 0; i < n; i += 4) {
+    chacha20_4(k, stream, block + i, ref);
+    for (int j = 0; j < 64; ++j)
+      bad += out[i * 16 + j] != ref[j];
+  }
+  return bad;
+}
+
+/*
+ * Inflates "len" random bytes from inflated offset "start" on, and
+ * deflates them back, both in pieces of random sizes, as reads come.
+ *
+ * Returns the inflated size, or -1 when the bytes do not come back.
+ */
+static long long round_trip(const ks2_key *ks, unsigned long long start, int len)
+{
+  static char data[1 << 20];
+  static char wire[2 << 20];
+  static char back[1 << 20];
+
+  for (int i = 0; i < len; ++i)
+    data[i] = (char) rand64();
+
+  unsigned long long out_offset = start;
+  int rd = 0;
+  int wr = 0;
+  while (rd < len) {
+    int n = 1 + (int) (rand64() % 5000);
+    if (n > len - rd)
+      n = len - rd;
+    int used;
+    wr += ks2_inflate(ks, &out_offset, data + rd, n, wire + wr, sizeof(wire) - wr, &used);
+    rd += used;
+  }
+
+  if (out_offset - start != (unsigned long long) wr)
+    return -1;
+
+  unsigned long long in_offset = start;
+  int got = 0;
+  for (int i = 0; i < wr; ) {
+    int n = 1 + (int) (rand64() % 5000);
+    if (n > wr - i)
+      n = wr - i;
+    memcpy(back + got, wire + i, n);
+    got += ks2_deflate(ks, &in_offset, back + got, n);
+    i += n;
+  }
+
+  return got == len && in_offset == out_offset && !memcmp(data, back, len) ? wr : -1;
+}
+
+int main()
+{
+  /*
+   * Kernels.
+   */
+  check(chacha20_vector(blocks_generic), "the generic kernel is ChaCha20");
+
+#ifdef KEYSTREAM2_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    check(chacha20_vector(blocks_avx2), "the AVX2 kernel is ChaCha20");
+
+    long long bad = 0;
+    for (int i = 0; i < 1000; ++i) {
+      unsigned int k[8];
+      for (int j = 0; j < 8; ++j)
+	k[j] = (unsigned int) rand64();
+      unsigned long long block = i % 2 ? rand64() : 0xffffffffull - rand64() % 64;
+      bad += block_mismatches(blocks_avx2, k, (unsigned int) rand64() % 4, block, 8 * (1 + i % (KS2_BATCH / 8)));
+    }
+    printf("    %lld mismatches\n", bad);
+    check(!bad, "the AVX2 and generic kernels agree");
+  }
+  else
+    printf("    no AVX2 here: AVX2 kernel not checked\n");
+#endif
+
+  /*
+   * Negotiation: a version 2 peer tags its key, which only holders of
+   * the same XOR and confusing keys recognize; version 1 peers send
+   * random keys, which are not taken for tagged ones.
+   */
+  {
+    int tagged = 0;
+    int foreign = 0;
+    int random = 0;
+    for (int i = 0; i < 100000; ++i) {
+      long long key = ks2_own_key(XOR_key, confusing_key, (unsigned int) rand64());
+      tagged += ks2_tagged(key, XOR_key, confusing_key);
+      foreign += ks2_tagged(key, XOR_key + 1, confusing_key) + ks2_tagged(key, XOR_key, confusing_key + 1);
+      random += ks2_tagged((long long) rand64(), XOR_key, confusing_key);
+    }
+    check(tagged == 100000, "peers with the same keys agree on version 2");
+    check(!foreign, "peers with other keys do not");
+    check(!random, "version 1 keys are not taken for version 2 ones");
+  }
+
+  /*
+   * Round trips: each end sets up a direction with the same pair of
+   * session keys, as session_keys() in forward.cc does.
+   */
+  {
+    long long local_key  = ks2_own_key(XOR_key, confusing_key, 1234);
+    long long server_key = ks2_own_key(XOR_key, confusing_key, 5678);
+    ks2_key up, down, plain;
+    ks2_setup(&up, XOR_key, confusing_key, local_key, server_key);
+    ks2_setup(&down, XOR_key, confusing_key, server_key, local_key);
+    ks2_setup(&plain, XOR_key, 0, local_key, server_key);
+
+    check(memcmp(up.k, down.k, sizeof(up.k)) != 0, "each direction has a key of its own");
+
+    const int len = 1 << 20;
+    long long dense = round_trip(&up, 0, 64 * 100);
+    long long sparse = round_trip(&up, 64 * KS2_DENSE_BLOCKS, len);
+    printf("    %d bytes inflated to %lld in the first blocks, %d to %lld further on\n", 64 * 100, dense, len, sparse);
+    check(dense > 64 * 100 * 5 / 4 && dense < 64 * 100 * 3 / 2, "about 1 byte in 4 is inserted in the first blocks");
+    check(sparse > len + len / 36 && sparse < len + len / 28, "about 1 byte in 32 is inserted further on");
+
+    check(round_trip(&down, 0, len) > 0, "a stream comes back from its start");
+    check(round_trip(&down, 64 * KS2_DENSE_BLOCKS - 12345, len) > 0, "a stream comes back across the end of the first blocks");
+    check(round_trip(&down, rand64() >> 8, len) > 0, "a stream comes back from far on");
+    check(round_trip(&plain, 777, len) == len, "without a confusing key, nothing is inserted");
+  }
+
+  return failures ? 1 : 0;
+}
+
+/* Eof: keystream2_test.cc */
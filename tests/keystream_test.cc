@@ -0,0 +1,107 @@
+/*
+  keystream_test.cc
+
+  $Id: keystream_test.cc,v 1.1 2026/10/18 11:05:12 cvs Exp $
+
+  Checks of the version 1 keystream: see test.sh. Built with the
+  source itself, to reach both kernels.
+ */
+
+#include <stdio.h>
+
+#include "keystream.cc"
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAIL", what);
+  if (!ok)
+    ++failures;
+}
+
+static unsigned long long rand_state = 88172645463325252ull;
+
+static unsigned long long rand64()
+{
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 7;
+  rand_state ^= rand_state << 17;
+  return rand_state;
+}
+
+/*
+ * Values of "fn" differing from pseudo_rand_key_offset() over n
+ * offsets from "offset" on.
+ */
+static long long mismatches(keystream_fn fn, long long key, long long offset, long long session_key, int n)
+{
+  static int ks[4 * KEYSTREAM_CHUNK];
+  long long bad = 0;
+
+  fn(ks, n, key, offset, session_key);
+  for (int i = 0; i < n; ++i)
+    bad += ks[i] != pseudo_rand_key_offset(key, offset + i, session_key);
+  return bad;
+}
+
+/*
+ * Every shift count, from offsets where y changes sign or z wraps
+ * around 2^64, which the kernels handle apart, and from random ones.
+ */
+static long long sweep(keystream_fn fn)
+{
+  const long long keys[] = { 2026054146659ll, 74132604721569ll, 0, -1, (long long) rand64() };
+  long long bad = 0;
+
+  for (unsigned k = 0; k < sizeof(keys) / sizeof(keys[0]); ++k)
+    for (int s = 0; s < 64; ++s) {
+      long long key = keys[k];
+      long long session_key = s - 3 + 64 * (long long) (rand64() % 1000);
+      unsigned long long sign = (1ull << 36) - ((unsigned long long) key & ((1ull << 36) - 1));
+      unsigned long long wrap = s ? (1ull << (64 - s)) : 0;
+
+      const long long offsets[] = {
+	0,
+	(long long) (sign - 100),
+	(long long) (wrap - 100),
+	(long long) (rand64() >> 1),
+	(long long) (rand64() >> 20)
+      };
+      for (unsigned o = 0; o < sizeof(offsets) / sizeof(offsets[0]); ++o)
+	bad += mismatches(fn, key, offsets[o], session_key, 1 + (int) (rand64() % (4 * KEYSTREAM_CHUNK)));
+    }
+
+  return bad;
+}
+
+int main()
+{
+  long long bad = sweep(keystream_scalar);
+  printf("    %lld mismatches\n", bad);
+  check(!bad, "the scalar keystream matches pseudo_rand_key_offset()");
+
+#ifdef KEYSTREAM_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    bad = sweep(keystream_avx2);
+    printf("    %lld mismatches\n", bad);
+    check(!bad, "the AVX2 keystream matches pseudo_rand_key_offset()");
+  }
+  else
+    printf("    no AVX2 here: AVX2 keystream not checked\n");
+#endif
+
+  char buf[1000];
+  for (int i = 0; i < (int) sizeof(buf); ++i)
+    buf[i] = (char) i;
+  keystream_xor(buf, sizeof(buf), 2026054146659ll, 12345, 678);
+  keystream_xor(buf, sizeof(buf), 2026054146659ll, 12345, 678);
+  int same = 1;
+  for (int i = 0; i < (int) sizeof(buf); ++i)
+    same &= buf[i] == (char) i;
+  check(same, "keystream_xor() undoes itself");
+
+  return failures ? 1 : 0;
+}
+
+/* Eof: keystream_test.cc */
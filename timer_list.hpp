@@ -0,0 +1,107 @@
+/*
+  timer_list.hpp
+
+  $Id: timer_list.hpp,v 1.1 2026/10/17 16:05:19 cvs Exp $
+ */
+
+#ifndef TIMER_LIST_HPP
+#define TIMER_LIST_HPP
+
+/*
+ * A deadline embedded in whatever it times out; "owner" points back
+ * to it.
+ */
+struct timer {
+  long long deadline;  /* now_ms() clock */
+  void      *owner;
+  timer     *prev;
+  timer     *next;
+};
+
+/*
+ * Doubly-linked list of timers, earliest deadline first.
+ *
+ * Each list is meant for a single kind of timeout, whose duration is
+ * the same for every entry: insert() walks back from the tail, so it
+ * stops at once and every operation is O(1).
+ */
+class timer_list
+{
+private:
+  timer head; /* sentinel */
+
+public:
+  timer_list()
+    {
+      head.prev = head.next = &head;
+    }
+
+  static void init(timer *t, void *owner)
+    {
+      t->owner = owner;
+      t->prev = t->next = 0;
+    }
+
+  static int linked(const timer *t) { return t->next != 0; }
+
+  int is_empty() const { return head.next == &head; }
+
+  timer *first() const { return is_empty() ? 0 : head.next; }
+
+  void remove(timer *t)
+    {
+      if (!linked(t))
+	return;
+      t->prev->next = t->next;
+      t->next->prev = t->prev;
+      t->prev = t->next = 0;
+    }
+
+  void insert(timer *t, long long deadline)
+    {
+      remove(t);
+      t->deadline = deadline;
+
+      timer *after = head.prev;
+      while (after != &head && after->deadline > deadline)
+	after = after->prev;
+
+      t->prev = after;
+      t->next = after->next;
+      after->next->prev = t;
+      after->next = t;
+    }
+
+  /*
+   * Unlinks and returns the first timer due at "now"; NULL if none.
+   */
+  timer *expired(long long now)
+    {
+      timer *t = first();
+      if (!t || t->deadline > now)
+	return 0;
+      remove(t);
+      return t;
+    }
+
+  /*
+   * Milliseconds until the first deadline, clamped to [0, limit];
+   * limit itself when the list is empty (-1 meaning forever).
+   */
+  int wait_ms(long long now, int limit) const
+    {
+      timer *t = first();
+      if (!t)
+	return limit;
+      long long ms = t->deadline - now;
+      if (ms < 0)
+	ms = 0;
+      if (limit >= 0 && ms > limit)
+	ms = limit;
+      return (int) ms;
+    }
+};
+
+#endif /* TIMER_LIST_HPP */
+
+/* Eof: timer_list.hpp */
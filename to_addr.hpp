@@ -8,15 +8,75 @@
 #define TO_ADDR_HPP
 
 #include "addr.h"
+#include "util.h"
 
+/*
+ * Largest weight of a destination, which keeps the round robin
+ * schedule of a host_map within bounds.
+ */
+const int MAX_WEIGHT = 1000;
+
+/*
+ * A destination, with the load figures host_map balances on. These
+ * are shared by the workers of a map.
+ */
 class to_addr
 {
+private:
+  int weight;      /* share of the connections: 1 (default) to MAX_WEIGHT */
+  int active;      /* connections open or opening through it */
+  int latency_us;  /* moving average of connect (and handshake) time */
+
 public:
+  to_addr()
+    {
+      weight     = 1;
+      active     = 0;
+      latency_us = 0;
+    }
+
+  int get_weight() const { return weight; }
+  void set_weight(int w) { weight = w; }
+
+  int get_active() const { return active; }
+  void opened() { __sync_add_and_fetch(&active, 1); }
+  void closed() { __sync_sub_and_fetch(&active, 1); }
+
+  /*
+   * Averages latencies as TCP does round-trip times: the first sample
+   * counts in full, then each one for 1/8.
+   */
+  int get_latency_us() const { return latency_us; }
+  void add_latency_us(int sample)
+    {
+      int avg = latency_us;
+      latency_us = avg ? avg + (sample - avg) / 8 : MAX(sample, 1);
+    }
+
   virtual void show() const = 0;
   virtual int get_addr(const char *protoname, 
 	const struct sockaddr_in *cli_sa, 
 	const struct sockaddr_in *local_cli_sa, 
 	const struct ip_addr **addr, int *prt) = 0;
+
+  /*
+   * Whether the address depends on the client, which is then needed
+   * before connecting.
+   */
+  virtual int client_dependent() const
+    {
+      return 0;
+    }
+
+  /*
+   * Address known without a client, for health checks to probe.
+   *
+   * Returns -1 when there is none; 0 on success.
+   */
+  virtual int fixed_addr(const struct ip_addr **, int *) const
+    {
+      return -1;
+    }
 };
 
 #endif /* TO_ADDR_HPP */
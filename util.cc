@@ -167,4 +167,41 @@ void socket_close(int fd)
     syslog(LOG_ERR, "socket_close(): close() on socket FD %d failed: %m", fd);
 }
 
+/*
+ * Returns -1 on failure; 0 on success.
+ */
+int socket_nonblock(int fd, int on)
+{
+  int flags = fcntl(fd, F_GETFL);
+  if (flags == -1) {
+    syslog(LOG_ERR, "socket_nonblock(): fcntl(F_GETFL) on FD %d failed: %m", fd);
+    return -1;
+  }
+
+  flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  if (fcntl(fd, F_SETFL, flags) == -1) {
+    syslog(LOG_ERR, "socket_nonblock(): fcntl(F_SETFL) on FD %d failed: %m", fd);
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Monotonic clock, in milliseconds.
+ */
+long long now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+long long now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
 /* eof: util.c */
@@ -31,8 +31,13 @@ int std_to_null();
 int daemonize();
 
 void socket_close(int fd); 
+int socket_nonblock(int fd, int on);
+
+long long now_ms();
+long long now_us();
 
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
 
 #endif /* UTIL_H */
 
@@ -1,8 +1,9 @@
-/* A Bison parser, made by GNU Bison 3.0.4.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015 Free Software Foundation, Inc.
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
 
    This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
@@ -15,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -33,6 +34,10 @@
 /* C LALR(1) parser skeleton written by Richard Stallman, by
    simplifying the original so-called "semantic" parser.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
    variables, as they might otherwise be expanded by user macros.
@@ -40,11 +45,11 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
 
-/* Bison version.  */
-#define YYBISON_VERSION "3.0.4"
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
@@ -61,8 +66,8 @@
 
 
 
-/* Copy the first part of user declarations.  */
-#line 7 "conf.y" /* yacc.c:339  */
+/* First part of user prologue.  */
+#line 7 "conf.y"
 
 
 #include <stdio.h>
@@ -75,8 +80,10 @@
 #include "proto_map.hpp"
 #include "entry.hpp"
 #include "dst_addr.hpp"
+#include "dns_cache.hpp"
 #include "director.hpp"
 #include "portfwd.h"
+#include "map_opts.h"
 
 /*
  * These are from the lexical analyzer defined in conf.lex
@@ -122,6 +129,7 @@ int            conf_group  = -1;
 long long      conf_xor_key = 0;
 long long      conf_confusing_key = 0;
 int	       conf_is_remote_server = 0;
+struct map_opts conf_opts          = default_map_opts();
 
 const struct ip_addr conf_any_addr = solve_hostname(ANY_ADDR);
 struct ip_addr conf_listen         = conf_any_addr;
@@ -135,6 +143,52 @@ int mask_len_value(const char *len)
   return atoi(len);
 }
 
+int yes_value(const char *answer)
+{
+  return answer[0] == 'Y' || answer[0] == 'y';
+}
+
+int positive_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 1)
+    yyerror("positive number expected");
+  return value;
+}
+
+/*
+ * Like positive_value(), with 0 turning the option off.
+ */
+int count_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 0)
+    yyerror("number expected");
+  return value;
+}
+
+/*
+ * Weight of a destination: 1 to MAX_WEIGHT.
+ */
+int weight_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 1 || value > MAX_WEIGHT)
+    yyerror("weight out of range");
+  return value;
+}
+
+/*
+ * Length of an IPv4 network prefix: 0 to 32 bits.
+ */
+int prefix_value(const char *number)
+{
+  int value = atoi(number);
+  if (value < 0 || value > 32)
+    yyerror("prefix length expected");
+  return value;
+}
+
 void set_protoname(proto_t proto)
 {
   curr_proto = proto;
@@ -162,170 +216,229 @@ net_portion *use_hostprefix(char *hostname, int prefix_len)
 
 to_addr *use_dstaddr(char *hostname, int port)
 {
-  return new dst_addr(on_the_fly_dns ? safe_strdup(hostname) : 0, 
-		     use_hostname(hostname), 
-		     port);
+  dns_entry *name = 0;
+  struct ip_addr ip = solve_hostname(hostname);
+
+  if (on_the_fly_dns)
+    name = name_cache.add(hostname, &ip, conf_opts.dns_ttl,
+			  conf_opts.dns_negative_ttl, conf_opts.dns_stale);
+
+  free(hostname);
+  return new dst_addr(name, ip, port);
 }
 
 
-#line 172 "yconf.c" /* yacc.c:339  */
+#line 232 "yconf.c"
 
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
 # ifndef YY_NULLPTR
-#  if defined __cplusplus && 201103L <= __cplusplus
-#   define YY_NULLPTR nullptr
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
 #  else
-#   define YY_NULLPTR 0
+#   define YY_NULLPTR ((void*)0)
 #  endif
 # endif
 
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-# undef YYERROR_VERBOSE
-# define YYERROR_VERBOSE 1
-#else
-# define YYERROR_VERBOSE 0
-#endif
-
-/* In a future release of Bison, this section will be replaced
-   by #include "yconf.h".  */
-#ifndef YY_YY_YCONF_H_INCLUDED
-# define YY_YY_YCONF_H_INCLUDED
-/* Debug traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 0
-#endif
-#if YYDEBUG
-extern int yydebug;
-#endif
-
-/* Token type.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-  enum yytokentype
-  {
-    TK_NAME = 258,
-    TK_TCP = 259,
-    TK_UDP = 260,
-    TK_COLON = 261,
-    TK_SCOLON = 262,
-    TK_COMMA = 263,
-    TK_SLASH = 264,
-    TK_RANGE = 265,
-    TK_LBRACE = 266,
-    TK_RBRACE = 267,
-    TK_ARROW = 268,
-    TK_ACTV = 269,
-    TK_PASV = 270,
-    TK_USER = 271,
-    TK_GROUP = 272,
-    TK_BIND = 273,
-    TK_LISTEN = 274,
-    TK_SOURCE = 275,
-    TK_XOR_KEY = 276,
-    TK_REMOTE_SERVER = 277,
-    TK_CONFUSING_KEY = 278,
-    TK_STRING = 279,
-    TK_FRAGILE = 280,
-    TK_ILLEGAL = 281
-  };
-#endif
-/* Tokens.  */
-#define TK_NAME 258
-#define TK_TCP 259
-#define TK_UDP 260
-#define TK_COLON 261
-#define TK_SCOLON 262
-#define TK_COMMA 263
-#define TK_SLASH 264
-#define TK_RANGE 265
-#define TK_LBRACE 266
-#define TK_RBRACE 267
-#define TK_ARROW 268
-#define TK_ACTV 269
-#define TK_PASV 270
-#define TK_USER 271
-#define TK_GROUP 272
-#define TK_BIND 273
-#define TK_LISTEN 274
-#define TK_SOURCE 275
-#define TK_XOR_KEY 276
-#define TK_REMOTE_SERVER 277
-#define TK_CONFUSING_KEY 278
-#define TK_STRING 279
-#define TK_FRAGILE 280
-#define TK_ILLEGAL 281
-
-/* Value type.  */
-#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-
-union YYSTYPE
+#include "yconf.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
 {
-#line 141 "conf.y" /* yacc.c:355  */
-
-	int	           int_type;
-  	bool               bool_type;
-        char               *str_type;
-        port_pair          *port_type;
-        net_portion        *net_type;
-	from_addr   	   *from_type;
-	vector<from_addr*> *from_list_type;
-	to_addr   	   *dst_type;
-	vector<to_addr*>   *dst_list_type;
-	host_map           *host_map_type;
-	vector<host_map*>  *host_list_type;
-	vector<int>        *port_list_type;
-	proto_map          *map_type;
-	vector<proto_map*> *map_list_type;
-	entry		   *entry_type;
-
-#line 282 "yconf.c" /* yacc.c:355  */
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_TK_NAME = 3,                    /* TK_NAME  */
+  YYSYMBOL_TK_TCP = 4,                     /* TK_TCP  */
+  YYSYMBOL_TK_UDP = 5,                     /* TK_UDP  */
+  YYSYMBOL_TK_COLON = 6,                   /* TK_COLON  */
+  YYSYMBOL_TK_SCOLON = 7,                  /* TK_SCOLON  */
+  YYSYMBOL_TK_COMMA = 8,                   /* TK_COMMA  */
+  YYSYMBOL_TK_SLASH = 9,                   /* TK_SLASH  */
+  YYSYMBOL_TK_RANGE = 10,                  /* TK_RANGE  */
+  YYSYMBOL_TK_LBRACE = 11,                 /* TK_LBRACE  */
+  YYSYMBOL_TK_RBRACE = 12,                 /* TK_RBRACE  */
+  YYSYMBOL_TK_ARROW = 13,                  /* TK_ARROW  */
+  YYSYMBOL_TK_ACTV = 14,                   /* TK_ACTV  */
+  YYSYMBOL_TK_PASV = 15,                   /* TK_PASV  */
+  YYSYMBOL_TK_USER = 16,                   /* TK_USER  */
+  YYSYMBOL_TK_GROUP = 17,                  /* TK_GROUP  */
+  YYSYMBOL_TK_BIND = 18,                   /* TK_BIND  */
+  YYSYMBOL_TK_LISTEN = 19,                 /* TK_LISTEN  */
+  YYSYMBOL_TK_SOURCE = 20,                 /* TK_SOURCE  */
+  YYSYMBOL_TK_XOR_KEY = 21,                /* TK_XOR_KEY  */
+  YYSYMBOL_TK_REMOTE_SERVER = 22,          /* TK_REMOTE_SERVER  */
+  YYSYMBOL_TK_CONFUSING_KEY = 23,          /* TK_CONFUSING_KEY  */
+  YYSYMBOL_TK_STRING = 24,                 /* TK_STRING  */
+  YYSYMBOL_TK_FRAGILE = 25,                /* TK_FRAGILE  */
+  YYSYMBOL_TK_WORKERS = 26,                /* TK_WORKERS  */
+  YYSYMBOL_TK_CPU_AFFINITY = 27,           /* TK_CPU_AFFINITY  */
+  YYSYMBOL_TK_IO_URING = 28,               /* TK_IO_URING  */
+  YYSYMBOL_TK_CONNECT_TIMEOUT = 29,        /* TK_CONNECT_TIMEOUT  */
+  YYSYMBOL_TK_HANDSHAKE_TIMEOUT = 30,      /* TK_HANDSHAKE_TIMEOUT  */
+  YYSYMBOL_TK_PLAIN = 31,                  /* TK_PLAIN  */
+  YYSYMBOL_TK_EJECT_AFTER = 32,            /* TK_EJECT_AFTER  */
+  YYSYMBOL_TK_HEALTH_CHECK = 33,           /* TK_HEALTH_CHECK  */
+  YYSYMBOL_TK_FAILOVER = 34,               /* TK_FAILOVER  */
+  YYSYMBOL_TK_ROUND_ROBIN = 35,            /* TK_ROUND_ROBIN  */
+  YYSYMBOL_TK_LEAST_CONN = 36,             /* TK_LEAST_CONN  */
+  YYSYMBOL_TK_LEAST_LATENCY = 37,          /* TK_LEAST_LATENCY  */
+  YYSYMBOL_TK_WEIGHT = 38,                 /* TK_WEIGHT  */
+  YYSYMBOL_TK_WARM_POOL = 39,              /* TK_WARM_POOL  */
+  YYSYMBOL_TK_MUX = 40,                    /* TK_MUX  */
+  YYSYMBOL_TK_FAST_OPEN = 41,              /* TK_FAST_OPEN  */
+  YYSYMBOL_TK_PIPELINE_KEYS = 42,          /* TK_PIPELINE_KEYS  */
+  YYSYMBOL_TK_BACKLOG = 43,                /* TK_BACKLOG  */
+  YYSYMBOL_TK_NODELAY = 44,                /* TK_NODELAY  */
+  YYSYMBOL_TK_SEND_BUFFER = 45,            /* TK_SEND_BUFFER  */
+  YYSYMBOL_TK_RECEIVE_BUFFER = 46,         /* TK_RECEIVE_BUFFER  */
+  YYSYMBOL_TK_KEEPALIVE = 47,              /* TK_KEEPALIVE  */
+  YYSYMBOL_TK_NOTSENT_LOWAT = 48,          /* TK_NOTSENT_LOWAT  */
+  YYSYMBOL_TK_MAX_CONNECTIONS = 49,        /* TK_MAX_CONNECTIONS  */
+  YYSYMBOL_TK_MAX_PER_SOURCE = 50,         /* TK_MAX_PER_SOURCE  */
+  YYSYMBOL_TK_IDLE_TIMEOUT = 51,           /* TK_IDLE_TIMEOUT  */
+  YYSYMBOL_TK_SESSION_TIMEOUT = 52,        /* TK_SESSION_TIMEOUT  */
+  YYSYMBOL_TK_ACCEPT_RATE = 53,            /* TK_ACCEPT_RATE  */
+  YYSYMBOL_TK_ACCEPT_BURST = 54,           /* TK_ACCEPT_BURST  */
+  YYSYMBOL_TK_ACCEPT_PREFIX = 55,          /* TK_ACCEPT_PREFIX  */
+  YYSYMBOL_TK_DNS_TTL = 56,                /* TK_DNS_TTL  */
+  YYSYMBOL_TK_DNS_NEGATIVE_TTL = 57,       /* TK_DNS_NEGATIVE_TTL  */
+  YYSYMBOL_TK_DNS_STALE = 58,              /* TK_DNS_STALE  */
+  YYSYMBOL_TK_ILLEGAL = 59,                /* TK_ILLEGAL  */
+  YYSYMBOL_YYACCEPT = 60,                  /* $accept  */
+  YYSYMBOL_conf = 61,                      /* conf  */
+  YYSYMBOL_stmt_list = 62,                 /* stmt_list  */
+  YYSYMBOL_stmt = 63,                      /* stmt  */
+  YYSYMBOL_global_option = 64,             /* global_option  */
+  YYSYMBOL_entry = 65,                     /* entry  */
+  YYSYMBOL_fragile = 66,                   /* fragile  */
+  YYSYMBOL_set_proto_tcp = 67,             /* set_proto_tcp  */
+  YYSYMBOL_set_proto_udp = 68,             /* set_proto_udp  */
+  YYSYMBOL_section = 69,                   /* section  */
+  YYSYMBOL_map_list = 70,                  /* map_list  */
+  YYSYMBOL_map = 71,                       /* map  */
+  YYSYMBOL_name = 72,                      /* name  */
+  YYSYMBOL_ident = 73,                     /* ident  */
+  YYSYMBOL_port_list = 74,                 /* port_list  */
+  YYSYMBOL_host_list = 75,                 /* host_list  */
+  YYSYMBOL_host_map = 76,                  /* host_map  */
+  YYSYMBOL_balance = 77,                   /* balance  */
+  YYSYMBOL_dst_list = 78,                  /* dst_list  */
+  YYSYMBOL_weighted_dst = 79,              /* weighted_dst  */
+  YYSYMBOL_dst = 80,                       /* dst  */
+  YYSYMBOL_from_list = 81,                 /* from_list  */
+  YYSYMBOL_from = 82,                      /* from  */
+  YYSYMBOL_host_prefix = 83,               /* host_prefix  */
+  YYSYMBOL_prefix_length = 84,             /* prefix_length  */
+  YYSYMBOL_port_range = 85                 /* port_range  */
 };
-
-typedef union YYSTYPE YYSTYPE;
-# define YYSTYPE_IS_TRIVIAL 1
-# define YYSTYPE_IS_DECLARED 1
-#endif
+typedef enum yysymbol_kind_t yysymbol_kind_t;
 
 
-extern YYSTYPE yylval;
-
-int yyparse (void);
-
-#endif /* !YY_YY_YCONF_H_INCLUDED  */
-
-/* Copy the second part of user declarations.  */
-#line 176 "conf.y" /* yacc.c:358  */
+/* Second part of user prologue.  */
+#line 266 "conf.y"
 
   /* Simbolo nao-terminal inicial */
 
-#line 302 "yconf.c" /* yacc.c:358  */
+#line 355 "yconf.c"
+
 
 #ifdef short
 # undef short
 #endif
 
-#ifdef YYTYPE_UINT8
-typedef YYTYPE_UINT8 yytype_uint8;
-#else
-typedef unsigned char yytype_uint8;
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
 #endif
 
-#ifdef YYTYPE_INT8
-typedef YYTYPE_INT8 yytype_int8;
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
 #else
 typedef signed char yytype_int8;
 #endif
 
-#ifdef YYTYPE_UINT16
-typedef YYTYPE_UINT16 yytype_uint16;
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
 #else
-typedef unsigned short int yytype_uint16;
+typedef short yytype_uint8;
 #endif
 
-#ifdef YYTYPE_INT16
-typedef YYTYPE_INT16 yytype_int16;
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
 #else
-typedef short int yytype_int16;
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
 #endif
 
 #ifndef YYSIZE_T
@@ -333,15 +446,28 @@ typedef short int yytype_int16;
 #  define YYSIZE_T __SIZE_TYPE__
 # elif defined size_t
 #  define YYSIZE_T size_t
-# elif ! defined YYSIZE_T
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
 #  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
 #  define YYSIZE_T size_t
 # else
-#  define YYSIZE_T unsigned int
+#  define YYSIZE_T unsigned
 # endif
 #endif
 
-#define YYSIZE_MAXIMUM ((YYSIZE_T) -1)
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_uint8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
 
 #ifndef YY_
 # if defined YYENABLE_NLS && YYENABLE_NLS
@@ -355,47 +481,43 @@ typedef short int yytype_int16;
 # endif
 #endif
 
-#ifndef YY_ATTRIBUTE
-# if (defined __GNUC__                                               \
-      && (2 < __GNUC__ || (__GNUC__ == 2 && 96 <= __GNUC_MINOR__)))  \
-     || defined __SUNPRO_C && 0x5110 <= __SUNPRO_C
-#  define YY_ATTRIBUTE(Spec) __attribute__(Spec)
-# else
-#  define YY_ATTRIBUTE(Spec) /* empty */
-# endif
-#endif
 
 #ifndef YY_ATTRIBUTE_PURE
-# define YY_ATTRIBUTE_PURE   YY_ATTRIBUTE ((__pure__))
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
 #endif
 
 #ifndef YY_ATTRIBUTE_UNUSED
-# define YY_ATTRIBUTE_UNUSED YY_ATTRIBUTE ((__unused__))
-#endif
-
-#if !defined _Noreturn \
-     && (!defined __STDC_VERSION__ || __STDC_VERSION__ < 201112)
-# if defined _MSC_VER && 1200 <= _MSC_VER
-#  define _Noreturn __declspec (noreturn)
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
 # else
-#  define _Noreturn YY_ATTRIBUTE ((__noreturn__))
+#  define YY_ATTRIBUTE_UNUSED
 # endif
 #endif
 
 /* Suppress unused-variable warnings by "using" E.  */
 #if ! defined lint || defined __GNUC__
-# define YYUSE(E) ((void) (E))
+# define YY_USE(E) ((void) (E))
 #else
-# define YYUSE(E) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-#if defined __GNUC__ && 407 <= __GNUC__ * 100 + __GNUC_MINOR__
 /* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN \
-    _Pragma ("GCC diagnostic push") \
-    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")\
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
     _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
-# define YY_IGNORE_MAYBE_UNINITIALIZED_END \
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
     _Pragma ("GCC diagnostic pop")
 #else
 # define YY_INITIAL_VALUE(Value) Value
@@ -408,8 +530,22 @@ typedef short int yytype_int16;
 # define YY_INITIAL_VALUE(Value) /* Nothing. */
 #endif
 
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
 
-#if ! defined yyoverflow || YYERROR_VERBOSE
+#if !defined yyoverflow
 
 /* The parser invokes alloca or malloc; define the necessary symbols.  */
 
@@ -474,8 +610,7 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 # endif
-#endif /* ! defined yyoverflow || YYERROR_VERBOSE */
-
+#endif /* !defined yyoverflow */
 
 #if (! defined yyoverflow \
      && (! defined __cplusplus \
@@ -484,17 +619,17 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 /* A type that is properly aligned for any stack member.  */
 union yyalloc
 {
-  yytype_int16 yyss_alloc;
+  yy_state_t yyss_alloc;
   YYSTYPE yyvs_alloc;
 };
 
 /* The size of the maximum gap between one aligned stack and the next.  */
-# define YYSTACK_GAP_MAXIMUM (sizeof (union yyalloc) - 1)
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
 
 /* The size of an array large to enough to hold all stacks, each with
    N elements.  */
 # define YYSTACK_BYTES(N) \
-     ((N) * (sizeof (yytype_int16) + sizeof (YYSTYPE)) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
       + YYSTACK_GAP_MAXIMUM)
 
 # define YYCOPY_NEEDED 1
@@ -507,11 +642,11 @@ union yyalloc
 # define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
     do                                                                  \
       {                                                                 \
-        YYSIZE_T yynewbytes;                                            \
+        YYPTRDIFF_T yynewbytes;                                         \
         YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
         Stack = &yyptr->Stack_alloc;                                    \
-        yynewbytes = yystacksize * sizeof (*Stack) + YYSTACK_GAP_MAXIMUM; \
-        yyptr += yynewbytes / sizeof (*yyptr);                          \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
       }                                                                 \
     while (0)
 
@@ -523,12 +658,12 @@ union yyalloc
 # ifndef YYCOPY
 #  if defined __GNUC__ && 1 < __GNUC__
 #   define YYCOPY(Dst, Src, Count) \
-      __builtin_memcpy (Dst, Src, (Count) * sizeof (*(Src)))
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
 #  else
 #   define YYCOPY(Dst, Src, Count)              \
       do                                        \
         {                                       \
-          YYSIZE_T yyi;                         \
+          YYPTRDIFF_T yyi;                      \
           for (yyi = 0; yyi < (Count); yyi++)   \
             (Dst)[yyi] = (Src)[yyi];            \
         }                                       \
@@ -538,30 +673,33 @@ union yyalloc
 #endif /* !YYCOPY_NEEDED */
 
 /* YYFINAL -- State number of the termination state.  */
-#define YYFINAL  26
+#define YYFINAL  116
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   86
+#define YYLAST   437
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  27
+#define YYNTOKENS  60
 /* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS  23
+#define YYNNTS  26
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES  52
+#define YYNRULES  121
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES  96
+#define YYNSTATES  195
 
-/* YYTRANSLATE[YYX] -- Symbol number corresponding to YYX as returned
-   by yylex, with out-of-bounds checking.  */
-#define YYUNDEFTOK  2
-#define YYMAXUTOK   281
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   314
 
-#define YYTRANSLATE(YYX)                                                \
-  ((unsigned int) (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
 
 /* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
-   as returned by yylex, without out-of-bounds checking.  */
-static const yytype_uint8 yytranslate[] =
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
 {
        0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -591,210 +729,346 @@ static const yytype_uint8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
        5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
       15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
-      25,    26
+      25,    26,    27,    28,    29,    30,    31,    32,    33,    34,
+      35,    36,    37,    38,    39,    40,    41,    42,    43,    44,
+      45,    46,    47,    48,    49,    50,    51,    52,    53,    54,
+      55,    56,    57,    58,    59
 };
 
 #if YYDEBUG
-  /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_uint16 yyrline[] =
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
 {
-       0,   184,   184,   185,   187,   188,   190,   191,   193,   194,
-     195,   196,   197,   198,   199,   203,   205,   206,   208,   209,
-     211,   212,   214,   216,   221,   226,   229,   233,   237,   242,
-     248,   250,   255,   260,   265,   270,   274,   279,   284,   288,
-     292,   297,   302,   305,   308,   311,   315,   320,   321,   323,
-     327,   331,   335
+       0,   274,   274,   275,   277,   278,   280,   281,   283,   284,
+     285,   286,   287,   288,   289,   290,   291,   292,   293,   294,
+     295,   296,   297,   298,   299,   300,   301,   302,   303,   304,
+     305,   306,   307,   308,   309,   310,   311,   312,   313,   314,
+     315,   316,   317,   321,   323,   324,   326,   327,   329,   330,
+     332,   334,   339,   344,   347,   351,   355,   360,   366,   373,
+     374,   374,   374,   374,   375,   375,   375,   375,   376,   376,
+     376,   376,   377,   377,   377,   377,   377,   378,   378,   378,
+     378,   379,   379,   379,   380,   380,   380,   381,   381,   381,
+     381,   382,   382,   384,   389,   394,   399,   404,   407,   411,
+     412,   413,   414,   416,   421,   426,   429,   434,   438,   442,
+     447,   452,   455,   458,   461,   465,   470,   471,   473,   477,
+     481,   485
 };
 #endif
 
-#if YYDEBUG || YYERROR_VERBOSE || 0
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
 /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "$end", "error", "$undefined", "TK_NAME", "TK_TCP", "TK_UDP",
-  "TK_COLON", "TK_SCOLON", "TK_COMMA", "TK_SLASH", "TK_RANGE", "TK_LBRACE",
-  "TK_RBRACE", "TK_ARROW", "TK_ACTV", "TK_PASV", "TK_USER", "TK_GROUP",
-  "TK_BIND", "TK_LISTEN", "TK_SOURCE", "TK_XOR_KEY", "TK_REMOTE_SERVER",
-  "TK_CONFUSING_KEY", "TK_STRING", "TK_FRAGILE", "TK_ILLEGAL", "$accept",
-  "conf", "stmt_list", "stmt", "global_option", "entry", "fragile",
-  "set_proto_tcp", "set_proto_udp", "section", "map_list", "map", "name",
-  "port_list", "host_list", "host_map", "dst_list", "dst", "from_list",
-  "from", "host_prefix", "prefix_length", "port_range", YY_NULLPTR
+  "\"end of file\"", "error", "\"invalid token\"", "TK_NAME", "TK_TCP",
+  "TK_UDP", "TK_COLON", "TK_SCOLON", "TK_COMMA", "TK_SLASH", "TK_RANGE",
+  "TK_LBRACE", "TK_RBRACE", "TK_ARROW", "TK_ACTV", "TK_PASV", "TK_USER",
+  "TK_GROUP", "TK_BIND", "TK_LISTEN", "TK_SOURCE", "TK_XOR_KEY",
+  "TK_REMOTE_SERVER", "TK_CONFUSING_KEY", "TK_STRING", "TK_FRAGILE",
+  "TK_WORKERS", "TK_CPU_AFFINITY", "TK_IO_URING", "TK_CONNECT_TIMEOUT",
+  "TK_HANDSHAKE_TIMEOUT", "TK_PLAIN", "TK_EJECT_AFTER", "TK_HEALTH_CHECK",
+  "TK_FAILOVER", "TK_ROUND_ROBIN", "TK_LEAST_CONN", "TK_LEAST_LATENCY",
+  "TK_WEIGHT", "TK_WARM_POOL", "TK_MUX", "TK_FAST_OPEN",
+  "TK_PIPELINE_KEYS", "TK_BACKLOG", "TK_NODELAY", "TK_SEND_BUFFER",
+  "TK_RECEIVE_BUFFER", "TK_KEEPALIVE", "TK_NOTSENT_LOWAT",
+  "TK_MAX_CONNECTIONS", "TK_MAX_PER_SOURCE", "TK_IDLE_TIMEOUT",
+  "TK_SESSION_TIMEOUT", "TK_ACCEPT_RATE", "TK_ACCEPT_BURST",
+  "TK_ACCEPT_PREFIX", "TK_DNS_TTL", "TK_DNS_NEGATIVE_TTL", "TK_DNS_STALE",
+  "TK_ILLEGAL", "$accept", "conf", "stmt_list", "stmt", "global_option",
+  "entry", "fragile", "set_proto_tcp", "set_proto_udp", "section",
+  "map_list", "map", "name", "ident", "port_list", "host_list", "host_map",
+  "balance", "dst_list", "weighted_dst", "dst", "from_list", "from",
+  "host_prefix", "prefix_length", "port_range", YY_NULLPTR
 };
-#endif
 
-# ifdef YYPRINT
-/* YYTOKNUM[NUM] -- (External) token number corresponding to the
-   (internal) symbol number NUM (which must be that of a token).  */
-static const yytype_uint16 yytoknum[] =
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
 {
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,   276,   277,   278,   279,   280,   281
-};
-# endif
+  return yytname[yysymbol];
+}
+#endif
 
-#define YYPACT_NINF -65
+#define YYPACT_NINF (-118)
 
-#define yypact_value_is_default(Yystate) \
-  (!!((Yystate) == (-65)))
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
 
-#define YYTABLE_NINF -19
+#define YYTABLE_NINF (-72)
 
-#define yytable_value_is_error(Yytable_value) \
+#define yytable_value_is_error(Yyn) \
   0
 
-  /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-     STATE-NUM.  */
-static const yytype_int8 yypact[] =
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int16 yypact[] =
 {
-      26,   -65,    13,    17,    19,    29,    35,    37,    59,    60,
-     -65,    66,    26,   -65,   -65,   -65,    63,    39,   -65,   -65,
-     -65,   -65,   -65,   -65,   -65,   -65,   -65,   -65,   -65,    65,
-     -65,    39,   -65,    -5,   -65,   -65,     4,   -65,    65,   -65,
-      65,    30,    65,    65,   -65,   -65,    18,    61,    -2,   -65,
-      16,   -65,    67,    -7,    50,    65,    62,   -65,    68,   -65,
-      30,   -65,    30,     3,    18,    30,    65,    30,    65,   -65,
-      65,   -65,   -65,   -65,   -65,    69,    70,   -65,   -65,    45,
-      58,    46,    71,   -65,    65,     3,   -65,    30,   -65,    30,
-     -65,   -65,    47,    53,   -65,   -65
+     379,  -118,   324,   324,   324,   324,   324,   324,   324,   324,
+    -118,   324,   324,   324,   324,   324,   324,   324,   324,   324,
+     324,   324,   324,   324,   324,   324,   324,   324,   324,   324,
+     324,   324,   324,   324,   324,   324,   324,   324,   324,     8,
+     379,  -118,  -118,  -118,    39,    56,  -118,  -118,  -118,  -118,
+    -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,
+    -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,
+    -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,
+    -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,
+    -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,
+    -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,
+    -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,  -118,   324,
+    -118,    56,    32,  -118,  -118,  -118,    41,  -118,   324,  -118,
+     324,    76,   324,   324,  -118,  -118,   156,    60,    35,  -118,
+      45,  -118,    67,    30,    66,   324,    65,  -118,   324,  -118,
+      76,  -118,    76,   212,   156,    76,   324,    76,   324,  -118,
+     324,  -118,  -118,  -118,  -118,    75,    77,    78,    79,    80,
+     268,    81,  -118,    49,  -118,    50,    82,    52,    83,  -118,
+     324,    81,   268,   324,  -118,    76,  -118,    76,  -118,  -118,
+    -118,    53,    54,  -118,  -118
 };
 
-  /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
-     Performed when YYTABLE does not specify something else to do.  Zero
-     means the default is an error.  */
-static const yytype_uint8 yydefact[] =
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
 {
-       2,    21,     0,     0,     0,     0,     0,     0,     0,     0,
-      19,     0,     3,     4,     7,     6,     0,     0,     8,     9,
-      15,    10,    14,    11,    13,    12,     1,     5,    20,     0,
-      17,     0,    30,     0,    23,    31,     0,    16,     0,    22,
-       0,    42,     0,     0,    24,    32,     0,    47,     0,    33,
-       0,    40,    43,     0,     0,     0,    49,    44,     0,    46,
-      42,    25,    42,     0,     0,    42,     0,    42,     0,    51,
-      50,    48,    34,    41,    39,     0,    35,    36,    45,     0,
-       0,     0,     0,    52,     0,     0,    26,    42,    27,    42,
-      38,    37,     0,     0,    28,    29
+       2,    49,     0,     0,     0,     0,     0,     0,     0,     0,
+      47,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       3,     4,     7,     6,     0,     0,    59,    60,    61,    62,
+      63,    64,    65,    66,    67,    68,    69,    70,    71,    72,
+      73,    74,    75,    76,    77,    78,    79,    80,    81,    82,
+      83,    84,    85,    86,    87,    88,    89,    90,    91,    92,
+       8,     9,    43,    10,    42,    11,    13,    12,    14,    15,
+      16,    17,    18,    19,    20,    21,    22,    23,    24,    25,
+      26,    27,    28,    29,    30,    31,    32,    33,    34,    35,
+      36,    37,    38,    39,    40,    41,     1,     5,    48,     0,
+      45,     0,     0,    51,    93,    58,     0,    44,     0,    50,
+       0,   111,     0,     0,    52,    94,     0,   116,     0,    95,
+       0,   109,   112,     0,     0,     0,   118,   113,     0,   115,
+     111,    53,   111,     0,     0,   111,     0,   111,     0,   120,
+     119,   117,    96,   110,   108,    99,   100,   101,   102,     0,
+       0,    97,   103,   105,   114,     0,     0,     0,     0,   121,
+       0,    98,     0,     0,    54,   111,    55,   111,   107,   104,
+     106,     0,     0,    56,    57
 };
 
-  /* YYPGOTO[NTERM-NUM].  */
+/* YYPGOTO[NTERM-NUM].  */
 static const yytype_int8 yypgoto[] =
 {
-     -65,   -65,   -65,    64,   -65,   -65,   -65,   -65,   -65,    43,
-     -65,    41,   -29,   -65,   -64,    20,   -65,    -8,   -65,    21,
-     -65,   -65,    22
+    -118,  -118,  -118,    51,  -118,  -118,  -118,  -118,  -118,   -31,
+    -118,   -36,   -82,    -2,  -118,  -117,   -55,  -118,   -74,   -85,
+    -118,  -118,   -53,  -118,  -118,   -19
 };
 
-  /* YYDEFGOTO[NTERM-NUM].  */
-static const yytype_int8 yydefgoto[] =
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_uint8 yydefgoto[] =
 {
-      -1,    11,    12,    13,    14,    15,    16,    31,    17,    30,
-      33,    34,    47,    36,    48,    49,    76,    77,    50,    51,
-      52,    59,    57
+       0,    39,    40,    41,    42,    43,    44,   121,    45,   120,
+     122,   123,   137,   125,   126,   138,   139,   170,   171,   172,
+     173,   140,   141,   142,   149,   147
 };
 
-  /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
-     positive, shift that token.  If negative, reduce the rule whose
-     number is the opposite.  If YYTABLE_NINF, syntax error.  */
-static const yytype_int8 yytable[] =
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_int16 yytable[] =
 {
-      35,    79,    38,    81,    65,    60,    32,    39,    66,    35,
-      61,    45,    40,    53,    54,    41,    18,    56,    42,    43,
-      19,    32,    20,    92,    62,    93,    69,    74,    55,    63,
-     -18,     1,    21,    32,    75,    56,    46,    80,    22,    82,
-      23,    83,     2,     3,     4,     5,     6,     7,     8,     9,
-      29,    10,    60,    60,    60,    90,    75,    86,    88,    94,
-      60,    67,    24,    25,    68,    95,    26,    28,    32,    87,
-      58,    71,    70,    64,    37,    84,    27,    91,    85,    44,
-      72,     0,    89,    73,     0,     0,    78
+      80,    81,    82,    83,    84,    85,    86,    87,   116,    88,
+      89,    90,    91,    92,    93,    94,    95,    96,    97,    98,
+      99,   100,   101,   102,   103,   104,   105,   106,   107,   108,
+     109,   110,   111,   112,   113,   114,   115,   124,   175,   128,
+     177,   155,   150,   118,   129,   156,   124,   151,   135,   130,
+     143,   144,   131,   152,   146,   132,   133,   150,   153,   150,
+     150,   150,   184,   159,   186,   193,   194,   119,   191,   148,
+     192,   169,   146,   154,   176,   160,   178,   157,   179,    46,
+     158,   -68,   136,   -69,   -70,   -71,   180,   183,   169,   182,
+     127,   117,   134,   185,   187,   162,   181,   189,   188,   163,
+     169,     0,    47,    48,    49,    50,    51,    52,    53,    54,
+      55,    56,    57,    58,    59,    60,    61,    62,    63,    64,
+      65,    66,    67,    68,    69,    70,    71,    72,    73,    74,
+      75,    76,    77,    78,    79,   174,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,   161,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,    46,
+       0,     0,     0,     0,     0,     0,   145,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,   190,    47,    48,    49,    50,    51,    52,    53,    54,
+      55,    56,    57,    58,    59,    60,    61,    62,    63,    64,
+      65,    66,    67,    68,    69,    70,    71,    72,    73,    74,
+      75,    76,    77,    78,    79,    46,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,   164,     0,    47,    48,
+      49,    50,    51,    52,    53,    54,   165,   166,   167,   168,
+      59,    60,    61,    62,    63,    64,    65,    66,    67,    68,
+      69,    70,    71,    72,    73,    74,    75,    76,    77,    78,
+      79,    46,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,   164,     0,    47,    48,    49,    50,    51,    52,
+      53,    54,    55,    56,    57,    58,    59,    60,    61,    62,
+      63,    64,    65,    66,    67,    68,    69,    70,    71,    72,
+      73,    74,    75,    76,    77,    78,    79,    46,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+      47,    48,    49,    50,    51,    52,    53,    54,    55,    56,
+      57,    58,    59,    60,    61,    62,    63,    64,    65,    66,
+      67,    68,    69,    70,    71,    72,    73,    74,    75,    76,
+      77,    78,    79,   -46,     1,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     2,     3,     4,     5,     6,
+       7,     8,     9,     0,    10,    11,    12,    13,    14,    15,
+      16,    17,    18,     0,     0,     0,     0,     0,    19,    20,
+      21,    22,    23,    24,    25,    26,    27,    28,    29,    30,
+      31,    32,    33,    34,    35,    36,    37,    38
 };
 
-static const yytype_int8 yycheck[] =
+static const yytype_int16 yycheck[] =
 {
-      29,    65,     7,    67,    11,     7,     3,    12,    15,    38,
-      12,    40,     8,    42,    43,    11,     3,    46,    14,    15,
-       3,     3,     3,    87,     8,    89,    55,    24,    10,    13,
-       4,     5,     3,     3,    63,    64,     6,    66,     3,    68,
-       3,    70,    16,    17,    18,    19,    20,    21,    22,    23,
-      11,    25,     7,     7,     7,    84,    85,    12,    12,    12,
-       7,    11,     3,     3,    14,    12,     0,     4,     3,    11,
-       9,     3,    10,     6,    31,     6,    12,    85,     8,    38,
-      60,    -1,    11,    62,    -1,    -1,    64
+       2,     3,     4,     5,     6,     7,     8,     9,     0,    11,
+      12,    13,    14,    15,    16,    17,    18,    19,    20,    21,
+      22,    23,    24,    25,    26,    27,    28,    29,    30,    31,
+      32,    33,    34,    35,    36,    37,    38,   119,   155,     7,
+     157,    11,     7,     4,    12,    15,   128,    12,   130,     8,
+     132,   133,    11,     8,   136,    14,    15,     7,    13,     7,
+       7,     7,    12,   145,    12,    12,    12,    11,   185,     9,
+     187,   153,   154,     6,   156,    10,   158,    11,   160,     3,
+      14,     6,     6,     6,     6,     6,     6,    38,   170,     8,
+     121,    40,   128,    11,    11,   150,   170,   182,   180,   152,
+     182,    -1,    26,    27,    28,    29,    30,    31,    32,    33,
+      34,    35,    36,    37,    38,    39,    40,    41,    42,    43,
+      44,    45,    46,    47,    48,    49,    50,    51,    52,    53,
+      54,    55,    56,    57,    58,   154,    -1,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,   148,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,     3,
+      -1,    -1,    -1,    -1,    -1,    -1,    10,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,
+      -1,   183,    26,    27,    28,    29,    30,    31,    32,    33,
+      34,    35,    36,    37,    38,    39,    40,    41,    42,    43,
+      44,    45,    46,    47,    48,    49,    50,    51,    52,    53,
+      54,    55,    56,    57,    58,     3,    -1,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,    24,    -1,    26,    27,
+      28,    29,    30,    31,    32,    33,    34,    35,    36,    37,
+      38,    39,    40,    41,    42,    43,    44,    45,    46,    47,
+      48,    49,    50,    51,    52,    53,    54,    55,    56,    57,
+      58,     3,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,
+      -1,    -1,    24,    -1,    26,    27,    28,    29,    30,    31,
+      32,    33,    34,    35,    36,    37,    38,    39,    40,    41,
+      42,    43,    44,    45,    46,    47,    48,    49,    50,    51,
+      52,    53,    54,    55,    56,    57,    58,     3,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,    -1,
+      26,    27,    28,    29,    30,    31,    32,    33,    34,    35,
+      36,    37,    38,    39,    40,    41,    42,    43,    44,    45,
+      46,    47,    48,    49,    50,    51,    52,    53,    54,    55,
+      56,    57,    58,     4,     5,    -1,    -1,    -1,    -1,    -1,
+      -1,    -1,    -1,    -1,    -1,    16,    17,    18,    19,    20,
+      21,    22,    23,    -1,    25,    26,    27,    28,    29,    30,
+      31,    32,    33,    -1,    -1,    -1,    -1,    -1,    39,    40,
+      41,    42,    43,    44,    45,    46,    47,    48,    49,    50,
+      51,    52,    53,    54,    55,    56,    57,    58
 };
 
-  /* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-     symbol of state STATE-NUM.  */
-static const yytype_uint8 yystos[] =
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
 {
        0,     5,    16,    17,    18,    19,    20,    21,    22,    23,
-      25,    28,    29,    30,    31,    32,    33,    35,     3,     3,
-       3,     3,     3,     3,     3,     3,     0,    30,     4,    11,
-      36,    34,     3,    37,    38,    39,    40,    36,     7,    12,
-       8,    11,    14,    15,    38,    39,     6,    39,    41,    42,
-      45,    46,    47,    39,    39,    10,    39,    49,     9,    48,
-       7,    12,     8,    13,     6,    11,    15,    11,    14,    39,
-      10,     3,    42,    46,    24,    39,    43,    44,    49,    41,
-      39,    41,    39,    39,     6,     8,    12,    11,    12,    11,
-      39,    44,    41,    41,    12,    12
+      25,    26,    27,    28,    29,    30,    31,    32,    33,    39,
+      40,    41,    42,    43,    44,    45,    46,    47,    48,    49,
+      50,    51,    52,    53,    54,    55,    56,    57,    58,    61,
+      62,    63,    64,    65,    66,    68,     3,    26,    27,    28,
+      29,    30,    31,    32,    33,    34,    35,    36,    37,    38,
+      39,    40,    41,    42,    43,    44,    45,    46,    47,    48,
+      49,    50,    51,    52,    53,    54,    55,    56,    57,    58,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,     0,    63,     4,    11,
+      69,    67,    70,    71,    72,    73,    74,    69,     7,    12,
+       8,    11,    14,    15,    71,    72,     6,    72,    75,    76,
+      81,    82,    83,    72,    72,    10,    72,    85,     9,    84,
+       7,    12,     8,    13,     6,    11,    15,    11,    14,    72,
+      10,    73,    76,    82,    24,    34,    35,    36,    37,    72,
+      77,    78,    79,    80,    85,    75,    72,    75,    72,    72,
+       6,    78,     8,    38,    12,    11,    12,    11,    72,    79,
+      73,    75,    75,    12,    12
 };
 
-  /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
-static const yytype_uint8 yyr1[] =
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
 {
-       0,    27,    28,    28,    29,    29,    30,    30,    31,    31,
-      31,    31,    31,    31,    31,    31,    32,    32,    33,    33,
-      34,    35,    36,    37,    37,    38,    38,    38,    38,    38,
-      39,    40,    40,    41,    41,    42,    43,    43,    44,    44,
-      45,    45,    46,    46,    46,    46,    47,    48,    48,    49,
-      49,    49,    49
+       0,    60,    61,    61,    62,    62,    63,    63,    64,    64,
+      64,    64,    64,    64,    64,    64,    64,    64,    64,    64,
+      64,    64,    64,    64,    64,    64,    64,    64,    64,    64,
+      64,    64,    64,    64,    64,    64,    64,    64,    64,    64,
+      64,    64,    64,    64,    65,    65,    66,    66,    67,    68,
+      69,    70,    70,    71,    71,    71,    71,    71,    72,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    74,    74,    75,    75,    76,    76,    77,
+      77,    77,    77,    78,    78,    79,    79,    80,    80,    81,
+      81,    82,    82,    82,    82,    83,    84,    84,    85,    85,
+      85,    85
 };
 
-  /* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
-static const yytype_uint8 yyr2[] =
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
 {
        0,     2,     0,     1,     1,     2,     1,     1,     2,     2,
-       2,     2,     2,     2,     2,     2,     4,     3,     0,     1,
-       0,     0,     3,     1,     3,     4,     6,     6,     8,     8,
-       1,     1,     3,     1,     3,     3,     1,     3,     3,     1,
-       1,     3,     0,     1,     2,     3,     2,     0,     2,     1,
-       2,     2,     3
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     4,     3,     0,     1,     0,     0,
+       3,     1,     3,     4,     6,     6,     8,     8,     1,     1,
+       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
+       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
+       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
+       1,     1,     1,     1,     3,     1,     3,     3,     4,     1,
+       1,     1,     1,     1,     3,     1,     3,     3,     1,     1,
+       3,     0,     1,     2,     3,     2,     0,     2,     1,     2,
+       2,     3
 };
 
 
+enum { YYENOMEM = -2 };
+
 #define yyerrok         (yyerrstatus = 0)
 #define yyclearin       (yychar = YYEMPTY)
-#define YYEMPTY         (-2)
-#define YYEOF           0
 
 #define YYACCEPT        goto yyacceptlab
 #define YYABORT         goto yyabortlab
 #define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
 
 #define YYRECOVERING()  (!!yyerrstatus)
 
-#define YYBACKUP(Token, Value)                                  \
-do                                                              \
-  if (yychar == YYEMPTY)                                        \
-    {                                                           \
-      yychar = (Token);                                         \
-      yylval = (Value);                                         \
-      YYPOPSTACK (yylen);                                       \
-      yystate = *yyssp;                                         \
-      goto yybackup;                                            \
-    }                                                           \
-  else                                                          \
-    {                                                           \
-      yyerror (YY_("syntax error: cannot back up")); \
-      YYERROR;                                                  \
-    }                                                           \
-while (0)
-
-/* Error token number */
-#define YYTERROR        1
-#define YYERRCODE       256
-
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
 
 
 /* Enable debugging if requested.  */
@@ -811,55 +1085,52 @@ do {                                            \
     YYFPRINTF Args;                             \
 } while (0)
 
-/* This macro is provided for backward compatibility. */
-#ifndef YY_LOCATION_PRINT
-# define YY_LOCATION_PRINT(File, Loc) ((void) 0)
-#endif
 
 
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)                    \
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
 do {                                                                      \
   if (yydebug)                                                            \
     {                                                                     \
       YYFPRINTF (stderr, "%s ", Title);                                   \
       yy_symbol_print (stderr,                                            \
-                  Type, Value); \
+                  Kind, Value); \
       YYFPRINTF (stderr, "\n");                                           \
     }                                                                     \
 } while (0)
 
 
-/*----------------------------------------.
-| Print this symbol's value on YYOUTPUT.  |
-`----------------------------------------*/
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
 
 static void
-yy_symbol_value_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep)
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
 {
-  FILE *yyo = yyoutput;
-  YYUSE (yyo);
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
   if (!yyvaluep)
     return;
-# ifdef YYPRINT
-  if (yytype < YYNTOKENS)
-    YYPRINT (yyoutput, yytoknum[yytype], *yyvaluep);
-# endif
-  YYUSE (yytype);
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
-/*--------------------------------.
-| Print this symbol on YYOUTPUT.  |
-`--------------------------------*/
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
 
 static void
-yy_symbol_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep)
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
 {
-  YYFPRINTF (yyoutput, "%s %s (",
-             yytype < YYNTOKENS ? "token" : "nterm", yytname[yytype]);
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print (yyoutput, yytype, yyvaluep);
-  YYFPRINTF (yyoutput, ")");
+  yy_symbol_value_print (yyo, yykind, yyvaluep);
+  YYFPRINTF (yyo, ")");
 }
 
 /*------------------------------------------------------------------.
@@ -868,7 +1139,7 @@ yy_symbol_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep)
 `------------------------------------------------------------------*/
 
 static void
-yy_stack_print (yytype_int16 *yybottom, yytype_int16 *yytop)
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
 {
   YYFPRINTF (stderr, "Stack now");
   for (; yybottom <= yytop; yybottom++)
@@ -891,21 +1162,21 @@ do {                                                            \
 `------------------------------------------------*/
 
 static void
-yy_reduce_print (yytype_int16 *yyssp, YYSTYPE *yyvsp, int yyrule)
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule)
 {
-  unsigned long int yylno = yyrline[yyrule];
+  int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
   int yyi;
-  YYFPRINTF (stderr, "Reducing stack by rule %d (line %lu):\n",
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
              yyrule - 1, yylno);
   /* The symbols being reduced.  */
   for (yyi = 0; yyi < yynrhs; yyi++)
     {
       YYFPRINTF (stderr, "   $%d = ", yyi + 1);
       yy_symbol_print (stderr,
-                       yystos[yyssp[yyi + 1 - yynrhs]],
-                       &(yyvsp[(yyi + 1) - (yynrhs)])
-                                              );
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)]);
       YYFPRINTF (stderr, "\n");
     }
 }
@@ -920,8 +1191,8 @@ do {                                    \
    multiple parsers can coexist.  */
 int yydebug;
 #else /* !YYDEBUG */
-# define YYDPRINTF(Args)
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
 # define YY_STACK_PRINT(Bottom, Top)
 # define YY_REDUCE_PRINT(Rule)
 #endif /* !YYDEBUG */
@@ -944,249 +1215,30 @@ int yydebug;
 #endif
 
 
-#if YYERROR_VERBOSE
 
-# ifndef yystrlen
-#  if defined __GLIBC__ && defined _STRING_H
-#   define yystrlen strlen
-#  else
-/* Return the length of YYSTR.  */
-static YYSIZE_T
-yystrlen (const char *yystr)
-{
-  YYSIZE_T yylen;
-  for (yylen = 0; yystr[yylen]; yylen++)
-    continue;
-  return yylen;
-}
-#  endif
-# endif
 
-# ifndef yystpcpy
-#  if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
-#   define yystpcpy stpcpy
-#  else
-/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
-   YYDEST.  */
-static char *
-yystpcpy (char *yydest, const char *yysrc)
-{
-  char *yyd = yydest;
-  const char *yys = yysrc;
 
-  while ((*yyd++ = *yys++) != '\0')
-    continue;
-
-  return yyd - 1;
-}
-#  endif
-# endif
-
-# ifndef yytnamerr
-/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
-   quotes and backslashes, so that it's suitable for yyerror.  The
-   heuristic is that double-quoting is unnecessary unless the string
-   contains an apostrophe, a comma, or backslash (other than
-   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
-   null, do not copy; instead, return the length of what the result
-   would have been.  */
-static YYSIZE_T
-yytnamerr (char *yyres, const char *yystr)
-{
-  if (*yystr == '"')
-    {
-      YYSIZE_T yyn = 0;
-      char const *yyp = yystr;
-
-      for (;;)
-        switch (*++yyp)
-          {
-          case '\'':
-          case ',':
-            goto do_not_strip_quotes;
-
-          case '\\':
-            if (*++yyp != '\\')
-              goto do_not_strip_quotes;
-            /* Fall through.  */
-          default:
-            if (yyres)
-              yyres[yyn] = *yyp;
-            yyn++;
-            break;
-
-          case '"':
-            if (yyres)
-              yyres[yyn] = '\0';
-            return yyn;
-          }
-    do_not_strip_quotes: ;
-    }
-
-  if (! yyres)
-    return yystrlen (yystr);
-
-  return yystpcpy (yyres, yystr) - yyres;
-}
-# endif
-
-/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
-   about the unexpected token YYTOKEN for the state stack whose top is
-   YYSSP.
-
-   Return 0 if *YYMSG was successfully written.  Return 1 if *YYMSG is
-   not large enough to hold the message.  In that case, also set
-   *YYMSG_ALLOC to the required number of bytes.  Return 2 if the
-   required number of bytes is too large to store.  */
-static int
-yysyntax_error (YYSIZE_T *yymsg_alloc, char **yymsg,
-                yytype_int16 *yyssp, int yytoken)
-{
-  YYSIZE_T yysize0 = yytnamerr (YY_NULLPTR, yytname[yytoken]);
-  YYSIZE_T yysize = yysize0;
-  enum { YYERROR_VERBOSE_ARGS_MAXIMUM = 5 };
-  /* Internationalized format string. */
-  const char *yyformat = YY_NULLPTR;
-  /* Arguments of yyformat. */
-  char const *yyarg[YYERROR_VERBOSE_ARGS_MAXIMUM];
-  /* Number of reported tokens (one for the "unexpected", one per
-     "expected"). */
-  int yycount = 0;
-
-  /* There are many possibilities here to consider:
-     - If this state is a consistent state with a default action, then
-       the only way this function was invoked is if the default action
-       is an error action.  In that case, don't check for expected
-       tokens because there are none.
-     - The only way there can be no lookahead present (in yychar) is if
-       this state is a consistent state with a default action.  Thus,
-       detecting the absence of a lookahead is sufficient to determine
-       that there is no unexpected or expected token to report.  In that
-       case, just report a simple "syntax error".
-     - Don't assume there isn't a lookahead just because this state is a
-       consistent state with a default action.  There might have been a
-       previous inconsistent state, consistent state with a non-default
-       action, or user semantic action that manipulated yychar.
-     - Of course, the expected token list depends on states to have
-       correct lookahead information, and it depends on the parser not
-       to perform extra reductions after fetching a lookahead from the
-       scanner and before detecting a syntax error.  Thus, state merging
-       (from LALR or IELR) and default reductions corrupt the expected
-       token list.  However, the list is correct for canonical LR with
-       one exception: it will still contain any token that will not be
-       accepted due to an error action in a later state.
-  */
-  if (yytoken != YYEMPTY)
-    {
-      int yyn = yypact[*yyssp];
-      yyarg[yycount++] = yytname[yytoken];
-      if (!yypact_value_is_default (yyn))
-        {
-          /* Start YYX at -YYN if negative to avoid negative indexes in
-             YYCHECK.  In other words, skip the first -YYN actions for
-             this state because they are default actions.  */
-          int yyxbegin = yyn < 0 ? -yyn : 0;
-          /* Stay within bounds of both yycheck and yytname.  */
-          int yychecklim = YYLAST - yyn + 1;
-          int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
-          int yyx;
-
-          for (yyx = yyxbegin; yyx < yyxend; ++yyx)
-            if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR
-                && !yytable_value_is_error (yytable[yyx + yyn]))
-              {
-                if (yycount == YYERROR_VERBOSE_ARGS_MAXIMUM)
-                  {
-                    yycount = 1;
-                    yysize = yysize0;
-                    break;
-                  }
-                yyarg[yycount++] = yytname[yyx];
-                {
-                  YYSIZE_T yysize1 = yysize + yytnamerr (YY_NULLPTR, yytname[yyx]);
-                  if (! (yysize <= yysize1
-                         && yysize1 <= YYSTACK_ALLOC_MAXIMUM))
-                    return 2;
-                  yysize = yysize1;
-                }
-              }
-        }
-    }
-
-  switch (yycount)
-    {
-# define YYCASE_(N, S)                      \
-      case N:                               \
-        yyformat = S;                       \
-      break
-      YYCASE_(0, YY_("syntax error"));
-      YYCASE_(1, YY_("syntax error, unexpected %s"));
-      YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
-      YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
-      YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
-      YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
-# undef YYCASE_
-    }
-
-  {
-    YYSIZE_T yysize1 = yysize + yystrlen (yyformat);
-    if (! (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM))
-      return 2;
-    yysize = yysize1;
-  }
-
-  if (*yymsg_alloc < yysize)
-    {
-      *yymsg_alloc = 2 * yysize;
-      if (! (yysize <= *yymsg_alloc
-             && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
-        *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
-      return 1;
-    }
-
-  /* Avoid sprintf, as that infringes on the user's name space.
-     Don't have undefined behavior even if the translation
-     produced a string with the wrong number of "%s"s.  */
-  {
-    char *yyp = *yymsg;
-    int yyi = 0;
-    while ((*yyp = *yyformat) != '\0')
-      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
-        {
-          yyp += yytnamerr (yyp, yyarg[yyi++]);
-          yyformat += 2;
-        }
-      else
-        {
-          yyp++;
-          yyformat++;
-        }
-  }
-  return 0;
-}
-#endif /* YYERROR_VERBOSE */
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
 static void
-yydestruct (const char *yymsg, int yytype, YYSTYPE *yyvaluep)
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep)
 {
-  YYUSE (yyvaluep);
+  YY_USE (yyvaluep);
   if (!yymsg)
     yymsg = "Deleting";
-  YY_SYMBOL_PRINT (yymsg, yytype, yyvaluep, yylocationp);
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
-
-
-/* The lookahead symbol.  */
+/* Lookahead token kind.  */
 int yychar;
 
 /* The semantic value of the lookahead symbol.  */
@@ -1195,6 +1247,8 @@ YYSTYPE yylval;
 int yynerrs;
 
 
+
+
 /*----------.
 | yyparse.  |
 `----------*/
@@ -1202,43 +1256,36 @@ int yynerrs;
 int
 yyparse (void)
 {
-    int yystate;
+    yy_state_fast_t yystate = 0;
     /* Number of tokens to shift before error messages enabled.  */
-    int yyerrstatus;
-
-    /* The stacks and their tools:
-       'yyss': related to states.
-       'yyvs': related to semantic values.
+    int yyerrstatus = 0;
 
-       Refer to the stacks through separate pointers, to allow yyoverflow
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
        to reallocate them elsewhere.  */
 
-    /* The state stack.  */
-    yytype_int16 yyssa[YYINITDEPTH];
-    yytype_int16 *yyss;
-    yytype_int16 *yyssp;
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
 
-    /* The semantic value stack.  */
-    YYSTYPE yyvsa[YYINITDEPTH];
-    YYSTYPE *yyvs;
-    YYSTYPE *yyvsp;
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
 
-    YYSIZE_T yystacksize;
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
 
   int yyn;
+  /* The return value of yyparse.  */
   int yyresult;
-  /* Lookahead token as an internal (translated) token number.  */
-  int yytoken = 0;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
 
-#if YYERROR_VERBOSE
-  /* Buffer for error messages, and its allocated size.  */
-  char yymsgbuf[128];
-  char *yymsg = yymsgbuf;
-  YYSIZE_T yymsg_alloc = sizeof yymsgbuf;
-#endif
+
 
 #define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
 
@@ -1246,71 +1293,75 @@ yyparse (void)
      Keep to zero when no symbol should be popped.  */
   int yylen = 0;
 
-  yyssp = yyss = yyssa;
-  yyvsp = yyvs = yyvsa;
-  yystacksize = YYINITDEPTH;
-
   YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
   yychar = YYEMPTY; /* Cause a token to be read.  */
+
   goto yysetstate;
 
+
 /*------------------------------------------------------------.
-| yynewstate -- Push a new state, which is found in yystate.  |
+| yynewstate -- push a new state, which is found in yystate.  |
 `------------------------------------------------------------*/
- yynewstate:
+yynewstate:
   /* In all cases, when you get here, the value and location stacks
      have just been pushed.  So pushing a state here evens the stacks.  */
   yyssp++;
 
- yysetstate:
-  *yyssp = yystate;
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
     {
       /* Get the current used size of the three stacks, in elements.  */
-      YYSIZE_T yysize = yyssp - yyss + 1;
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
 
-#ifdef yyoverflow
+# if defined yyoverflow
       {
         /* Give user a chance to reallocate the stack.  Use copies of
            these so that the &'s don't force the real ones into
            memory.  */
+        yy_state_t *yyss1 = yyss;
         YYSTYPE *yyvs1 = yyvs;
-        yytype_int16 *yyss1 = yyss;
 
         /* Each stack pointer address is followed by the size of the
            data in use in that stack, in bytes.  This used to be a
            conditional around just the two extra args, but that might
            be undefined if yyoverflow is a macro.  */
         yyoverflow (YY_("memory exhausted"),
-                    &yyss1, yysize * sizeof (*yyssp),
-                    &yyvs1, yysize * sizeof (*yyvsp),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
                     &yystacksize);
-
         yyss = yyss1;
         yyvs = yyvs1;
       }
-#else /* no yyoverflow */
-# ifndef YYSTACK_RELOCATE
-      goto yyexhaustedlab;
-# else
+# else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-        goto yyexhaustedlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
         yystacksize = YYMAXDEPTH;
 
       {
-        yytype_int16 *yyss1 = yyss;
+        yy_state_t *yyss1 = yyss;
         union yyalloc *yyptr =
-          (union yyalloc *) YYSTACK_ALLOC (YYSTACK_BYTES (yystacksize));
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
         if (! yyptr)
-          goto yyexhaustedlab;
+          YYNOMEM;
         YYSTACK_RELOCATE (yyss_alloc, yyss);
         YYSTACK_RELOCATE (yyvs_alloc, yyvs);
 #  undef YYSTACK_RELOCATE
@@ -1318,30 +1369,31 @@ yyparse (void)
           YYSTACK_FREE (yyss1);
       }
 # endif
-#endif /* no yyoverflow */
 
       yyssp = yyss + yysize - 1;
       yyvsp = yyvs + yysize - 1;
 
-      YYDPRINTF ((stderr, "Stack size increased to %lu\n",
-                  (unsigned long int) yystacksize));
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
 
       if (yyss + yystacksize - 1 <= yyssp)
         YYABORT;
     }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
-  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
 
   if (yystate == YYFINAL)
     YYACCEPT;
 
   goto yybackup;
 
+
 /*-----------.
 | yybackup.  |
 `-----------*/
 yybackup:
-
   /* Do appropriate processing given the current state.  Read a
      lookahead token if we need one and don't already have one.  */
 
@@ -1352,18 +1404,29 @@ yybackup:
 
   /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid lookahead symbol.  */
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
   if (yychar == YYEMPTY)
     {
-      YYDPRINTF ((stderr, "Reading a token: "));
+      YYDPRINTF ((stderr, "Reading a token\n"));
       yychar = yylex ();
     }
 
   if (yychar <= YYEOF)
     {
-      yychar = yytoken = YYEOF;
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
       YYDPRINTF ((stderr, "Now at end of input.\n"));
     }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
   else
     {
       yytoken = YYTRANSLATE (yychar);
@@ -1391,15 +1454,13 @@ yybackup:
 
   /* Shift the lookahead token.  */
   YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
-
-  /* Discard the shifted token.  */
-  yychar = YYEMPTY;
-
   yystate = yyn;
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
   goto yynewstate;
 
 
@@ -1414,7 +1475,7 @@ yydefault:
 
 
 /*-----------------------------.
-| yyreduce -- Do a reduction.  |
+| yyreduce -- do a reduction.  |
 `-----------------------------*/
 yyreduce:
   /* yyn is the number of a rule to reduce with.  */
@@ -1434,368 +1495,586 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-        case 6:
-#line 190 "conf.y" /* yacc.c:1646  */
-    { entry_vector-> push((yyvsp[0].entry_type)); }
-#line 1441 "yconf.c" /* yacc.c:1646  */
+  case 6: /* stmt: entry  */
+#line 280 "conf.y"
+                      { entry_vector-> push((yyvsp[0].entry_type)); }
+#line 1502 "yconf.c"
     break;
 
-  case 8:
-#line 193 "conf.y" /* yacc.c:1646  */
-    { conf_user = solve_user(conf_ident); }
-#line 1447 "yconf.c" /* yacc.c:1646  */
+  case 8: /* global_option: TK_USER ident  */
+#line 283 "conf.y"
+                              { conf_user = solve_user(conf_ident); }
+#line 1508 "yconf.c"
     break;
 
-  case 9:
-#line 194 "conf.y" /* yacc.c:1646  */
-    { conf_group = solve_group(conf_ident); }
-#line 1453 "yconf.c" /* yacc.c:1646  */
+  case 9: /* global_option: TK_GROUP ident  */
+#line 284 "conf.y"
+                               { conf_group = solve_group(conf_ident); }
+#line 1514 "yconf.c"
     break;
 
-  case 10:
-#line 195 "conf.y" /* yacc.c:1646  */
-    { conf_listen = solve_hostname(conf_ident); }
-#line 1459 "yconf.c" /* yacc.c:1646  */
+  case 10: /* global_option: TK_LISTEN ident  */
+#line 285 "conf.y"
+                                { conf_listen = solve_hostname(conf_ident); }
+#line 1520 "yconf.c"
     break;
 
-  case 11:
-#line 196 "conf.y" /* yacc.c:1646  */
-    { conf_xor_key = atoll(conf_ident); }
-#line 1465 "yconf.c" /* yacc.c:1646  */
+  case 11: /* global_option: TK_XOR_KEY ident  */
+#line 286 "conf.y"
+                                 { conf_xor_key = atoll(conf_ident); }
+#line 1526 "yconf.c"
     break;
 
-  case 12:
-#line 197 "conf.y" /* yacc.c:1646  */
-    { conf_confusing_key = atoll(conf_ident); }
-#line 1471 "yconf.c" /* yacc.c:1646  */
+  case 12: /* global_option: TK_CONFUSING_KEY ident  */
+#line 287 "conf.y"
+                                       { conf_confusing_key = atoll(conf_ident); }
+#line 1532 "yconf.c"
     break;
 
-  case 13:
-#line 198 "conf.y" /* yacc.c:1646  */
-    { conf_is_remote_server = conf_ident[0]=='Y' ||  conf_ident[0]=='y';}
-#line 1477 "yconf.c" /* yacc.c:1646  */
+  case 13: /* global_option: TK_REMOTE_SERVER ident  */
+#line 288 "conf.y"
+                                       { conf_is_remote_server = yes_value(conf_ident); }
+#line 1538 "yconf.c"
     break;
 
-  case 14:
-#line 199 "conf.y" /* yacc.c:1646  */
-    {
+  case 14: /* global_option: TK_WORKERS ident  */
+#line 289 "conf.y"
+                                 { conf_opts.workers = positive_value(conf_ident); }
+#line 1544 "yconf.c"
+    break;
+
+  case 15: /* global_option: TK_CPU_AFFINITY ident  */
+#line 290 "conf.y"
+                                      { conf_opts.cpu_affinity = yes_value(conf_ident); }
+#line 1550 "yconf.c"
+    break;
+
+  case 16: /* global_option: TK_IO_URING ident  */
+#line 291 "conf.y"
+                                  { conf_opts.io_uring = yes_value(conf_ident); }
+#line 1556 "yconf.c"
+    break;
+
+  case 17: /* global_option: TK_CONNECT_TIMEOUT ident  */
+#line 292 "conf.y"
+                                         { conf_opts.connect_timeout = positive_value(conf_ident); }
+#line 1562 "yconf.c"
+    break;
+
+  case 18: /* global_option: TK_HANDSHAKE_TIMEOUT ident  */
+#line 293 "conf.y"
+                                           { conf_opts.handshake_timeout = positive_value(conf_ident); }
+#line 1568 "yconf.c"
+    break;
+
+  case 19: /* global_option: TK_PLAIN ident  */
+#line 294 "conf.y"
+                               { conf_opts.plain = yes_value(conf_ident); }
+#line 1574 "yconf.c"
+    break;
+
+  case 20: /* global_option: TK_EJECT_AFTER ident  */
+#line 295 "conf.y"
+                                     { conf_opts.eject_after = count_value(conf_ident); }
+#line 1580 "yconf.c"
+    break;
+
+  case 21: /* global_option: TK_HEALTH_CHECK ident  */
+#line 296 "conf.y"
+                                      { conf_opts.health_check = count_value(conf_ident); }
+#line 1586 "yconf.c"
+    break;
+
+  case 22: /* global_option: TK_WARM_POOL ident  */
+#line 297 "conf.y"
+                                   { conf_opts.warm_pool = count_value(conf_ident); }
+#line 1592 "yconf.c"
+    break;
+
+  case 23: /* global_option: TK_MUX ident  */
+#line 298 "conf.y"
+                             { conf_opts.mux = count_value(conf_ident); }
+#line 1598 "yconf.c"
+    break;
+
+  case 24: /* global_option: TK_FAST_OPEN ident  */
+#line 299 "conf.y"
+                                   { conf_opts.fast_open = count_value(conf_ident); }
+#line 1604 "yconf.c"
+    break;
+
+  case 25: /* global_option: TK_PIPELINE_KEYS ident  */
+#line 300 "conf.y"
+                                       { conf_opts.pipeline_keys = yes_value(conf_ident); }
+#line 1610 "yconf.c"
+    break;
+
+  case 26: /* global_option: TK_BACKLOG ident  */
+#line 301 "conf.y"
+                                 { conf_opts.backlog = positive_value(conf_ident); }
+#line 1616 "yconf.c"
+    break;
+
+  case 27: /* global_option: TK_NODELAY ident  */
+#line 302 "conf.y"
+                                 { conf_opts.nodelay = yes_value(conf_ident); }
+#line 1622 "yconf.c"
+    break;
+
+  case 28: /* global_option: TK_SEND_BUFFER ident  */
+#line 303 "conf.y"
+                                     { conf_opts.send_buffer = count_value(conf_ident); }
+#line 1628 "yconf.c"
+    break;
+
+  case 29: /* global_option: TK_RECEIVE_BUFFER ident  */
+#line 304 "conf.y"
+                                        { conf_opts.receive_buffer = count_value(conf_ident); }
+#line 1634 "yconf.c"
+    break;
+
+  case 30: /* global_option: TK_KEEPALIVE ident  */
+#line 305 "conf.y"
+                                   { conf_opts.keepalive = count_value(conf_ident); }
+#line 1640 "yconf.c"
+    break;
+
+  case 31: /* global_option: TK_NOTSENT_LOWAT ident  */
+#line 306 "conf.y"
+                                       { conf_opts.notsent_lowat = count_value(conf_ident); }
+#line 1646 "yconf.c"
+    break;
+
+  case 32: /* global_option: TK_MAX_CONNECTIONS ident  */
+#line 307 "conf.y"
+                                         { conf_opts.max_connections = count_value(conf_ident); }
+#line 1652 "yconf.c"
+    break;
+
+  case 33: /* global_option: TK_MAX_PER_SOURCE ident  */
+#line 308 "conf.y"
+                                        { conf_opts.max_per_source = count_value(conf_ident); }
+#line 1658 "yconf.c"
+    break;
+
+  case 34: /* global_option: TK_IDLE_TIMEOUT ident  */
+#line 309 "conf.y"
+                                      { conf_opts.idle_timeout = count_value(conf_ident); }
+#line 1664 "yconf.c"
+    break;
+
+  case 35: /* global_option: TK_SESSION_TIMEOUT ident  */
+#line 310 "conf.y"
+                                         { conf_opts.session_timeout = count_value(conf_ident); }
+#line 1670 "yconf.c"
+    break;
+
+  case 36: /* global_option: TK_ACCEPT_RATE ident  */
+#line 311 "conf.y"
+                                     { conf_opts.accept_rate = count_value(conf_ident); }
+#line 1676 "yconf.c"
+    break;
+
+  case 37: /* global_option: TK_ACCEPT_BURST ident  */
+#line 312 "conf.y"
+                                      { conf_opts.accept_burst = count_value(conf_ident); }
+#line 1682 "yconf.c"
+    break;
+
+  case 38: /* global_option: TK_ACCEPT_PREFIX ident  */
+#line 313 "conf.y"
+                                       { conf_opts.accept_prefix = prefix_value(conf_ident); }
+#line 1688 "yconf.c"
+    break;
+
+  case 39: /* global_option: TK_DNS_TTL ident  */
+#line 314 "conf.y"
+                                 { conf_opts.dns_ttl = positive_value(conf_ident); }
+#line 1694 "yconf.c"
+    break;
+
+  case 40: /* global_option: TK_DNS_NEGATIVE_TTL ident  */
+#line 315 "conf.y"
+                                          { conf_opts.dns_negative_ttl = positive_value(conf_ident); }
+#line 1700 "yconf.c"
+    break;
+
+  case 41: /* global_option: TK_DNS_STALE ident  */
+#line 316 "conf.y"
+                                   { conf_opts.dns_stale = count_value(conf_ident); }
+#line 1706 "yconf.c"
+    break;
+
+  case 42: /* global_option: TK_SOURCE ident  */
+#line 317 "conf.y"
+                                {
 					conf_source = solve_hostname(conf_ident); 
 					conf_src = &conf_source;
 		}
-#line 1486 "yconf.c" /* yacc.c:1646  */
+#line 1715 "yconf.c"
     break;
 
-  case 15:
-#line 203 "conf.y" /* yacc.c:1646  */
-    { conf_listen = solve_hostname(conf_ident); }
-#line 1492 "yconf.c" /* yacc.c:1646  */
+  case 43: /* global_option: TK_BIND ident  */
+#line 321 "conf.y"
+                              { conf_listen = solve_hostname(conf_ident); }
+#line 1721 "yconf.c"
     break;
 
-  case 16:
-#line 205 "conf.y" /* yacc.c:1646  */
-    { (yyval.entry_type) = new entry(P_TCP, (yyvsp[0].map_list_type), (yyvsp[-3].bool_type)); }
-#line 1498 "yconf.c" /* yacc.c:1646  */
+  case 44: /* entry: fragile TK_TCP set_proto_tcp section  */
+#line 323 "conf.y"
+                                                    { (yyval.entry_type) = new entry(P_TCP, (yyvsp[0].map_list_type), (yyvsp[-3].bool_type)); }
+#line 1727 "yconf.c"
     break;
 
-  case 17:
-#line 206 "conf.y" /* yacc.c:1646  */
-    { (yyval.entry_type) = new entry(P_UDP, (yyvsp[0].map_list_type), 0 /* false */); }
-#line 1504 "yconf.c" /* yacc.c:1646  */
+  case 45: /* entry: TK_UDP set_proto_udp section  */
+#line 324 "conf.y"
+                                                    { (yyval.entry_type) = new entry(P_UDP, (yyvsp[0].map_list_type), 0 /* false */); }
+#line 1733 "yconf.c"
     break;
 
-  case 18:
-#line 208 "conf.y" /* yacc.c:1646  */
-    { (yyval.bool_type) = 0; /* false */ }
-#line 1510 "yconf.c" /* yacc.c:1646  */
+  case 46: /* fragile: %empty  */
+#line 326 "conf.y"
+                     { (yyval.bool_type) = 0; /* false */ }
+#line 1739 "yconf.c"
     break;
 
-  case 19:
-#line 209 "conf.y" /* yacc.c:1646  */
-    { (yyval.bool_type) = 1; /* true */ }
-#line 1516 "yconf.c" /* yacc.c:1646  */
+  case 47: /* fragile: TK_FRAGILE  */
+#line 327 "conf.y"
+                    { (yyval.bool_type) = 1; /* true */ }
+#line 1745 "yconf.c"
     break;
 
-  case 20:
-#line 211 "conf.y" /* yacc.c:1646  */
-    { set_protoname(P_TCP); }
-#line 1522 "yconf.c" /* yacc.c:1646  */
+  case 48: /* set_proto_tcp: %empty  */
+#line 329 "conf.y"
+                { set_protoname(P_TCP); }
+#line 1751 "yconf.c"
     break;
 
-  case 21:
-#line 212 "conf.y" /* yacc.c:1646  */
-    { set_protoname(P_UDP); }
-#line 1528 "yconf.c" /* yacc.c:1646  */
+  case 49: /* set_proto_udp: %empty  */
+#line 330 "conf.y"
+                { set_protoname(P_UDP); }
+#line 1757 "yconf.c"
     break;
 
-  case 22:
-#line 214 "conf.y" /* yacc.c:1646  */
-    { (yyval.map_list_type) = (yyvsp[-1].map_list_type); }
-#line 1534 "yconf.c" /* yacc.c:1646  */
+  case 50: /* section: TK_LBRACE map_list TK_RBRACE  */
+#line 332 "conf.y"
+                                             { (yyval.map_list_type) = (yyvsp[-1].map_list_type); }
+#line 1763 "yconf.c"
     break;
 
-  case 23:
-#line 216 "conf.y" /* yacc.c:1646  */
-    {
+  case 51: /* map_list: map  */
+#line 334 "conf.y"
+                    {
 			map_vector = new vector<proto_map*>();
 			map_vector->push((yyvsp[0].map_type));
 			(yyval.map_list_type) = map_vector;
 		}
-#line 1544 "yconf.c" /* yacc.c:1646  */
+#line 1773 "yconf.c"
     break;
 
-  case 24:
-#line 221 "conf.y" /* yacc.c:1646  */
-    {
+  case 52: /* map_list: map_list TK_SCOLON map  */
+#line 339 "conf.y"
+                                       {
 			map_vector->push((yyvsp[0].map_type));
 			(yyval.map_list_type) = map_vector;
 		}
-#line 1553 "yconf.c" /* yacc.c:1646  */
+#line 1782 "yconf.c"
     break;
 
-  case 25:
-#line 226 "conf.y" /* yacc.c:1646  */
-    {
-			(yyval.map_type) = new proto_map((yyvsp[-3].port_list_type), (yyvsp[-1].host_list_type), 0, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+  case 53: /* map: port_list TK_LBRACE host_list TK_RBRACE  */
+#line 344 "conf.y"
+                                                        {
+			(yyval.map_type) = new proto_map((yyvsp[-3].port_list_type), (yyvsp[-1].host_list_type), 0, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		}
-#line 1561 "yconf.c" /* yacc.c:1646  */
+#line 1790 "yconf.c"
     break;
 
-  case 26:
-#line 229 "conf.y" /* yacc.c:1646  */
-    {
+  case 54: /* map: port_list TK_ACTV name TK_LBRACE host_list TK_RBRACE  */
+#line 347 "conf.y"
+                                                                     {
 		        struct ip_addr ip = use_hostname((yyvsp[-3].str_type));
-			(yyval.map_type) = new proto_map((yyvsp[-5].port_list_type), (yyvsp[-1].host_list_type), &ip, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			(yyval.map_type) = new proto_map((yyvsp[-5].port_list_type), (yyvsp[-1].host_list_type), &ip, 0, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		}
-#line 1570 "yconf.c" /* yacc.c:1646  */
+#line 1799 "yconf.c"
     break;
 
-  case 27:
-#line 233 "conf.y" /* yacc.c:1646  */
-    {
+  case 55: /* map: port_list TK_PASV name TK_LBRACE host_list TK_RBRACE  */
+#line 351 "conf.y"
+                                                                     {
 		        struct ip_addr ip = use_hostname((yyvsp[-3].str_type));
-			(yyval.map_type) = new proto_map((yyvsp[-5].port_list_type), (yyvsp[-1].host_list_type), 0, &ip, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			(yyval.map_type) = new proto_map((yyvsp[-5].port_list_type), (yyvsp[-1].host_list_type), 0, &ip, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		}
-#line 1579 "yconf.c" /* yacc.c:1646  */
+#line 1808 "yconf.c"
     break;
 
-  case 28:
-#line 237 "conf.y" /* yacc.c:1646  */
-    {
+  case 56: /* map: port_list TK_ACTV name TK_PASV name TK_LBRACE host_list TK_RBRACE  */
+#line 355 "conf.y"
+                                                                                  {
 		        struct ip_addr ip1 = use_hostname((yyvsp[-5].str_type));
 		        struct ip_addr ip2 = use_hostname((yyvsp[-3].str_type));
-			(yyval.map_type) = new proto_map((yyvsp[-7].port_list_type), (yyvsp[-1].host_list_type), &ip1, &ip2, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			(yyval.map_type) = new proto_map((yyvsp[-7].port_list_type), (yyvsp[-1].host_list_type), &ip1, &ip2, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		}
-#line 1589 "yconf.c" /* yacc.c:1646  */
+#line 1818 "yconf.c"
     break;
 
-  case 29:
-#line 242 "conf.y" /* yacc.c:1646  */
-    {
+  case 57: /* map: port_list TK_PASV name TK_ACTV name TK_LBRACE host_list TK_RBRACE  */
+#line 360 "conf.y"
+                                                                                  {
 		        struct ip_addr ip1 = use_hostname((yyvsp[-5].str_type));
 		        struct ip_addr ip2 = use_hostname((yyvsp[-3].str_type));
-			(yyval.map_type) = new proto_map((yyvsp[-7].port_list_type), (yyvsp[-1].host_list_type), &ip2, &ip1, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server);
+			(yyval.map_type) = new proto_map((yyvsp[-7].port_list_type), (yyvsp[-1].host_list_type), &ip2, &ip1, conf_user, conf_group, conf_listen, conf_src, conf_xor_key, conf_confusing_key, conf_is_remote_server, &conf_opts);
 		}
-#line 1599 "yconf.c" /* yacc.c:1646  */
+#line 1828 "yconf.c"
     break;
 
-  case 30:
-#line 248 "conf.y" /* yacc.c:1646  */
-    { (yyval.str_type) = safe_strdup(conf_ident); }
-#line 1605 "yconf.c" /* yacc.c:1646  */
+  case 58: /* name: ident  */
+#line 366 "conf.y"
+                      { (yyval.str_type) = safe_strdup(conf_ident); }
+#line 1834 "yconf.c"
     break;
 
-  case 31:
-#line 250 "conf.y" /* yacc.c:1646  */
-    {
+  case 93: /* port_list: name  */
+#line 384 "conf.y"
+                     {
 			port_vector = new vector<int>();
 			port_vector->push(use_port((yyvsp[0].str_type)));
 			(yyval.port_list_type) = port_vector; 
 		}
-#line 1615 "yconf.c" /* yacc.c:1646  */
+#line 1844 "yconf.c"
     break;
 
-  case 32:
-#line 255 "conf.y" /* yacc.c:1646  */
-    {
+  case 94: /* port_list: port_list TK_COMMA name  */
+#line 389 "conf.y"
+                                        {
 			port_vector->push(use_port((yyvsp[0].str_type)));
 			(yyval.port_list_type) = port_vector; 
 		}
-#line 1624 "yconf.c" /* yacc.c:1646  */
+#line 1853 "yconf.c"
     break;
 
-  case 33:
-#line 260 "conf.y" /* yacc.c:1646  */
-    {
+  case 95: /* host_list: host_map  */
+#line 394 "conf.y"
+                         {
               		host_vector = new vector<host_map*>();
 			host_vector->push((yyvsp[0].host_map_type));
 			(yyval.host_list_type) = host_vector;
 		}
-#line 1634 "yconf.c" /* yacc.c:1646  */
+#line 1863 "yconf.c"
     break;
 
-  case 34:
-#line 265 "conf.y" /* yacc.c:1646  */
-    {
+  case 96: /* host_list: host_list TK_SCOLON host_map  */
+#line 399 "conf.y"
+                                             {
 			host_vector->push((yyvsp[0].host_map_type));
 			(yyval.host_list_type) = host_vector;
 		}
-#line 1643 "yconf.c" /* yacc.c:1646  */
+#line 1872 "yconf.c"
     break;
 
-  case 35:
-#line 270 "conf.y" /* yacc.c:1646  */
-    {
-			(yyval.host_map_type) = new host_map((yyvsp[-2].from_list_type), (yyvsp[0].dst_list_type));
+  case 97: /* host_map: from_list TK_ARROW dst_list  */
+#line 404 "conf.y"
+                                            {
+			(yyval.host_map_type) = new host_map((yyvsp[-2].from_list_type), (yyvsp[0].dst_list_type), BALANCE_ROUND_ROBIN);
 		}
-#line 1651 "yconf.c" /* yacc.c:1646  */
+#line 1880 "yconf.c"
     break;
 
-  case 36:
-#line 274 "conf.y" /* yacc.c:1646  */
-    {
+  case 98: /* host_map: from_list TK_ARROW balance dst_list  */
+#line 407 "conf.y"
+                                                    {
+			(yyval.host_map_type) = new host_map((yyvsp[-3].from_list_type), (yyvsp[0].dst_list_type), (balance_t) (yyvsp[-1].int_type));
+		}
+#line 1888 "yconf.c"
+    break;
+
+  case 99: /* balance: TK_FAILOVER  */
+#line 411 "conf.y"
+                            { (yyval.int_type) = BALANCE_FAILOVER; }
+#line 1894 "yconf.c"
+    break;
+
+  case 100: /* balance: TK_ROUND_ROBIN  */
+#line 412 "conf.y"
+                               { (yyval.int_type) = BALANCE_ROUND_ROBIN; }
+#line 1900 "yconf.c"
+    break;
+
+  case 101: /* balance: TK_LEAST_CONN  */
+#line 413 "conf.y"
+                              { (yyval.int_type) = BALANCE_LEAST_CONN; }
+#line 1906 "yconf.c"
+    break;
+
+  case 102: /* balance: TK_LEAST_LATENCY  */
+#line 414 "conf.y"
+                                 { (yyval.int_type) = BALANCE_LEAST_LATENCY; }
+#line 1912 "yconf.c"
+    break;
+
+  case 103: /* dst_list: weighted_dst  */
+#line 416 "conf.y"
+                             {
 			dst_vector = new vector<to_addr*>();
 			dst_vector->push((yyvsp[0].dst_type));
 			(yyval.dst_list_type) = dst_vector;
                 }
-#line 1661 "yconf.c" /* yacc.c:1646  */
+#line 1922 "yconf.c"
     break;
 
-  case 37:
-#line 279 "conf.y" /* yacc.c:1646  */
-    {
+  case 104: /* dst_list: dst_list TK_COMMA weighted_dst  */
+#line 421 "conf.y"
+                                               {
 			dst_vector->push((yyvsp[0].dst_type));
 			(yyval.dst_list_type) = dst_vector;
                 }
-#line 1670 "yconf.c" /* yacc.c:1646  */
+#line 1931 "yconf.c"
     break;
 
-  case 38:
-#line 284 "conf.y" /* yacc.c:1646  */
-    {
+  case 105: /* weighted_dst: dst  */
+#line 426 "conf.y"
+                    {
+			(yyval.dst_type) = (yyvsp[0].dst_type);
+		}
+#line 1939 "yconf.c"
+    break;
+
+  case 106: /* weighted_dst: dst TK_WEIGHT ident  */
+#line 429 "conf.y"
+                                    {
+			(yyvsp[-2].dst_type)->set_weight(weight_value(conf_ident));
+			(yyval.dst_type) = (yyvsp[-2].dst_type);
+		}
+#line 1948 "yconf.c"
+    break;
+
+  case 107: /* dst: name TK_COLON name  */
+#line 434 "conf.y"
+                                   {
 			int port = use_port((yyvsp[0].str_type));   /* solve portname */
 			(yyval.dst_type) = use_dstaddr((yyvsp[-2].str_type), port); /* new dst_addr() */
                 }
-#line 1679 "yconf.c" /* yacc.c:1646  */
+#line 1957 "yconf.c"
     break;
 
-  case 39:
-#line 288 "conf.y" /* yacc.c:1646  */
-    {
+  case 108: /* dst: TK_STRING  */
+#line 438 "conf.y"
+                          {
                         (yyval.dst_type) = new director(conf_lex_str_buf);
 		}
-#line 1687 "yconf.c" /* yacc.c:1646  */
+#line 1965 "yconf.c"
     break;
 
-  case 40:
-#line 292 "conf.y" /* yacc.c:1646  */
-    {
+  case 109: /* from_list: from  */
+#line 442 "conf.y"
+                     {
 			from_vector = new vector<from_addr*>();
 			from_vector->push((yyvsp[0].from_type));
 			(yyval.from_list_type) = from_vector;
 		}
-#line 1697 "yconf.c" /* yacc.c:1646  */
+#line 1975 "yconf.c"
     break;
 
-  case 41:
-#line 297 "conf.y" /* yacc.c:1646  */
-    {
+  case 110: /* from_list: from_list TK_COMMA from  */
+#line 447 "conf.y"
+                                        {
 			from_vector->push((yyvsp[0].from_type));
 			(yyval.from_list_type) = from_vector;
 		}
-#line 1706 "yconf.c" /* yacc.c:1646  */
+#line 1984 "yconf.c"
     break;
 
-  case 42:
-#line 302 "conf.y" /* yacc.c:1646  */
-    { 
+  case 111: /* from: %empty  */
+#line 452 "conf.y"
+                            { 
 			(yyval.from_type) = new from_addr(new net_portion(solve_hostname(ANY_ADDR), MIN_MASK_LEN), new port_pair(FIRST_PORT, LAST_PORT)); 
 		}
-#line 1714 "yconf.c" /* yacc.c:1646  */
+#line 1992 "yconf.c"
     break;
 
-  case 43:
-#line 305 "conf.y" /* yacc.c:1646  */
-    { 
+  case 112: /* from: host_prefix  */
+#line 455 "conf.y"
+                            { 
 			(yyval.from_type) = new from_addr((yyvsp[0].net_type), new port_pair(FIRST_PORT, LAST_PORT)); 
 		}
-#line 1722 "yconf.c" /* yacc.c:1646  */
+#line 2000 "yconf.c"
     break;
 
-  case 44:
-#line 308 "conf.y" /* yacc.c:1646  */
-    { 
+  case 113: /* from: TK_COLON port_range  */
+#line 458 "conf.y"
+                                    { 
 			(yyval.from_type) = new from_addr(new net_portion(solve_hostname(ANY_ADDR), MIN_MASK_LEN), (yyvsp[0].port_type)); 
 		}
-#line 1730 "yconf.c" /* yacc.c:1646  */
+#line 2008 "yconf.c"
     break;
 
-  case 45:
-#line 311 "conf.y" /* yacc.c:1646  */
-    { 
+  case 114: /* from: host_prefix TK_COLON port_range  */
+#line 461 "conf.y"
+                                                { 
 			(yyval.from_type) = new from_addr((yyvsp[-2].net_type), (yyvsp[0].port_type)); 
 		}
-#line 1738 "yconf.c" /* yacc.c:1646  */
+#line 2016 "yconf.c"
     break;
 
-  case 46:
-#line 315 "conf.y" /* yacc.c:1646  */
-    { 
+  case 115: /* host_prefix: name prefix_length  */
+#line 465 "conf.y"
+                                   { 
 			/* use_hostprefix(): new net_portion() */
   			(yyval.net_type) = use_hostprefix((yyvsp[-1].str_type), (yyvsp[0].int_type)); 
 		}
-#line 1747 "yconf.c" /* yacc.c:1646  */
+#line 2025 "yconf.c"
     break;
 
-  case 47:
-#line 320 "conf.y" /* yacc.c:1646  */
-    { (yyval.int_type) = MAX_MASK_LEN; }
-#line 1753 "yconf.c" /* yacc.c:1646  */
+  case 116: /* prefix_length: %empty  */
+#line 470 "conf.y"
+                            { (yyval.int_type) = MAX_MASK_LEN; }
+#line 2031 "yconf.c"
     break;
 
-  case 48:
-#line 321 "conf.y" /* yacc.c:1646  */
-    { (yyval.int_type) = mask_len_value(conf_ident); }
-#line 1759 "yconf.c" /* yacc.c:1646  */
+  case 117: /* prefix_length: TK_SLASH ident  */
+#line 471 "conf.y"
+                               { (yyval.int_type) = mask_len_value(conf_ident); }
+#line 2037 "yconf.c"
     break;
 
-  case 49:
-#line 323 "conf.y" /* yacc.c:1646  */
-    {
+  case 118: /* port_range: name  */
+#line 473 "conf.y"
+                     {
 			int port = use_port((yyvsp[0].str_type));
 			(yyval.port_type) = new port_pair(port, port);
 		}
-#line 1768 "yconf.c" /* yacc.c:1646  */
+#line 2046 "yconf.c"
     break;
 
-  case 50:
-#line 327 "conf.y" /* yacc.c:1646  */
-    { 
+  case 119: /* port_range: name TK_RANGE  */
+#line 477 "conf.y"
+                              { 
 			(yyval.port_type) = new port_pair(use_port((yyvsp[-1].str_type)), 
 					   LAST_PORT); 
 		}
-#line 1777 "yconf.c" /* yacc.c:1646  */
+#line 2055 "yconf.c"
     break;
 
-  case 51:
-#line 331 "conf.y" /* yacc.c:1646  */
-    { 
+  case 120: /* port_range: TK_RANGE name  */
+#line 481 "conf.y"
+                              { 
 			(yyval.port_type) = new port_pair(FIRST_PORT, 
 				           use_port((yyvsp[0].str_type))); 
 		}
-#line 1786 "yconf.c" /* yacc.c:1646  */
+#line 2064 "yconf.c"
     break;
 
-  case 52:
-#line 335 "conf.y" /* yacc.c:1646  */
-    { 
+  case 121: /* port_range: name TK_RANGE name  */
+#line 485 "conf.y"
+                                   { 
 			(yyval.port_type) = new port_pair(use_port((yyvsp[-2].str_type)),
 				           use_port((yyvsp[0].str_type)));
 		}
-#line 1795 "yconf.c" /* yacc.c:1646  */
+#line 2073 "yconf.c"
     break;
 
 
-#line 1799 "yconf.c" /* yacc.c:1646  */
+#line 2077 "yconf.c"
+
       default: break;
     }
   /* User semantic actions sometimes alter yychar, and that requires
@@ -1809,25 +2088,23 @@ yyreduce:
      case of YYERROR or YYBACKUP, subsequent parser actions might lead
      to an incorrect destructor call or verbose syntax error message
      before the lookahead is translated.  */
-  YY_SYMBOL_PRINT ("-> $$ =", yyr1[yyn], &yyval, &yyloc);
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
 
   YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT (yyss, yyssp);
 
   *++yyvsp = yyval;
 
   /* Now 'shift' the result of the reduction.  Determine what state
      that goes to, based on the state we popped back to and the rule
      number reduced by.  */
-
-  yyn = yyr1[yyn];
-
-  yystate = yypgoto[yyn - YYNTOKENS] + *yyssp;
-  if (0 <= yystate && yystate <= YYLAST && yycheck[yystate] == *yyssp)
-    yystate = yytable[yystate];
-  else
-    yystate = yydefgoto[yyn - YYNTOKENS];
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
 
   goto yynewstate;
 
@@ -1838,50 +2115,14 @@ yyreduce:
 yyerrlab:
   /* Make sure we have latest lookahead translation.  See comments at
      user semantic actions for why this is necessary.  */
-  yytoken = yychar == YYEMPTY ? YYEMPTY : YYTRANSLATE (yychar);
-
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
   if (!yyerrstatus)
     {
       ++yynerrs;
-#if ! YYERROR_VERBOSE
       yyerror (YY_("syntax error"));
-#else
-# define YYSYNTAX_ERROR yysyntax_error (&yymsg_alloc, &yymsg, \
-                                        yyssp, yytoken)
-      {
-        char const *yymsgp = YY_("syntax error");
-        int yysyntax_error_status;
-        yysyntax_error_status = YYSYNTAX_ERROR;
-        if (yysyntax_error_status == 0)
-          yymsgp = yymsg;
-        else if (yysyntax_error_status == 1)
-          {
-            if (yymsg != yymsgbuf)
-              YYSTACK_FREE (yymsg);
-            yymsg = (char *) YYSTACK_ALLOC (yymsg_alloc);
-            if (!yymsg)
-              {
-                yymsg = yymsgbuf;
-                yymsg_alloc = sizeof yymsgbuf;
-                yysyntax_error_status = 2;
-              }
-            else
-              {
-                yysyntax_error_status = YYSYNTAX_ERROR;
-                yymsgp = yymsg;
-              }
-          }
-        yyerror (yymsgp);
-        if (yysyntax_error_status == 2)
-          goto yyexhaustedlab;
-      }
-# undef YYSYNTAX_ERROR
-#endif
     }
 
-
-
   if (yyerrstatus == 3)
     {
       /* If just tried and failed to reuse lookahead token after an
@@ -1910,12 +2151,11 @@ yyerrlab:
 | yyerrorlab -- error raised explicitly by YYERROR.  |
 `---------------------------------------------------*/
 yyerrorlab:
-
-  /* Pacify compilers like GCC when the user code never invokes
-     YYERROR and the label yyerrorlab therefore never appears in user
-     code.  */
-  if (/*CONSTCOND*/ 0)
-     goto yyerrorlab;
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
 
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
@@ -1932,13 +2172,14 @@ yyerrorlab:
 yyerrlab1:
   yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
+  /* Pop stack until we find a state that shifts the error token.  */
   for (;;)
     {
       yyn = yypact[yystate];
       if (!yypact_value_is_default (yyn))
         {
-          yyn += YYTERROR;
-          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR)
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
             {
               yyn = yytable[yyn];
               if (0 < yyn)
@@ -1952,7 +2193,7 @@ yyerrlab1:
 
 
       yydestruct ("Error: popping",
-                  yystos[yystate], yyvsp);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
@@ -1964,7 +2205,7 @@ yyerrlab1:
 
 
   /* Shift the error token.  */
-  YY_SYMBOL_PRINT ("Shifting", yystos[yyn], yyvsp, yylsp);
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
@@ -1975,26 +2216,30 @@ yyerrlab1:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
+
 
 /*-----------------------------------.
 | yyabortlab -- YYABORT comes here.  |
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
+
 
-#if !defined yyoverflow || YYERROR_VERBOSE
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
   yyerror (YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
 
-yyreturn:
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
   if (yychar != YYEMPTY)
     {
       /* Make sure we have latest lookahead translation.  See comments at
@@ -2010,20 +2255,18 @@ yyreturn:
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-                  yystos[*yyssp], yyvsp);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp);
       YYPOPSTACK (1);
     }
 #ifndef yyoverflow
   if (yyss != yyssa)
     YYSTACK_FREE (yyss);
 #endif
-#if YYERROR_VERBOSE
-  if (yymsg != yymsgbuf)
-    YYSTACK_FREE (yymsg);
-#endif
+
   return yyresult;
 }
-#line 341 "conf.y" /* yacc.c:1906  */
+
+#line 491 "conf.y"
 
 
 /* C code */
@@ -1,8 +1,9 @@
-/* A Bison parser, made by GNU Bison 3.0.4.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015 Free Software Foundation, Inc.
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
 
    This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
@@ -15,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -30,6 +31,10 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 #ifndef YY_YY_YCONF_H_INCLUDED
 # define YY_YY_YCONF_H_INCLUDED
 /* Debug traces.  */
@@ -40,69 +45,81 @@
 extern int yydebug;
 #endif
 
-/* Token type.  */
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
   enum yytokentype
   {
-    TK_NAME = 258,
-    TK_TCP = 259,
-    TK_UDP = 260,
-    TK_COLON = 261,
-    TK_SCOLON = 262,
-    TK_COMMA = 263,
-    TK_SLASH = 264,
-    TK_RANGE = 265,
-    TK_LBRACE = 266,
-    TK_RBRACE = 267,
-    TK_ARROW = 268,
-    TK_ACTV = 269,
-    TK_PASV = 270,
-    TK_USER = 271,
-    TK_GROUP = 272,
-    TK_BIND = 273,
-    TK_LISTEN = 274,
-    TK_SOURCE = 275,
-    TK_XOR_KEY = 276,
-    TK_REMOTE_SERVER = 277,
-    TK_CONFUSING_KEY = 278,
-    TK_STRING = 279,
-    TK_FRAGILE = 280,
-    TK_ILLEGAL = 281
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    TK_NAME = 258,                 /* TK_NAME  */
+    TK_TCP = 259,                  /* TK_TCP  */
+    TK_UDP = 260,                  /* TK_UDP  */
+    TK_COLON = 261,                /* TK_COLON  */
+    TK_SCOLON = 262,               /* TK_SCOLON  */
+    TK_COMMA = 263,                /* TK_COMMA  */
+    TK_SLASH = 264,                /* TK_SLASH  */
+    TK_RANGE = 265,                /* TK_RANGE  */
+    TK_LBRACE = 266,               /* TK_LBRACE  */
+    TK_RBRACE = 267,               /* TK_RBRACE  */
+    TK_ARROW = 268,                /* TK_ARROW  */
+    TK_ACTV = 269,                 /* TK_ACTV  */
+    TK_PASV = 270,                 /* TK_PASV  */
+    TK_USER = 271,                 /* TK_USER  */
+    TK_GROUP = 272,                /* TK_GROUP  */
+    TK_BIND = 273,                 /* TK_BIND  */
+    TK_LISTEN = 274,               /* TK_LISTEN  */
+    TK_SOURCE = 275,               /* TK_SOURCE  */
+    TK_XOR_KEY = 276,              /* TK_XOR_KEY  */
+    TK_REMOTE_SERVER = 277,        /* TK_REMOTE_SERVER  */
+    TK_CONFUSING_KEY = 278,        /* TK_CONFUSING_KEY  */
+    TK_STRING = 279,               /* TK_STRING  */
+    TK_FRAGILE = 280,              /* TK_FRAGILE  */
+    TK_WORKERS = 281,              /* TK_WORKERS  */
+    TK_CPU_AFFINITY = 282,         /* TK_CPU_AFFINITY  */
+    TK_IO_URING = 283,             /* TK_IO_URING  */
+    TK_CONNECT_TIMEOUT = 284,      /* TK_CONNECT_TIMEOUT  */
+    TK_HANDSHAKE_TIMEOUT = 285,    /* TK_HANDSHAKE_TIMEOUT  */
+    TK_PLAIN = 286,                /* TK_PLAIN  */
+    TK_EJECT_AFTER = 287,          /* TK_EJECT_AFTER  */
+    TK_HEALTH_CHECK = 288,         /* TK_HEALTH_CHECK  */
+    TK_FAILOVER = 289,             /* TK_FAILOVER  */
+    TK_ROUND_ROBIN = 290,          /* TK_ROUND_ROBIN  */
+    TK_LEAST_CONN = 291,           /* TK_LEAST_CONN  */
+    TK_LEAST_LATENCY = 292,        /* TK_LEAST_LATENCY  */
+    TK_WEIGHT = 293,               /* TK_WEIGHT  */
+    TK_WARM_POOL = 294,            /* TK_WARM_POOL  */
+    TK_MUX = 295,                  /* TK_MUX  */
+    TK_FAST_OPEN = 296,            /* TK_FAST_OPEN  */
+    TK_PIPELINE_KEYS = 297,        /* TK_PIPELINE_KEYS  */
+    TK_BACKLOG = 298,              /* TK_BACKLOG  */
+    TK_NODELAY = 299,              /* TK_NODELAY  */
+    TK_SEND_BUFFER = 300,          /* TK_SEND_BUFFER  */
+    TK_RECEIVE_BUFFER = 301,       /* TK_RECEIVE_BUFFER  */
+    TK_KEEPALIVE = 302,            /* TK_KEEPALIVE  */
+    TK_NOTSENT_LOWAT = 303,        /* TK_NOTSENT_LOWAT  */
+    TK_MAX_CONNECTIONS = 304,      /* TK_MAX_CONNECTIONS  */
+    TK_MAX_PER_SOURCE = 305,       /* TK_MAX_PER_SOURCE  */
+    TK_IDLE_TIMEOUT = 306,         /* TK_IDLE_TIMEOUT  */
+    TK_SESSION_TIMEOUT = 307,      /* TK_SESSION_TIMEOUT  */
+    TK_ACCEPT_RATE = 308,          /* TK_ACCEPT_RATE  */
+    TK_ACCEPT_BURST = 309,         /* TK_ACCEPT_BURST  */
+    TK_ACCEPT_PREFIX = 310,        /* TK_ACCEPT_PREFIX  */
+    TK_DNS_TTL = 311,              /* TK_DNS_TTL  */
+    TK_DNS_NEGATIVE_TTL = 312,     /* TK_DNS_NEGATIVE_TTL  */
+    TK_DNS_STALE = 313,            /* TK_DNS_STALE  */
+    TK_ILLEGAL = 314               /* TK_ILLEGAL  */
   };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
-/* Tokens.  */
-#define TK_NAME 258
-#define TK_TCP 259
-#define TK_UDP 260
-#define TK_COLON 261
-#define TK_SCOLON 262
-#define TK_COMMA 263
-#define TK_SLASH 264
-#define TK_RANGE 265
-#define TK_LBRACE 266
-#define TK_RBRACE 267
-#define TK_ARROW 268
-#define TK_ACTV 269
-#define TK_PASV 270
-#define TK_USER 271
-#define TK_GROUP 272
-#define TK_BIND 273
-#define TK_LISTEN 274
-#define TK_SOURCE 275
-#define TK_XOR_KEY 276
-#define TK_REMOTE_SERVER 277
-#define TK_CONFUSING_KEY 278
-#define TK_STRING 279
-#define TK_FRAGILE 280
-#define TK_ILLEGAL 281
 
 /* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-
 union YYSTYPE
 {
-#line 141 "conf.y" /* yacc.c:1909  */
+#line 229 "conf.y"
 
 	int	           int_type;
   	bool               bool_type;
@@ -120,9 +137,9 @@ union YYSTYPE
 	vector<proto_map*> *map_list_type;
 	entry		   *entry_type;
 
-#line 124 "yconf.h" /* yacc.c:1909  */
-};
+#line 141 "yconf.h"
 
+};
 typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_TRIVIAL 1
 # define YYSTYPE_IS_DECLARED 1
@@ -131,6 +148,8 @@ typedef union YYSTYPE YYSTYPE;
 
 extern YYSTYPE yylval;
 
+
 int yyparse (void);
 
+
 #endif /* !YY_YY_YCONF_H_INCLUDED  */